@@ -6,6 +6,7 @@
 #  Event_FOUND - system has Event
 #  Event_INCLUDE_DIRS - the Event include directories
 #  Event_LIBRARIES - link these to use Event
+#  EVENT_PTHREADS_LIBRARIES - link these to use Event with POSIX threads
 #
 
 if (EVENT_INCLUDE_DIR AND EVENT_LIBRARY)
@@ -28,8 +29,14 @@ find_library(EVENT_CORE_LIBRARY
   PATHS /usr/lib /usr/local/lib
 )
 
+find_library(EVENT_PTHREADS_LIBRARY
+  NAMES event_pthreads
+  PATHS /usr/lib /usr/local/lib
+)
+
 set(EVENT_LIBRARIES ${EVENT_LIBRARY} )
 set(EVENT_CORE_LIBRARIES ${EVENT_CORE_LIBRARY} )
+set(EVENT_PTHREADS_LIBRARIES ${EVENT_PTHREADS_LIBRARY} )
 
 add_definitions(-DLIBNET_LIL_ENDIAN)
 
@@ -40,4 +47,4 @@ find_package_handle_standard_args(EVENT
   EVENT_LIBRARIES
 )
 
-mark_as_advanced(EVENT_INCLUDE_DIR EVENT_LIBRARY EVENT_CORE_LIBRARY)
+mark_as_advanced(EVENT_INCLUDE_DIR EVENT_LIBRARY EVENT_CORE_LIBRARY EVENT_PTHREADS_LIBRARY)
@@ -33,6 +33,50 @@
 extern "C" {
 #endif
 
+#include <stddef.h>
+
+//! Maximum Encoded Length of a given Number of Bytes
+#define BASE64_ENCODE_BOUND(n)		((((n) + 2) / 3) * 4)
+
+//! Maximum Decoded Length of a given Number of Characters
+#define BASE64_DECODE_BOUND(n)		((((n) + 3) / 4) * 3)
+
+/**@{
+ * @name Base 64 Codec Implementations
+ */
+#define BASE64_IMPL_AUTO		-1		///< Best Implementation for this CPU
+#define BASE64_IMPL_SCALAR		0		///< Portable Table Lookup
+#define BASE64_IMPL_SSE41		1		///< x86 SSE4.1 Kernels
+#define BASE64_IMPL_AVX2		2		///< x86 AVX2 Kernels
+/*@}*/
+
+/**
+ * @brief Streaming Base 64 Encoder State
+ *
+ * Holds the input bytes which did not fill a whole 3-byte group at the end of
+ * the last call to base64_encode_update().
+ */
+typedef struct
+{
+	unsigned char	carry[3];		///< Carried-over Input Bytes
+	unsigned int	ncarry;			///< Number of Carried-over Bytes
+
+} base64_encoder_t;
+
+/**
+ * @brief Streaming Base 64 Decoder State
+ *
+ * Holds the characters which did not fill a whole 4-character group at the
+ * end of the last call to base64_decode_update().
+ */
+typedef struct
+{
+	char			carry[4];		///< Carried-over Input Characters
+	unsigned int	ncarry;			///< Number of Carried-over Characters
+	int				done;			///< Padding has been Seen
+
+} base64_decoder_t;
+
 /**
  * @brief Encode a string in Base 64
  * @param[in] data Input Data to Encode
@@ -42,7 +86,8 @@ extern "C" {
  *
  * Encodes the given string in Base 64.  The given length parameter must be set
  * with the data length as NUL characters are encoded as data.  If the string
- * cannot be encoded, NULL is returned.
+ * cannot be encoded, NULL is returned.  The returned string is NUL-terminated;
+ * the terminator is not counted in out_length.
  *
  * @note The caller is responsible for free()'ing the returned string
  */
@@ -55,13 +100,98 @@ char * base64_encode(const unsigned char * data, size_t in_length, size_t * out_
  * @param[out] out_length Output Data Length
  * @return Pointer to Decoded Data
  *
- * Decodes the given string from Base 64.  If the string cannot be encoded,
- * NULL is returned.
+ * Decodes the given string from Base 64.  If the string cannot be decoded,
+ * including if it contains characters outside the Base 64 alphabet or padding
+ * anywhere but at the end, NULL is returned.
  *
  * @note The caller is responsible for free()'ing the returned data buffer.
  */
 unsigned char * base64_decode(const char * data, size_t in_length, size_t * out_length);
 
+/**
+ * @brief Decode a string from Base 64 into a Buffer
+ * @param[in] data Input Data to Decode
+ * @param[in] in_length Input Data Length
+ * @param[out] out Output Buffer of at least BASE64_DECODE_BOUND(in_length) bytes
+ * @param[out] out_length Output Data Length
+ * @return 0 on success, -1 if the string is not valid Base 64
+ *
+ * The output buffer may be the same as the input buffer, in which case the
+ * string is decoded in place.
+ */
+int base64_decode_buf(const char * data, size_t in_length, unsigned char * out, size_t * out_length);
+
+/**
+ * @brief Initialize a Streaming Base 64 Encoder
+ * @param[out] enc Encoder State
+ */
+void base64_encoder_init(base64_encoder_t * enc);
+
+/**
+ * @brief Encode the next Block of Data
+ * @param[in,out] enc Encoder State
+ * @param[in] data Input Data Block
+ * @param[in] in_length Input Data Block Length
+ * @param[out] out Output Buffer of at least BASE64_ENCODE_BOUND(in_length) bytes
+ * @return Number of characters written to the output buffer
+ *
+ * Blocks may be of any size; bytes which do not fill a whole 3-byte group are
+ * carried over to the next call, so no padding is written until
+ * base64_encode_final() is called.  The output is not NUL-terminated.
+ */
+size_t base64_encode_update(base64_encoder_t * enc, const unsigned char * data, size_t in_length, char * out);
+
+/**
+ * @brief Finish a Streaming Base 64 Encoding
+ * @param[in,out] enc Encoder State
+ * @param[out] out Output Buffer of at least 4 bytes
+ * @return Number of characters written to the output buffer
+ *
+ * Writes the final padded group, if any, and resets the encoder.
+ */
+size_t base64_encode_final(base64_encoder_t * enc, char * out);
+
+/**
+ * @brief Initialize a Streaming Base 64 Decoder
+ * @param[out] dec Decoder State
+ */
+void base64_decoder_init(base64_decoder_t * dec);
+
+/**
+ * @brief Decode the next Block of Characters
+ * @param[in,out] dec Decoder State
+ * @param[in] data Input Character Block
+ * @param[in] in_length Input Character Block Length
+ * @param[out] out Output Buffer of at least BASE64_DECODE_BOUND(in_length) bytes
+ * @param[out] out_length Number of bytes written to the output buffer
+ * @return 0 on success, -1 if the input is not valid Base 64
+ */
+int base64_decode_update(base64_decoder_t * dec, const char * data, size_t in_length,
+		unsigned char * out, size_t * out_length);
+
+/**
+ * @brief Finish a Streaming Base 64 Decoding
+ * @param[in,out] dec Decoder State
+ * @return 0 on success, -1 if the input ended partway through a group
+ *
+ * Resets the decoder.
+ */
+int base64_decode_final(base64_decoder_t * dec);
+
+/**
+ * @brief Select the Base 64 Codec Implementation
+ * @param[in] impl Implementation (one of BASE64_IMPL_*)
+ * @return Implementation in use
+ *
+ * By default the fastest implementation supported by the CPU is chosen the
+ * first time the codec is used.  Requesting an implementation the CPU does not
+ * support selects the best one it does; this is mainly for benchmarking.
+ *
+ * The choice is not locked, so a multi-threaded program should call this
+ * with BASE64_IMPL_AUTO before starting threads which use the codec.
+ */
+int base64_select_impl(int impl);
+
 #ifdef __cplusplus
 }
 #endif
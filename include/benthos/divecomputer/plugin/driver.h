@@ -42,6 +42,7 @@ extern "C" {
 #endif
 
 #include <stdint.h>
+#include <time.h>
 
 /**
  * @brief Opaque Pointer to a Device driver Instance
@@ -106,6 +107,23 @@ typedef int (* plugin_driver_create_fn_t)(dev_handle_t *);
  */
 typedef int (* plugin_driver_open_fn_t)(dev_handle_t, const char *, const char *);
 
+/**
+ * @brief Open a Device for Offline Parsing
+ * @param[in] Device Handle
+ * @param[in] Device Model Number
+ * @param[in] Device Serial Number
+ * @param[in] Device Tick Count at Transfer
+ * @param[in] Host Time at Transfer
+ * @return Error value or 0 for success.
+ *
+ * Sets up a device handle to extract and parse a previously saved transfer
+ * buffer without connecting to a device.  The model, serial and tick count
+ * are those reported to the device data callback during the original
+ * transfer, and the host time is when that transfer ran, so that dive times
+ * are corrected exactly as they were at the time.
+ */
+typedef int (* plugin_driver_open_offline_fn_t)(dev_handle_t, uint8_t, uint32_t, uint32_t, time_t);
+
 /**
  * @brief Close a Device
  * @param[in] Device Handle
@@ -173,6 +191,47 @@ typedef int (* plugin_driver_get_serial_fn_t)(dev_handle_t, uint32_t *);
  */
 typedef int (* plugin_driver_transfer_fn_t)(dev_handle_t, void **, uint32_t *, device_callback_fn_t, transfer_callback_fn_t, void *);
 
+/**
+ * @brief Transfer bytes from the Dive Computer and Stream Dives
+ * @param[in] Device Handle
+ * @param[out] Data Buffer
+ * @param[out] Buffer Size
+ * @param[in] Device Data Callback Function Pointer
+ * @param[in] Transfer Progress Callback Function Pointer
+ * @param[in] Dive Data Callback Function Pointer
+ * @param[in] Callback Function User Data
+ * @return Error value or 0 for success
+ *
+ * Behaves like plugin_driver_transfer_fn_t, but also calls the dive data
+ * callback for each dive as soon as it has been completely received, while
+ * the rest of the transfer is still in progress.  The dive data passed to
+ * the callback points into the data buffer, which is not moved during the
+ * transfer and is returned to the caller when the transfer completes.  The
+ * dives are the same as those plugin_driver_extract_fn_t would produce, so
+ * the caller need not extract the returned buffer again.
+ *
+ * If the transfer fails, dives already passed to the callback are complete
+ * and valid, and the buffer holding them is still returned to the caller to
+ * be freed.  A caller can checkpoint those dives and resume by setting the
+ * token to that of the last one.
+ */
+typedef int (* plugin_driver_transfer_stream_fn_t)(dev_handle_t, void **, uint32_t *, device_callback_fn_t, transfer_callback_fn_t, divedata_callback_fn_t, void *);
+
+/**
+ * @brief Get the Transfer Rate
+ * @param[in] Device Handle
+ * @param[out] Achieved Data Rate in Bytes per Second
+ * @param[out] Current Read Size in Bytes
+ * @return Error value or 0 for success
+ *
+ * Returns the data rate achieved so far by the transfer in progress, or by
+ * the last transfer once it has finished.  The driver updates the figures
+ * before each call to the transfer progress callback, which is the intended
+ * place to call this function.  Drivers which do not read in chunks report a
+ * read size of 0.
+ */
+typedef int (* plugin_driver_transfer_rate_fn_t)(dev_handle_t, uint32_t *, uint32_t *);
+
 /**
  * @brief Extract Dives from the Transferred Data
  * @param[in] Device Handle
@@ -183,7 +242,9 @@ typedef int (* plugin_driver_transfer_fn_t)(dev_handle_t, void **, uint32_t *, d
  * @return Error value or 0 for success
  *
  * Extracts individual dives from the transferred data and calls the given
- * callback function on each dive.
+ * callback function on each dive.  The dive data passed to the callback
+ * should point into the data buffer rather than a copy, so that callers can
+ * keep references to the dives for as long as they keep the buffer.
  */
 typedef int (* plugin_driver_extract_fn_t)(dev_handle_t, void *, uint32_t, divedata_callback_fn_t, void *);
 
@@ -96,6 +96,55 @@ enum
 	DIVE_WAYPOINT_FLAG,				///< Vendor-Defined Flag
 };
 
+/**
+ * @brief Dive Profile Column Flags
+ *
+ * Bit flags identifying the columns of a profile_columns_t structure.  These
+ * are used in the per-waypoint presence mask to indicate which columns hold
+ * a value for that waypoint.
+ */
+enum
+{
+	DIVE_COLUMN_DEPTH		= (1 << 0),	///< Depth Column
+	DIVE_COLUMN_TEMP		= (1 << 1),	///< Temperature Column
+	DIVE_COLUMN_PX			= (1 << 2),	///< Tank Pressure and Tank Index Columns
+	DIVE_COLUMN_RBT			= (1 << 3),	///< Remaining Bottom Time Column
+	DIVE_COLUMN_HEARTRATE	= (1 << 4),	///< Heart Rate Column
+	DIVE_COLUMN_BEARING		= (1 << 5),	///< Bearing Column
+	DIVE_COLUMN_ALARMS		= (1 << 6),	///< Alarm Bitmask Column
+};
+
+/**
+ * @brief Columnar Dive Profile Buffers
+ *
+ * Caller-owned column arrays which are filled by the parser with one entry
+ * per waypoint.  Each non-null column must hold at least capacity entries;
+ * null columns are skipped.  Units are the same as the corresponding
+ * DIVE_WAYPOINT_* tokens.
+ *
+ * The present column holds a mask of DIVE_COLUMN_* flags for each waypoint
+ * indicating which of the other columns were set for that waypoint; columns
+ * which are not flagged hold zero.  The layout of the alarm bitmask is
+ * driver-specific.
+ */
+typedef struct
+{
+	uint32_t		capacity;		///< Number of Entries in Each Column
+	uint32_t		count;			///< Number of Waypoints in the Profile
+
+	uint32_t *		time;			///< Time (seconds)
+	uint32_t *		depth;			///< Depth (centimeters)
+	int32_t *		temp;			///< Temperature (centidegrees Celsius)
+	uint32_t *		pressure;		///< Tank Pressure (mbar)
+	uint8_t *		tank;			///< Tank Index
+	uint32_t *		rbt;			///< Remaining Bottom Time (minutes)
+	uint32_t *		heartrate;		///< Heart Rate (bpm)
+	uint32_t *		bearing;		///< Bearing (degrees)
+	uint32_t *		alarms;			///< Alarm Bitmask
+	uint8_t *		present;		///< Column Presence Mask (DIVE_COLUMN_*)
+
+} profile_columns_t;
+
 /**
  * @brief Dive Header Callback Function
  * @param[in] Token Type
@@ -170,6 +219,26 @@ typedef int (* plugin_parser_parse_header_fn_t)(parser_handle_t, const void *, u
  */
 typedef int (* plugin_parser_parse_profile_fn_t)(parser_handle_t, const void *, uint32_t, waypoint_callback_fn_t, void *);
 
+/**
+ * @brief Parse the Dive Profile Data into Columns
+ * @param[in] Parser Handle
+ * @param[in] Data Buffer Pointer
+ * @param[in] Data Buffer Size
+ * @param[in,out] Profile Column Buffers
+ * @return Error value or 0 for success
+ *
+ * Parses the dive profile in a single pass and stores each waypoint in the
+ * caller-supplied column buffers instead of issuing one callback per value.
+ * On return the count member holds the number of waypoints in the profile.
+ * If the count exceeds the buffer capacity, only the first capacity
+ * waypoints are stored and the call fails with DRIVER_ERR_INVALID; the
+ * caller may then grow the buffers, reset the parser and parse again.
+ *
+ * This entry point is optional and may be null in the driver interface, in
+ * which case callers should fall back to plugin_parser_parse_profile_fn_t.
+ */
+typedef int (* plugin_parser_parse_columns_fn_t)(parser_handle_t, const void *, uint32_t, profile_columns_t *);
+
 #ifdef __cplusplus
 }
 #endif
@@ -66,6 +66,8 @@ extern "C" {
  * @brief Driver Interface Structure
  *
  * Contains pointers to the required device driver entry points in a plugin.
+ * The parser_parse_columns, driver_transfer_stream, driver_open_offline and
+ * driver_transfer_rate entry points are optional and may be null.
  */
 typedef struct
 {
@@ -89,6 +91,11 @@ typedef struct
 
 	plugin_parser_parse_header_fn_t		parser_parse_header;
 	plugin_parser_parse_profile_fn_t	parser_parse_profile;
+	plugin_parser_parse_columns_fn_t	parser_parse_columns;
+
+	plugin_driver_transfer_stream_fn_t	driver_transfer_stream;
+	plugin_driver_open_offline_fn_t		driver_open_offline;
+	plugin_driver_transfer_rate_fn_t	driver_transfer_rate;
 
 } driver_interface_t;
 
@@ -47,6 +47,7 @@
 #define SMARTI_STATUS_NO_DATA			243		///< No Data to Transfer (XFER command)
 
 #define SMARTI_DATA_FOLLOWS				301		///< Base-64 Data Follows (XFER command)
+#define SMARTI_DATA_CHUNKED				302		///< Chunked Base-64 Data Follows (XFER CHUNKED command)
 
 #define SMARTI_ERROR_NO_DEVICE			400		///< No Device is Connected
 #define SMARTI_ERROR_CONNECT			401		///< Unable to Connect to the Device
@@ -62,4 +63,14 @@
 #define SMARTI_ERROR_DEVICE				540		///< A Device Error Occurred (XFER command)
 /*@}*/
 
+/**@{
+ * @name Smart-I Daemon Capabilities
+ *
+ * Listed in brackets at the end of the greeting, e.g. "[binary deflate]", and
+ * enabled by the client with the OPTION command.
+ */
+#define SMARTI_CAP_BINARY				"binary"	///< Binary Transfer Frames (OPTION BINARY)
+#define SMARTI_CAP_DEFLATE				"deflate"	///< Deflate Compressed Frames (OPTION BINARY DEFLATE)
+/*@}*/
+
 #endif /* SMARTI_CODES_H_ */
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ * www.asymworks.com / info@asymworks.com
+ *
+ * This file is part of the Benthos Dive Log Package (benthos-log.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+
+/**
+ * @file src/bench/bench_base64.c
+ * @brief Base 64 Codec Benchmark
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ *
+ * Times one-shot and streaming Base 64 encoding and decoding of a transfer
+ * sized buffer with each codec implementation the CPU supports.
+ *
+ * Usage: bench_base64 [seconds per measurement] [buffer size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <benthos/divecomputer/base64.h>
+
+#include "bench_util.h"
+
+#define BLOCK_SIZE		3072
+
+static const char * impl_names[] = { "scalar", "sse4.1", "avx2" };
+
+static double time_encode(const unsigned char * data, size_t len, double min_time)
+{
+	uint64_t bytes = 0;
+	double start = bench_now();
+	double elapsed;
+	size_t n;
+
+	do
+	{
+		free(base64_encode(data, len, & n));
+		bytes += len;
+		elapsed = bench_now() - start;
+	}
+	while (elapsed < min_time);
+
+	return bytes / elapsed;
+}
+
+static double time_encode_stream(const unsigned char * data, size_t len, double min_time)
+{
+	char out[BASE64_ENCODE_BOUND(BLOCK_SIZE)];
+	base64_encoder_t enc;
+	uint64_t bytes = 0;
+	double start = bench_now();
+	double elapsed;
+	size_t pos;
+
+	do
+	{
+		base64_encoder_init(& enc);
+		for (pos = 0; pos < len; pos += BLOCK_SIZE)
+			base64_encode_update(& enc, data + pos, (len - pos < BLOCK_SIZE) ? len - pos : BLOCK_SIZE, out);
+		base64_encode_final(& enc, out);
+
+		bytes += len;
+		elapsed = bench_now() - start;
+	}
+	while (elapsed < min_time);
+
+	return bytes / elapsed;
+}
+
+static double time_decode(const char * text, size_t len, unsigned char * out, double min_time)
+{
+	uint64_t bytes = 0;
+	double start = bench_now();
+	double elapsed;
+	size_t n;
+
+	do
+	{
+		if (base64_decode_buf(text, len, out, & n) != 0)
+			return 0;
+
+		bytes += n;
+		elapsed = bench_now() - start;
+	}
+	while (elapsed < min_time);
+
+	return bytes / elapsed;
+}
+
+int main(int argc, char ** argv)
+{
+	double min_time = 0.5;
+	size_t size = 1 << 20;
+	uint32_t rng = 0x5eed;
+	unsigned char * data;
+	unsigned char * out;
+	char * text;
+	size_t tlen;
+	size_t i;
+	int impl;
+
+	if (argc > 1)
+		min_time = atof(argv[1]);
+	if (argc > 2)
+		size = strtoul(argv[2], 0, 10);
+
+	data = (unsigned char *)malloc(size);
+	out = (unsigned char *)malloc(BASE64_DECODE_BOUND(BASE64_ENCODE_BOUND(size)));
+	if (! data || ! out)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	for (i = 0; i < size; ++i)
+		data[i] = (uint8_t)bench_rand(& rng);
+
+	text = base64_encode(data, size, & tlen);
+	if (! text)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	printf("%-8s %14s %14s %14s\n", "Codec", "Encode MB/s", "Stream MB/s", "Decode MB/s");
+
+	for (impl = BASE64_IMPL_SCALAR; impl <= BASE64_IMPL_AVX2; ++impl)
+	{
+		if (base64_select_impl(impl) != impl)
+			continue;
+
+		printf("%-8s %14.1f %14.1f %14.1f\n", impl_names[impl],
+			time_encode(data, size, min_time) / 1e6,
+			time_encode_stream(data, size, min_time) / 1e6,
+			time_decode(text, tlen, out, min_time) / 1e6);
+	}
+
+	free(text);
+	free(out);
+	free(data);
+
+	return 0;
+}
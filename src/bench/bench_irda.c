@@ -0,0 +1,319 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ * www.asymworks.com / info@asymworks.com
+ *
+ * This file is part of the Benthos Dive Log Package (benthos-log.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * @file src/bench/bench_irda.c
+ * @brief Smart IrDA Transfer Benchmark
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ *
+ * Downloads a synthetic dive memory through the smart plugin driver from the
+ * simulated device in irda_sim.h, over link profiles modelled on the IrDA
+ * speeds with added turnaround latency and frame loss.  Everything above the
+ * socket is the code that benthos-xfr runs: discovery, the command
+ * exchanges, the read loop and dive extraction.
+ *
+ * Each profile is run with fixed read sizes and with the adaptive read size.
+ * For each run it reports the time to open the device, the time to transfer
+ * the data, the number of reads and of reads which timed out, the achieved
+ * data rate, the rate the driver reported to the progress callback, that
+ * rate as a fraction of the link rate, the final read size and the mean wait
+ * of the socket reads.
+ *
+ * Usage: bench_irda [-n dives] [-c initial chunk size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <common-irda/irda.h>
+#include <common-irda/irda_sim.h>
+
+#include <plugins/smart/smart_driver.h>
+
+#include "bench_util.h"
+#include "smart_corpus.h"
+
+#define NDIVES		8
+#define NSAMPLES	1000
+
+//! Simulated Link Profile
+typedef struct
+{
+	const char *		name;		///< Profile Name
+	unsigned long		byte_rate;	///< Data Rate in Bytes per Second (0 for unlimited)
+	unsigned long		latency;	///< Command Turnaround in Microseconds
+	unsigned int		frame_size;	///< Largest Data Frame
+	unsigned int		loss;		///< Data Frames Lost per Thousand
+	unsigned long		stall;		///< Retransmit Delay in Microseconds
+	long				timeout;	///< IrDA Timeout in Milliseconds
+
+} link_t;
+
+//! Read Size Mode
+typedef struct
+{
+	const char *		name;		///< Mode Name
+	uint32_t			chunk_size;	///< Initial Read Size
+	uint32_t			chunk_max;	///< Largest Read Size
+
+} mode_t_;
+
+//! Transfer Counters
+typedef struct
+{
+	dev_handle_t		dev;		///< Driver Handle
+	uint32_t			reads;		///< Progress Callbacks (one per read)
+	uint32_t			dives;		///< Dives Extracted
+	uint32_t			rate;		///< Last Reported Rate
+	uint32_t			chunk;		///< Last Reported Read Size
+
+} counters_t;
+
+//! Benchmark Result
+typedef struct
+{
+	double				t_open;		///< Open Time
+	double				t_xfer;		///< Transfer Time
+	uint32_t			reads;		///< Reads in the Transfer
+	uint32_t			dives;		///< Dives Extracted
+	uint32_t			rate;		///< Reported Rate
+	uint32_t			chunk;		///< Final Read Size
+	irda_stats_t		stats;		///< Socket Read Statistics
+
+} result_t;
+
+static const link_t links[] =
+{
+	{ "unlimited",	0,			0,		2048,	0,		0,		2000 },
+	{ "fir-4m",		500000,		500,	2048,	0,		0,		2000 },
+	{ "mir-1.1m",	144000,		1000,	2048,	0,		0,		2000 },
+	{ "sir-115k",	11520,		5000,	256,	0,		0,		2000 },
+	{ "sir-slow",	11520,		50000,	64,		0,		0,		2000 },
+	{ "sir-lossy",	11520,		5000,	256,	20,		100000,	2000 },
+	{ "sir-noisy",	11520,		5000,	64,		30,		300000,	200 },
+};
+
+static const mode_t_ modes[] =
+{
+	{ "fixed",		8,			8 },
+	{ "fixed",		32,			32 },
+	{ "adaptive",	8,			256 },
+};
+
+static void progress_cb(void * userdata, uint32_t transferred, uint32_t total, int * cancel)
+{
+	counters_t * c = (counters_t *)userdata;
+
+	if (transferred)
+		c->reads++;
+
+	/* Poll the Rate as benthos-xfr does from its Progress Callback */
+	smart_driver_transfer_rate(c->dev, & c->rate, & c->chunk);
+}
+
+static void dive_cb(void * userdata, void * buffer, uint32_t size, const char * token)
+{
+	((counters_t *)userdata)->dives++;
+}
+
+static int run(const link_t * link, const mode_t_ * mode, const uint8_t * image, uint32_t size, result_t * r)
+{
+	irda_sim_config_t cfg;
+	dev_handle_t dev;
+	counters_t counters;
+	void * buf = NULL;
+	uint32_t len = 0;
+	char args[64];
+	double t0, t1, t2;
+	int rc;
+
+	irda_sim_default_config(& cfg);
+	cfg.data = image;
+	cfg.size = size;
+	cfg.byte_rate = link->byte_rate;
+	cfg.latency = link->latency;
+	cfg.frame_size = link->frame_size;
+	cfg.loss = link->loss;
+	cfg.stall = link->stall;
+
+	if (irda_sim_configure(& cfg) != 0)
+	{
+		fprintf(stderr, "Failed to configure the simulated device\n");
+		return -1;
+	}
+
+	if (smart_driver_create(& dev) != 0)
+	{
+		fprintf(stderr, "Failed to create the smart driver\n");
+		return -1;
+	}
+
+	memset(& counters, 0, sizeof(counters));
+	counters.dev = dev;
+	snprintf(args, sizeof(args), "chunk_size=%u:chunk_max=%u:timeout=%ld:xfer_timeout=0",
+		mode->chunk_size, mode->chunk_max, link->timeout);
+
+	t0 = bench_now();
+	rc = smart_driver_open(dev, NULL, args);
+	t1 = bench_now();
+
+	if (rc == 0)
+		rc = smart_driver_transfer_stream(dev, & buf, & len, NULL, progress_cb, dive_cb, & counters);
+	t2 = bench_now();
+
+	if (rc != 0)
+		fprintf(stderr, "Transfer failed on %s: %s\n", link->name, smart_driver_errmsg(dev));
+	else if ((len != size) || (memcmp(buf, image, size) != 0))
+	{
+		fprintf(stderr, "Transfer on %s returned the wrong data\n", link->name);
+		rc = -1;
+	}
+
+	if (irda_socket_stats(((smart_device_t)dev)->s, & r->stats) != 0)
+		memset(& r->stats, 0, sizeof(irda_stats_t));
+
+	free(buf);
+	smart_driver_close(dev);
+	smart_driver_shutdown(dev);
+
+	r->t_open = t1 - t0;
+	r->t_xfer = t2 - t1;
+	r->reads = counters.reads;
+	r->dives = counters.dives;
+	r->rate = counters.rate;
+	r->chunk = counters.chunk;
+
+	return rc;
+}
+
+int main(int argc, char ** argv)
+{
+	const smart_model_def_t * model = & smart_corpus_models[0];
+	uint32_t rng = 0x5eed;
+	uint32_t ndives = NDIVES;
+	uint32_t chunk = 0;
+	uint8_t * image;
+	uint32_t size = 0;
+	uint32_t i;
+	int failed = 0;
+	int l;
+	int m;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:c:")) != -1)
+	{
+		switch (c)
+		{
+		case 'n':
+			ndives = (uint32_t)atoi(optarg);
+			break;
+
+		case 'c':
+			chunk = (uint32_t)atoi(optarg);
+			break;
+
+		default:
+			fprintf(stderr, "Usage: %s [-n dives] [-c initial chunk size]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	/* Lay the Corpus out as the Dive Memory */
+	image = NULL;
+	for (i = 0; i < ndives; ++i)
+	{
+		uint32_t dsize;
+		uint8_t * d = smart_corpus_dive(model, NSAMPLES, i + 1, & rng, & dsize);
+		uint8_t * p = (d != NULL) ? (uint8_t *)realloc(image, size + dsize) : NULL;
+
+		if (p == NULL)
+		{
+			fprintf(stderr, "Out of memory\n");
+			return 1;
+		}
+
+		memcpy(p + size, d, dsize);
+		image = p;
+		size += dsize;
+		free(d);
+	}
+
+	irda_init();
+	irda_set_transport(irda_sim_transport());
+
+	printf("%u dives, %u bytes from a simulated %s\n\n", ndives, size, model->name);
+	printf("%-10s %-8s %6s %8s %9s %7s %5s %9s %9s %6s %6s %8s\n", "Link", "Mode", "Chunk",
+		"Open ms", "Xfer ms", "Reads", "T/O", "kB/s", "Rpt kB/s", "Eff %", "Final", "Wait ms");
+
+	for (l = 0; l < (int)(sizeof(links) / sizeof(link_t)); ++l)
+	{
+		for (m = 0; m < (int)(sizeof(modes) / sizeof(mode_t_)); ++m)
+		{
+			mode_t_ mode = modes[m];
+			double rate;
+			double wait;
+			char eff[16];
+			result_t r;
+
+			/* Override the Initial Size, keeping Fixed Modes Fixed */
+			if (chunk)
+			{
+				if (mode.chunk_max == mode.chunk_size)
+					mode.chunk_max = chunk;
+				mode.chunk_size = chunk;
+			}
+
+			if (run(& links[l], & mode, image, size, & r) != 0)
+			{
+				printf("%-10s %-8s %6u %8.1f %9s\n", links[l].name, mode.name, mode.chunk_size,
+					r.t_open * 1e3, "failed");
+				failed = 1;
+				continue;
+			}
+
+			if (r.dives != ndives)
+			{
+				fprintf(stderr, "Extracted %u of %u dives on %s\n", r.dives, ndives, links[l].name);
+				return 1;
+			}
+
+			rate = size / r.t_xfer;
+			wait = r.stats.reads ? r.stats.wait_us / 1e3 / r.stats.reads : 0;
+
+			if (links[l].byte_rate)
+				snprintf(eff, sizeof(eff), "%.1f", rate * 100 / links[l].byte_rate);
+			else
+				strcpy(eff, "-");
+
+			printf("%-10s %-8s %6u %8.1f %9.1f %7u %5lu %9.1f %9.1f %6s %6u %8.3f\n", links[l].name,
+				mode.name, mode.chunk_size, r.t_open * 1e3, r.t_xfer * 1e3, r.reads, r.stats.timeouts,
+				rate / 1e3, r.rate / 1e3, eff, r.chunk, wait);
+		}
+	}
+
+	irda_cleanup();
+	free(image);
+
+	return failed;
+}
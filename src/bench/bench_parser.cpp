@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ * www.asymworks.com / info@asymworks.com
+ *
+ * This file is part of the Benthos Dive Log Package (benthos-log.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * @file src/bench/bench_parser.cpp
+ * @brief Dive Parser and Output Formatter Benchmark
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ *
+ * Times parser_parse_header and parser_parse_profile over a synthetic corpus
+ * for every Smart model, first with a no-op callback and then through the
+ * CSV and UDDF output formatters used by benthos-xfr.  Formatter output is
+ * written to the null device, so the figures include formatting but not disk
+ * throughput.
+ *
+ * Usage: bench_parser [seconds per measurement]
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <benthos/divecomputer/plugin/parser.h>
+
+#include <common-smart/smart_device_base.h>
+#include <common-smart/smart_parser.h>
+
+#include <output_fmt.h>
+#include <output_csv.h>
+#include <output_uddf.h>
+
+#include "bench_util.h"
+#include "smart_corpus.h"
+
+#define NDIVES		32
+#define NSAMPLES	4000
+
+#ifdef _WIN32
+#define NULL_DEVICE	"NUL"
+#else
+#define NULL_DEVICE	"/dev/null"
+#endif
+
+//! Output Formatter Initialization Function
+typedef int (* fmt_init_fn_t)(struct output_fmt_data_t_ *);
+
+//! Callback Sink
+typedef struct
+{
+	const char *		name;		///< Sink Name
+	fmt_init_fn_t		init_fn;	///< Formatter Init Function (NULL for No-Op)
+
+} sink_t;
+
+//! Synthetic Dive Corpus
+typedef struct
+{
+	uint8_t *			data[NDIVES];		///< Dive Data
+	uint32_t			size[NDIVES];		///< Dive Size
+	uint64_t			waypoints[NDIVES];	///< Profile Waypoints per Dive
+	uint32_t			hdr_size;			///< Dive Header Size
+
+} corpus_t;
+
+//! Benchmark Result
+typedef struct
+{
+	double				hdr_rate;		///< Headers per Second
+	double				hdr_bps;		///< Header Bytes per Second
+	double				prof_rate;		///< Waypoints per Second
+	double				prof_bps;		///< Profile Bytes per Second
+
+} result_t;
+
+static const sink_t sinks[] =
+{
+	{ "no-op",	0 },
+	{ "csv",	csv_init_formatter },
+	{ "uddf",	uddf_init_formatter },
+};
+
+static void noop_cb(void *, uint8_t, int32_t, uint8_t, const char *)
+{
+}
+
+static void count_cb(void * userdata, uint8_t token, int32_t, uint8_t, const char *)
+{
+	if (token == DIVE_WAYPOINT_TIME)
+		(* static_cast<uint64_t *>(userdata))++;
+}
+
+static int fmt_open(struct output_fmt_data_t_ * fmt, const sink_t * sink, uint8_t model)
+{
+	memset(fmt, 0, sizeof(struct output_fmt_data_t_));
+
+	fmt->driver_name = "smart";
+	fmt->driver_args = "";
+	fmt->device_path = "";
+	fmt->dev_model = model;
+	fmt->output_file = NULL_DEVICE;
+	fmt->output_header = 1;
+	fmt->output_profile = 1;
+	fmt->quiet = 1;
+
+	if (! sink->init_fn)
+	{
+		fmt->header_cb = noop_cb;
+		fmt->profile_cb = noop_cb;
+		return 0;
+	}
+
+	return sink->init_fn(fmt);
+}
+
+static void fmt_close(struct output_fmt_data_t_ * fmt)
+{
+	if (fmt->close_fn)
+		fmt->close_fn(fmt);
+	if (fmt->dispose_fn)
+		fmt->dispose_fn(fmt);
+}
+
+/*
+ * Parse every dive in the corpus once, accumulating the time spent in the
+ * header and profile parsers (each including its formatter callbacks).  The
+ * formatter prolog and epilog are counted with the header and profile
+ * respectively, as that is where benthos-xfr pays for them.
+ */
+static int run_pass(parser_handle_t parser, struct smart_device_base_t * dev,
+		struct output_fmt_data_t_ * fmt, const corpus_t * c, double * t_hdr, double * t_prof)
+{
+	double t0, t1, t2;
+	int i;
+
+	for (i = 0; i < NDIVES; ++i)
+	{
+		t0 = bench_now();
+
+		if (fmt->prolog_fn && (fmt->prolog_fn(fmt) != 0))
+			return -1;
+
+		if ((smart_parser_reset(parser) != 0) ||
+			(smart_parser_parse_header(parser, c->data[i], c->size[i], fmt->header_cb, fmt) != 0))
+		{
+			fprintf(stderr, "Failed to parse header: %s\n", dev->errmsg);
+			return -1;
+		}
+
+		t1 = bench_now();
+
+		if (smart_parser_parse_profile(parser, c->data[i], c->size[i], fmt->profile_cb, fmt) != 0)
+		{
+			fprintf(stderr, "Failed to parse profile: %s\n", dev->errmsg);
+			return -1;
+		}
+
+		if (fmt->epilog_fn && (fmt->epilog_fn(fmt) != 0))
+			return -1;
+
+		t2 = bench_now();
+
+		* t_hdr += t1 - t0;
+		* t_prof += t2 - t1;
+	}
+
+	return 0;
+}
+
+static int time_sink(parser_handle_t parser, struct smart_device_base_t * dev, const sink_t * sink,
+		const corpus_t * c, double min_time, result_t * r)
+{
+	struct output_fmt_data_t_ fmt;
+	double t_hdr = 0;
+	double t_prof = 0;
+	uint64_t passes = 0;
+	uint64_t waypoints = 0;
+	uint64_t prof_bytes = 0;
+	int i;
+
+	for (i = 0; i < NDIVES; ++i)
+	{
+		waypoints += c->waypoints[i];
+		prof_bytes += c->size[i] - c->hdr_size;
+	}
+
+	/*
+	 * Each pass gets a fresh formatter so that the UDDF spool file does not
+	 * grow without bound; opening and closing it is not timed.
+	 */
+	do
+	{
+		int rv = fmt_open(& fmt, sink, dev->model);
+		if (rv != 0)
+		{
+			fprintf(stderr, "Failed to initialize %s formatter: %s\n", sink->name, strerror(rv));
+			return -1;
+		}
+
+		rv = run_pass(parser, dev, & fmt, c, & t_hdr, & t_prof);
+		fmt_close(& fmt);
+
+		if (rv != 0)
+			return -1;
+
+		passes++;
+	}
+	while (t_hdr + t_prof < min_time);
+
+	r->hdr_rate = passes * NDIVES / t_hdr;
+	r->hdr_bps = (double)passes * NDIVES * c->hdr_size / t_hdr;
+	r->prof_rate = passes * waypoints / t_prof;
+	r->prof_bps = passes * prof_bytes / t_prof;
+
+	return 0;
+}
+
+int main(int argc, char ** argv)
+{
+	double min_time = 0.5;
+	uint32_t rng = 0x5eed;
+	int m;
+	int s;
+	int i;
+
+	if (argc > 1)
+		min_time = atof(argv[1]);
+
+	printf("%-16s %-6s %12s %12s %12s %12s\n", "Model", "Sink",
+		"Hdr k/s", "Hdr MB/s", "Prof Mwp/s", "Prof MB/s");
+
+	for (m = 0; m < smart_corpus_nmodels; ++m)
+	{
+		const smart_model_def_t * model = & smart_corpus_models[m];
+		struct smart_device_base_t dev;
+		parser_handle_t parser;
+		corpus_t c;
+
+		memset(& dev, 0, sizeof(dev));
+		dev.model = model->model;
+
+		if (smart_parser_create(& parser, (dev_handle_t)(& dev)) != 0)
+		{
+			fprintf(stderr, "Failed to create parser for %s\n", model->name);
+			return 1;
+		}
+
+		/* Generate the Corpus and Count the Waypoints in each Dive */
+		c.hdr_size = model->hdr_size;
+		for (i = 0; i < NDIVES; ++i)
+		{
+			c.data[i] = smart_corpus_dive(model, NSAMPLES, i + 1, & rng, & c.size[i]);
+			if (c.data[i] == NULL)
+			{
+				fprintf(stderr, "Out of memory\n");
+				return 1;
+			}
+
+			c.waypoints[i] = 0;
+			smart_parser_reset(parser);
+			if (smart_parser_parse_profile(parser, c.data[i], c.size[i], count_cb, & c.waypoints[i]) != 0)
+			{
+				fprintf(stderr, "Failed to parse profile: %s\n", dev.errmsg);
+				return 1;
+			}
+		}
+
+		for (s = 0; s < (int)(sizeof(sinks) / sizeof(sink_t)); ++s)
+		{
+			result_t r;
+
+			if (time_sink(parser, & dev, & sinks[s], & c, min_time, & r) != 0)
+				return 1;
+
+			printf("%-16s %-6s %12.1f %12.2f %12.2f %12.2f\n", model->name, sinks[s].name,
+				r.hdr_rate / 1e3, r.hdr_bps / 1e6, r.prof_rate / 1e6, r.prof_bps / 1e6);
+		}
+
+		for (i = 0; i < NDIVES; ++i)
+			free(c.data[i]);
+
+		smart_parser_close(parser);
+	}
+
+	return 0;
+}
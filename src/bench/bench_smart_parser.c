@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ * www.asymworks.com / info@asymworks.com
+ *
+ * This file is part of the Benthos Dive Log Package (benthos-log.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * @file src/bench/bench_smart_parser.c
+ * @brief Smart Profile Decode Loop Benchmark
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ *
+ * Compares the profile decode loop specialized for each model's DTI table
+ * against the generic loop which reads the table at run time.
+ *
+ * Usage: bench_smart_parser [seconds per measurement]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <benthos/divecomputer/plugin/parser.h>
+
+#include <common-smart/smart_device_base.h>
+#include <common-smart/smart_parser.h>
+
+#include "bench_util.h"
+#include "smart_corpus.h"
+
+#define NDIVES		32
+#define NSAMPLES	4000
+
+typedef struct
+{
+	uint8_t *		data[NDIVES];
+	uint32_t		size[NDIVES];
+	uint64_t		bytes;
+
+} corpus_t;
+
+static void count_cb(void * userdata, uint8_t token, int32_t value, uint8_t index, const char * name)
+{
+	if (token == DIVE_WAYPOINT_TIME)
+		(* (uint64_t *)userdata)++;
+}
+
+static int time_profile(parser_handle_t parser, struct smart_device_base_t * dev, const corpus_t * c,
+		double min_time, double * sps, double * bps)
+{
+	uint64_t samples = 0;
+	uint64_t bytes = 0;
+	double start = bench_now();
+	double elapsed;
+	int i;
+
+	do
+	{
+		for (i = 0; i < NDIVES; ++i)
+		{
+			smart_parser_reset(parser);
+			if (smart_parser_parse_profile(parser, c->data[i], c->size[i], count_cb, & samples) != 0)
+			{
+				fprintf(stderr, "Failed to parse profile: %s\n", dev->errmsg);
+				return -1;
+			}
+		}
+
+		bytes += c->bytes;
+		elapsed = bench_now() - start;
+	}
+	while (elapsed < min_time);
+
+	* sps = samples / elapsed;
+	* bps = bytes / elapsed;
+	return 0;
+}
+
+int main(int argc, char ** argv)
+{
+	double min_time = 0.5;
+	uint32_t rng = 0x5eed;
+	int m;
+	int i;
+
+	if (argc > 1)
+		min_time = atof(argv[1]);
+
+	printf("%-16s %16s %16s %12s %8s\n", "Model", "Generic Ms/s", "Specialized Ms/s", "MB/s", "Speedup");
+
+	for (m = 0; m < smart_corpus_nmodels; ++m)
+	{
+		const smart_model_def_t * model = & smart_corpus_models[m];
+		struct smart_device_base_t dev;
+		parser_handle_t parser;
+		corpus_t c;
+		double gen_sps, gen_bps;
+		double spec_sps, spec_bps;
+
+		memset(& dev, 0, sizeof(dev));
+		dev.model = model->model;
+
+		if (smart_parser_create(& parser, (dev_handle_t)(& dev)) != 0)
+		{
+			fprintf(stderr, "Failed to create parser for %s\n", model->name);
+			return 1;
+		}
+
+		c.bytes = 0;
+		for (i = 0; i < NDIVES; ++i)
+		{
+			c.data[i] = smart_corpus_dive(model, NSAMPLES, i + 1, & rng, & c.size[i]);
+			if (c.data[i] == NULL)
+			{
+				fprintf(stderr, "Out of memory\n");
+				return 1;
+			}
+
+			c.bytes += c.size[i];
+		}
+
+		smart_parser_set_specialized(parser, 0);
+		if (time_profile(parser, & dev, & c, min_time, & gen_sps, & gen_bps) != 0)
+			return 1;
+
+		smart_parser_set_specialized(parser, 1);
+		if (time_profile(parser, & dev, & c, min_time, & spec_sps, & spec_bps) != 0)
+			return 1;
+
+		printf("%-16s %16.2f %16.2f %12.1f %7.2fx\n", model->name,
+			gen_sps / 1e6, spec_sps / 1e6, spec_bps / 1e6, spec_sps / gen_sps);
+
+		for (i = 0; i < NDIVES; ++i)
+			free(c.data[i]);
+
+		smart_parser_close(parser);
+	}
+
+	return 0;
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ * www.asymworks.com / info@asymworks.com
+ *
+ * This file is part of the Benthos Dive Log Package (benthos-log.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "bench_util.h"
+
+double bench_now(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER freq;
+	LARGE_INTEGER now;
+
+	QueryPerformanceFrequency(& freq);
+	QueryPerformanceCounter(& now);
+
+	return (double)now.QuadPart / (double)freq.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, & ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+uint32_t bench_rand(uint32_t * state)
+{
+	uint32_t x = * state;
+
+	/* xorshift32 */
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+
+	* state = x;
+	return x;
+}
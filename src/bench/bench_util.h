@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ * www.asymworks.com / info@asymworks.com
+ *
+ * This file is part of the Benthos Dive Log Package (benthos-log.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef BENCH_UTIL_H_
+#define BENCH_UTIL_H_
+
+/**
+ * @file src/bench/bench_util.h
+ * @brief Benchmark Timing and Random Number Utilities
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+ * @brief Monotonic Time in Seconds
+ */
+double bench_now(void);
+
+/**
+ * @brief Deterministic Pseudo-Random Number
+ * @param[in,out] Generator State (must be non-zero)
+ *
+ * Benchmark inputs are generated from a fixed seed so that runs on
+ * different machines and builds parse identical data.
+ */
+uint32_t bench_rand(uint32_t * state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BENCH_UTIL_H_ */
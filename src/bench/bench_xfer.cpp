@@ -0,0 +1,492 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ * www.asymworks.com / info@asymworks.com
+ *
+ * This file is part of the Benthos Dive Log Package (benthos-log.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * @file src/bench/bench_xfer.cpp
+ * @brief Smart-I Transfer Encoding Benchmark
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ *
+ * Encodes transfer buffers in each Smart-I XFER encoding the way smartid
+ * sends them (fed in device-sized reads, with the same line and frame sizes)
+ * and decodes them the way the smarti client reads them.  For each encoding
+ * it reports the bytes on the wire, the encode and decode CPU time, and the
+ * end-to-end time over links of a few speeds, taken as the CPU time plus the
+ * time to send the wire bytes.
+ *
+ * Inputs are a synthetic transfer for every Smart model, followed by any
+ * files named on the command line.  A file may be a benthos-xfr dump file,
+ * in which case every transfer in it is used, or a raw transfer buffer.
+ *
+ * Usage: bench_xfer [-t seconds per measurement] [file ...]
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include <benthos/divecomputer/base64.h>
+
+#include <xfer_dump.h>
+
+#include "bench_util.h"
+#include "smart_corpus.h"
+
+#define NDIVES			32
+#define NSAMPLES		4000
+
+#define DEVICE_READ		32			///< Largest Device Read (smartid chunk size)
+#define B64_BLOCK		3072		///< Bytes per Chunked Base 64 Line
+#define BIN_FRAME		4096		///< Largest Binary Frame
+
+//! Transfer Encodings
+enum
+{
+	ENC_B64_LINE,
+	ENC_B64_CHUNKED,
+	ENC_BINARY,
+	ENC_DEFLATE_1,
+	ENC_DEFLATE_6,
+	ENC_DEFLATE_9,
+	ENC_COUNT
+};
+
+static const char * enc_names[ENC_COUNT] =
+{
+	"base64", "chunked", "binary", "deflate-1", "deflate-6", "deflate-9"
+};
+
+static const int enc_levels[ENC_COUNT] = { 0, 0, 0, 1, 6, 9 };
+
+//! Link Speeds for End-to-End Times (bits per second)
+static const double link_bps[] = { 64e3, 1e6, 10e6 };
+#define NLINKS	(int)(sizeof(link_bps) / sizeof(double))
+
+//! Transfer Input
+typedef struct
+{
+	std::string					name;		///< Input Name
+	std::vector<uint8_t>		data;		///< Transfer Buffer
+
+} input_t;
+
+static void put_str(std::vector<uint8_t> & wire, const char * s)
+{
+	wire.insert(wire.end(), s, s + strlen(s));
+}
+
+static void put_frame(std::vector<uint8_t> & wire, const uint8_t * data, size_t len)
+{
+	uint8_t hdr[4] = { (uint8_t)(len >> 24), (uint8_t)(len >> 16), (uint8_t)(len >> 8), (uint8_t)len };
+
+	wire.insert(wire.end(), hdr, hdr + 4);
+	wire.insert(wire.end(), data, data + len);
+}
+
+/*
+ * Encode a transfer as smartid does, including the 301/302 reply and the
+ * final status line, so that the wire byte count is exact.
+ */
+static int encode(int enc, const std::vector<uint8_t> & in, std::vector<uint8_t> & wire)
+{
+	char line[64];
+	char out[BASE64_ENCODE_BOUND(DEVICE_READ) + 4];
+	uint8_t frame[BIN_FRAME];
+	base64_encoder_t b64;
+	z_stream zs;
+	size_t fill = 0;
+	size_t pos;
+	size_t n;
+	int rv;
+
+	wire.clear();
+
+	switch (enc)
+	{
+	case ENC_B64_LINE:
+		snprintf(line, sizeof(line), "301 Data Follows: %u\n", (unsigned)BASE64_ENCODE_BOUND(in.size()));
+		break;
+	case ENC_B64_CHUNKED:
+		snprintf(line, sizeof(line), "302 Data Follows: %u\n", (unsigned)in.size());
+		break;
+	case ENC_BINARY:
+		snprintf(line, sizeof(line), "301 Binary Data Follows: %u\n", (unsigned)in.size());
+		break;
+	default:
+		snprintf(line, sizeof(line), "301 Deflate Data Follows: %u\n", (unsigned)in.size());
+		break;
+	}
+
+	put_str(wire, line);
+
+	base64_encoder_init(& b64);
+	memset(& zs, 0, sizeof(z_stream));
+	if ((enc >= ENC_DEFLATE_1) && (deflateInit(& zs, enc_levels[enc]) != Z_OK))
+		return -1;
+
+	for (pos = 0; pos < in.size(); pos += n)
+	{
+		n = in.size() - pos;
+		if (n > DEVICE_READ)
+			n = DEVICE_READ;
+
+		switch (enc)
+		{
+		case ENC_B64_LINE:
+		case ENC_B64_CHUNKED:
+			{
+				/* Device Reads divide B64_BLOCK, so Lines fall between Reads */
+				size_t nc = base64_encode_update(& b64, & in[pos], n, out);
+				wire.insert(wire.end(), out, out + nc);
+
+				fill += n;
+				if (fill == B64_BLOCK)
+				{
+					if (enc == ENC_B64_CHUNKED)
+						wire.push_back('\n');
+					fill = 0;
+				}
+			}
+			break;
+
+		case ENC_BINARY:
+			memcpy(frame + fill, & in[pos], n);
+			fill += n;
+			if (fill == BIN_FRAME)
+			{
+				put_frame(wire, frame, fill);
+				fill = 0;
+			}
+			break;
+
+		default:
+			zs.next_in = (Bytef *)& in[pos];
+			zs.avail_in = n;
+			do
+			{
+				zs.next_out = frame + fill;
+				zs.avail_out = BIN_FRAME - fill;
+				deflate(& zs, Z_NO_FLUSH);
+				fill = BIN_FRAME - zs.avail_out;
+				if (fill == BIN_FRAME)
+				{
+					put_frame(wire, frame, fill);
+					fill = 0;
+				}
+			}
+			while (zs.avail_in > 0);
+			break;
+		}
+	}
+
+	switch (enc)
+	{
+	case ENC_B64_LINE:
+		n = base64_encode_final(& b64, out);
+		wire.insert(wire.end(), out, out + n);
+		wire.push_back('\n');
+		break;
+
+	case ENC_B64_CHUNKED:
+		n = base64_encode_final(& b64, out);
+		wire.insert(wire.end(), out, out + n);
+		if (fill)
+			wire.push_back('\n');
+		wire.push_back('\n');
+		put_str(wire, "210 Transfer Complete\n");
+		break;
+
+	default:
+		if (enc >= ENC_DEFLATE_1)
+		{
+			do
+			{
+				zs.next_out = frame + fill;
+				zs.avail_out = BIN_FRAME - fill;
+				rv = deflate(& zs, Z_FINISH);
+				fill = BIN_FRAME - zs.avail_out;
+				if ((fill == BIN_FRAME) || (rv == Z_STREAM_END))
+				{
+					put_frame(wire, frame, fill);
+					fill = 0;
+				}
+			}
+			while (rv != Z_STREAM_END);
+
+			deflateEnd(& zs);
+		}
+		else if (fill)
+		{
+			put_frame(wire, frame, fill);
+		}
+
+		put_frame(wire, 0, 0);
+		put_str(wire, "210 Transfer Complete\n");
+		break;
+	}
+
+	return 0;
+}
+
+/*
+ * Decode a transfer as the smarti client does into a buffer with room for
+ * whole Base 64 groups, returning -1 unless exactly len bytes are produced.
+ * The reply line is skipped, as the client has read it before the data.
+ */
+static int decode(int enc, const std::vector<uint8_t> & wire, std::vector<uint8_t> & out, size_t len)
+{
+	const uint8_t * p = & wire[0];
+	const uint8_t * end = p + wire.size();
+	const uint8_t * eol;
+	base64_decoder_t b64;
+	z_stream zs;
+	size_t pos = 0;
+	size_t n;
+	uint32_t flen;
+	int rv = Z_OK;
+
+	p = (const uint8_t *)memchr(p, '\n', end - p) + 1;
+
+	switch (enc)
+	{
+	case ENC_B64_LINE:
+		eol = (const uint8_t *)memchr(p, '\n', end - p);
+		if (base64_decode_buf((const char *)p, eol - p, & out[0], & n) != 0)
+			return -1;
+		return (n == len) ? 0 : -1;
+
+	case ENC_B64_CHUNKED:
+		base64_decoder_init(& b64);
+		while ((eol = (const uint8_t *)memchr(p, '\n', end - p)) != p)
+		{
+			if (base64_decode_update(& b64, (const char *)p, eol - p, & out[pos], & n) != 0)
+				return -1;
+			pos += n;
+			p = eol + 1;
+		}
+		return ((base64_decode_final(& b64) == 0) && (pos == len)) ? 0 : -1;
+
+	default:
+		memset(& zs, 0, sizeof(z_stream));
+		if ((enc >= ENC_DEFLATE_1) && (inflateInit(& zs) != Z_OK))
+			return -1;
+
+		for (;;)
+		{
+			flen = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+			p += 4;
+			if (flen == 0)
+				break;
+
+			if (enc == ENC_BINARY)
+			{
+				memcpy(& out[pos], p, flen);
+				pos += flen;
+			}
+			else
+			{
+				zs.next_in = (Bytef *)p;
+				zs.avail_in = flen;
+				zs.next_out = & out[pos];
+				zs.avail_out = len - pos;
+				rv = inflate(& zs, Z_NO_FLUSH);
+				pos = len - zs.avail_out;
+			}
+
+			p += flen;
+		}
+
+		if (enc >= ENC_DEFLATE_1)
+		{
+			inflateEnd(& zs);
+			if (rv != Z_STREAM_END)
+				return -1;
+		}
+
+		return (pos == len) ? 0 : -1;
+	}
+}
+
+static int run_input(const input_t & in, double min_time)
+{
+	std::vector<uint8_t> wire;
+	std::vector<uint8_t> out(BASE64_DECODE_BOUND(BASE64_ENCODE_BOUND(in.data.size())));
+	double t0;
+	double t_enc;
+	double t_dec;
+	uint64_t passes;
+	int e;
+	int l;
+
+	for (e = 0; e < ENC_COUNT; ++e)
+	{
+		/* Check the Round Trip once before Timing it */
+		if ((encode(e, in.data, wire) != 0) || (decode(e, wire, out, in.data.size()) != 0) ||
+			(memcmp(& out[0], & in.data[0], in.data.size()) != 0))
+		{
+			fprintf(stderr, "%s: %s round trip failed\n", in.name.c_str(), enc_names[e]);
+			return -1;
+		}
+
+		passes = 0;
+		t0 = bench_now();
+		do
+		{
+			encode(e, in.data, wire);
+			passes++;
+		}
+		while (bench_now() - t0 < min_time);
+		t_enc = (bench_now() - t0) / passes;
+
+		passes = 0;
+		t0 = bench_now();
+		do
+		{
+			decode(e, wire, out, in.data.size());
+			passes++;
+		}
+		while (bench_now() - t0 < min_time);
+		t_dec = (bench_now() - t0) / passes;
+
+		printf("%-20s %-10s %10u %6.1f%% %9.3f %9.3f", in.name.c_str(), enc_names[e],
+			(unsigned)wire.size(), 100.0 * wire.size() / in.data.size(), t_enc * 1e3, t_dec * 1e3);
+
+		for (l = 0; l < NLINKS; ++l)
+			printf(" %10.1f", (t_enc + t_dec + wire.size() * 8 / link_bps[l]) * 1e3);
+		printf("\n");
+	}
+
+	return 0;
+}
+
+static int load_file(const char * path, std::vector<input_t> & inputs)
+{
+	std::vector<uint8_t> file;
+	std::vector<dump_frame_t> frames;
+	uint8_t buf[65536];
+	size_t n;
+	size_t i;
+	int rv;
+
+	FILE * fp = fopen(path, "rb");
+	if (! fp)
+		return errno;
+
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+		file.insert(file.end(), buf, buf + n);
+	fclose(fp);
+
+	/* Raw Transfer Buffer */
+	if (file.empty() || ! xfer_dump_check(& file[0], file.size()))
+	{
+		input_t in;
+		in.name = path;
+		in.data.swap(file);
+		if (! in.data.empty())
+			inputs.push_back(in);
+		return 0;
+	}
+
+	/* Every Transfer in a Dump File */
+	rv = xfer_dump_frames(& file[0], file.size(), frames);
+	if (rv != 0)
+		return rv;
+
+	for (i = 0; i < frames.size(); ++i)
+	{
+		input_t in;
+		in.name = std::string(path) + "#" + std::to_string(i);
+		in.data.assign(frames[i].data, frames[i].data + frames[i].length);
+		if (! in.data.empty())
+			inputs.push_back(in);
+	}
+
+	return 0;
+}
+
+int main(int argc, char ** argv)
+{
+	std::vector<input_t> inputs;
+	double min_time = 0.2;
+	uint32_t rng = 0x5eed;
+	uint32_t size;
+	uint8_t * dive;
+	int m;
+	int i;
+	int l;
+
+	/* Synthetic Transfers */
+	for (m = 0; m < smart_corpus_nmodels; ++m)
+	{
+		input_t in;
+		in.name = smart_corpus_models[m].name;
+
+		for (i = 0; i < NDIVES; ++i)
+		{
+			dive = smart_corpus_dive(& smart_corpus_models[m], NSAMPLES, i + 1, & rng, & size);
+			if (dive == NULL)
+			{
+				fprintf(stderr, "Out of memory\n");
+				return 1;
+			}
+
+			in.data.insert(in.data.end(), dive, dive + size);
+			free(dive);
+		}
+
+		inputs.push_back(in);
+	}
+
+	/* Recorded Transfers */
+	for (i = 1; i < argc; ++i)
+	{
+		if ((strcmp(argv[i], "-t") == 0) && (i + 1 < argc))
+		{
+			min_time = atof(argv[++i]);
+			continue;
+		}
+
+		int rv = load_file(argv[i], inputs);
+		if (rv != 0)
+		{
+			fprintf(stderr, "Failed to read %s: %s\n", argv[i], strerror(rv));
+			return 1;
+		}
+	}
+
+	printf("%-20s %-10s %10s %7s %9s %9s", "Input", "Encoding", "Wire B", "Wire %", "Enc ms", "Dec ms");
+	for (l = 0; l < NLINKS; ++l)
+		printf(" %7.0fk ms", link_bps[l] / 1e3);
+	printf("\n");
+
+	for (i = 0; i < (int)inputs.size(); ++i)
+	{
+		if (run_input(inputs[i], min_time) != 0)
+			return 1;
+	}
+
+	return 0;
+}
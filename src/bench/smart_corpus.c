@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ * www.asymworks.com / info@asymworks.com
+ *
+ * This file is part of the Benthos Dive Log Package (benthos-log.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_util.h"
+#include "smart_corpus.h"
+
+/*
+ * Weights are a rough approximation of real logs: most samples are one-byte
+ * depth deltas, with temperature, pressure and time samples less often and
+ * absolute values and alarms rare.
+ */
+
+// Model Type 16 (Smart Pro)
+static const smart_sample_def_t smart_pro_samples[] =
+{
+	{ "0ddd dddd",										SAMPLE_DELTA,		600 },
+	{ "10dd dddd",										SAMPLE_DELTA,		120 },
+	{ "110d dddd",										SAMPLE_TIME,		40 },
+	{ "1110 dddd",										SAMPLE_FLAGS,		5 },
+	{ "1111 0ddd dddd dddd",							SAMPLE_DELTA,		60 },
+	{ "1111 10dd dddd dddd",							SAMPLE_DELTA,		10 },
+	{ "1111 110x dddd dddd dddd dddd",					SAMPLE_ABSOLUTE,	4 },
+	{ "1111 1110 dddd dddd dddd dddd",					SAMPLE_ABSOLUTE,	2 },
+};
+
+// Model Type 17 (Galileo Sol)
+static const smart_sample_def_t smart_galileo_sol_samples[] =
+{
+	{ "0ddd dddd",										SAMPLE_DELTA,		600 },
+	{ "100d dddd",										SAMPLE_DELTA,		80 },
+	{ "1010 dddd",										SAMPLE_DELTA,		120 },
+	{ "1011 dddd",										SAMPLE_DELTA,		60 },
+	{ "1100 dddd",										SAMPLE_TIME,		40 },
+	{ "1101 dddd",										SAMPLE_DELTA,		40 },
+	{ "1110 dddd",										SAMPLE_FLAGS,		5 },
+	{ "1111 0000 dddd dddd",							SAMPLE_FLAGS,		2 },
+	{ "1111 0001 dddd dddd dddd dddd",					SAMPLE_ABSOLUTE,	4 },
+	{ "1111 0010 dddd dddd",							SAMPLE_ABSOLUTE,	4 },
+	{ "1111 0011 dddd dddd dddd dddd",					SAMPLE_ABSOLUTE,	2 },
+	{ "1111 0100 dddd dddd dddd dddd",					SAMPLE_ABSOLUTE,	4 },
+	{ "1111 0101 dddd dddd dddd dddd",					SAMPLE_ABSOLUTE,	1 },
+	{ "1111 0110 dddd dddd dddd dddd",					SAMPLE_ABSOLUTE,	1 },
+	{ "1111 0111 dddd dddd",							SAMPLE_ABSOLUTE,	4 },
+	{ "1111 1000 dddd dddd dddd dddd",					SAMPLE_ABSOLUTE,	10 },
+	{ "1111 1001 dddd dddd",							SAMPLE_FLAGS,		2 },
+};
+
+// Model Type 18 (Aladin Tec)
+// Model Type 19 (Aladin Tec 2G)
+static const smart_sample_def_t smart_aladin_samples[] =
+{
+	{ "0ddd dddd",										SAMPLE_DELTA,		600 },
+	{ "10dd dddd",										SAMPLE_DELTA,		120 },
+	{ "110d dddd",										SAMPLE_TIME,		40 },
+	{ "1110 dddd",										SAMPLE_FLAGS,		5 },
+	{ "1111 0ddd dddd dddd",							SAMPLE_DELTA,		60 },
+	{ "1111 10dd dddd dddd",							SAMPLE_DELTA,		10 },
+	{ "1111 110x dddd dddd dddd dddd",					SAMPLE_ABSOLUTE,	4 },
+	{ "1111 1110 dddd dddd dddd dddd",					SAMPLE_ABSOLUTE,	2 },
+	{ "1111 1111 0ddd dddd",							SAMPLE_FLAGS,		5 },
+};
+
+// Model Type 20 (Smart Com)
+static const smart_sample_def_t smart_com_samples[] =
+{
+	{ "0ddd dddd dddd dddd",							SAMPLE_PX_DEPTH,	600 },
+	{ "10dd dddd",										SAMPLE_DELTA,		80 },
+	{ "110d dddd",										SAMPLE_DELTA,		120 },
+	{ "1110 dddd dddd dddd",							SAMPLE_DELTA,		40 },
+	{ "1111 0ddd dddd dddd",							SAMPLE_DELTA,		60 },
+	{ "1111 10dd dddd dddd",							SAMPLE_DELTA,		10 },
+	{ "1111 110x dddd dddd",							SAMPLE_FLAGS,		5 },
+	{ "1111 1110 dddd dddd",							SAMPLE_TIME,		40 },
+	{ "1111 1111 0xxx xxxx dddd dddd dddd dddd",		SAMPLE_ABSOLUTE,	4 },
+	{ "1111 1111 10xx xxxx dddd dddd dddd dddd",		SAMPLE_ABSOLUTE,	2 },
+	{ "1111 1111 110x xxxx dddd dddd dddd dddd",		SAMPLE_ABSOLUTE,	4 },
+	{ "1111 1111 1110 xxxx dddd dddd",					SAMPLE_ABSOLUTE,	4 },
+};
+
+// Model Type 24 (Smart Tec)
+// Model Type 28 (Smart Z)
+static const smart_sample_def_t smart_tec_samples[] =
+{
+	{ "0ddd dddd dddd dddd",							SAMPLE_PX_DEPTH,	600 },
+	{ "10dd dddd",										SAMPLE_DELTA,		80 },
+	{ "110d dddd",										SAMPLE_DELTA,		120 },
+	{ "1110 dddd dddd dddd",							SAMPLE_DELTA,		40 },
+	{ "1111 0ddd dddd dddd",							SAMPLE_DELTA,		60 },
+	{ "1111 10dd dddd dddd",							SAMPLE_DELTA,		10 },
+	{ "1111 110x dddd dddd",							SAMPLE_FLAGS,		5 },
+	{ "1111 1110 dddd dddd",							SAMPLE_TIME,		40 },
+	{ "1111 1111 0xxx xxxx dddd dddd dddd dddd",		SAMPLE_ABSOLUTE,	4 },
+	{ "1111 1111 10xx xxxx dddd dddd dddd dddd",		SAMPLE_ABSOLUTE,	2 },
+	{ "1111 1111 110x xxxx dddd dddd dddd dddd",		SAMPLE_ABSOLUTE,	4 },
+	{ "1111 1111 1110 xxxx dddd dddd dddd dddd",		SAMPLE_ABSOLUTE,	1 },
+	{ "1111 1111 1111 0xxx dddd dddd dddd dddd",		SAMPLE_ABSOLUTE,	1 },
+	{ "1111 1111 1111 10xx dddd dddd",					SAMPLE_ABSOLUTE,	4 },
+};
+
+#define NSAMPLES(t)		(int)(sizeof(t) / sizeof(smart_sample_def_t))
+
+const smart_model_def_t smart_corpus_models[] =
+{
+	{ 16,	"Smart Pro",		92,		smart_pro_samples,			NSAMPLES(smart_pro_samples) },
+	{ 17,	"Galileo Sol",		152,	smart_galileo_sol_samples,	NSAMPLES(smart_galileo_sol_samples) },
+	{ 18,	"Aladin Tec",		108,	smart_aladin_samples,		NSAMPLES(smart_aladin_samples) },
+	{ 19,	"Aladin Tec 2G",	116,	smart_aladin_samples,		NSAMPLES(smart_aladin_samples) },
+	{ 20,	"Smart Com",		100,	smart_com_samples,			NSAMPLES(smart_com_samples) },
+	{ 24,	"Smart Tec",		132,	smart_tec_samples,			NSAMPLES(smart_tec_samples) },
+	{ 28,	"Smart Z",			132,	smart_tec_samples,			NSAMPLES(smart_tec_samples) },
+};
+
+const int smart_corpus_nmodels = sizeof(smart_corpus_models) / sizeof(smart_model_def_t);
+
+static uint32_t sample_value(char kind, int nbits, uint32_t * rng)
+{
+	uint32_t r = bench_rand(rng);
+	int32_t v;
+
+	switch (kind)
+	{
+	case SAMPLE_DELTA:
+		v = (int32_t)(r % 7) - 3;
+		return (uint32_t)v;
+
+	case SAMPLE_TIME:
+		return 1 + r % 4;
+
+	case SAMPLE_FLAGS:
+		return ((r & 0xFF) < 32) ? (1u << ((r >> 8) % 3)) : 0;
+
+	case SAMPLE_PX_DEPTH:
+		v = (int32_t)(r % 5) - 2;
+		return ((((r >> 8) % 3) ? 0 : 0x7F) << 8) | ((uint32_t)v & 0xFF);
+
+	default:
+		return r & ((nbits < 12) ? ((1u << nbits) - 1) : 0xFFF);
+	}
+}
+
+static uint32_t encode_sample(uint8_t * out, const smart_sample_def_t * def, uint32_t * rng)
+{
+	const char * p;
+	uint32_t value;
+	uint32_t nbits = 0;
+	uint32_t bit = 0;
+
+	for (p = def->code; * p; ++p)
+		if (* p == 'd')
+			nbits++;
+
+	value = sample_value(def->kind, nbits, rng);
+
+	for (p = def->code; * p; ++p)
+	{
+		int b;
+
+		switch (* p)
+		{
+		case '0':
+		case 'x':
+			b = 0;
+			break;
+		case '1':
+			b = 1;
+			break;
+		case 'd':
+			b = (value >> --nbits) & 1;
+			break;
+		default:
+			continue;
+		}
+
+		if ((bit % 8) == 0)
+			out[bit / 8] = 0;
+		if (b)
+			out[bit / 8] |= (uint8_t)(0x80 >> (bit % 8));
+		bit++;
+	}
+
+	return bit / 8;
+}
+
+uint8_t * smart_corpus_dive(const smart_model_def_t * model, uint32_t nsamples,
+		uint32_t token, uint32_t * rng, uint32_t * size)
+{
+	uint32_t total = 0;
+	uint32_t cap;
+	uint32_t pos;
+	uint32_t i;
+	int k;
+	uint8_t * d;
+
+	for (k = 0; k < model->nsamples; ++k)
+		total += model->samples[k].weight;
+
+	/* No Sample Encoding is Longer than 6 Bytes */
+	cap = model->hdr_size + nsamples * 6;
+	d = (uint8_t *)malloc(cap);
+	if (d == NULL)
+		return NULL;
+
+	/* Random Header Body with a Valid Length and Token */
+	for (pos = 0; pos < model->hdr_size; ++pos)
+		d[pos] = (uint8_t)bench_rand(rng);
+
+	d[0] = 0xa5;
+	d[1] = 0xa5;
+	d[2] = 0x5a;
+	d[3] = 0x5a;
+	d[8] = (uint8_t)(token);
+	d[9] = (uint8_t)(token >> 8);
+	d[10] = (uint8_t)(token >> 16);
+	d[11] = (uint8_t)(token >> 24);
+
+	for (i = 0; i < nsamples; ++i)
+	{
+		uint32_t w = bench_rand(rng) % total;
+
+		for (k = 0; w >= model->samples[k].weight; ++k)
+			w -= model->samples[k].weight;
+
+		pos += encode_sample(d + pos, & model->samples[k], rng);
+	}
+
+	d[4] = (uint8_t)(pos);
+	d[5] = (uint8_t)(pos >> 8);
+	d[6] = (uint8_t)(pos >> 16);
+	d[7] = (uint8_t)(pos >> 24);
+
+	* size = pos;
+	return d;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ * www.asymworks.com / info@asymworks.com
+ *
+ * This file is part of the Benthos Dive Log Package (benthos-log.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef SMART_CORPUS_H_
+#define SMART_CORPUS_H_
+
+/**
+ * @file src/bench/smart_corpus.h
+ * @brief Synthetic Uwatec Smart Dive Generator
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+ * @brief Synthetic Sample Encoding
+ *
+ * The code gives the bits of the encoded sample, most significant first, in
+ * the same notation as the DTI table comments in smart_parser.c: '0' and '1'
+ * are type bits, 'x' are ignored bits and 'd' are value bits.  Spaces are
+ * skipped.
+ */
+typedef struct
+{
+	const char *		code;		///< Sample Bit Pattern
+	char				kind;		///< Value Kind (see below)
+	uint16_t			weight;		///< Relative Frequency
+
+} smart_sample_def_t;
+
+/**@{
+ * @name Sample Value Kinds
+ */
+#define SAMPLE_DELTA		'D'		///< Small Signed Delta
+#define SAMPLE_ABSOLUTE		'A'		///< Absolute Value
+#define SAMPLE_TIME			'T'		///< Sample Repeat Count
+#define SAMPLE_FLAGS		'F'		///< Alarm Flags (mostly clear)
+#define SAMPLE_PX_DEPTH		'P'		///< Packed Pressure/Depth Deltas
+/*@}*/
+
+/**
+ * @brief Synthetic Model Definition
+ */
+typedef struct
+{
+	uint8_t						model;		///< Model Number
+	const char *				name;		///< Model Name
+	uint32_t					hdr_size;	///< Dive Header Size
+	const smart_sample_def_t *	samples;	///< Sample Encodings
+	int							nsamples;	///< Number of Sample Encodings
+
+} smart_model_def_t;
+
+//! Synthetic Model Definitions for every Model Supported by the Parser
+extern const smart_model_def_t smart_corpus_models[];
+
+//! Number of Synthetic Model Definitions
+extern const int smart_corpus_nmodels;
+
+/**
+ * @brief Generate a Synthetic Dive
+ * @param[in] Model Definition
+ * @param[in] Number of Encoded Samples
+ * @param[in] Dive Token
+ * @param[in,out] Random Generator State
+ * @param[out] Dive Size
+ * @return Dive Buffer, which the caller must free, or NULL
+ *
+ * The dive has a valid length and token but a random header body, followed
+ * by a profile drawn from the model's sample encodings by weight.
+ */
+uint8_t * smart_corpus_dive(const smart_model_def_t * model, uint32_t nsamples,
+		uint32_t token, uint32_t * rng, uint32_t * size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SMART_CORPUS_H_ */
@@ -27,8 +27,10 @@
 /* #define HAVE_POLL */
 #define HAVE_SELECT
 
+#include <limits.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #if defined(_WIN32) || defined(WIN32)
@@ -40,7 +42,6 @@
 #else
 #include <errno.h>			// errno
 #include <fcntl.h>			// fcntl
-#include <string.h>			// strerror
 #include <unistd.h>			// sleep, close
 #include <sys/ioctl.h>		// ioctl
 #include <sys/socket.h>		// socket
@@ -69,20 +70,16 @@
 #endif
 
 #include "irda.h"
+#include "irda_transport.h"
 
 #if defined(_WIN32) || defined(WIN32)
-typedef SOCKET			socket_t;
 typedef int 			socklen_t;
 #else
-typedef int				socket_t;
 #define INVALID_SOCKET	(socket_t)(-1)
 #endif
 
-struct _irda_t
-{
-	socket_t	fd;
-	long		timeout;
-};
+static const irda_transport_t irda_os_transport;
+static const irda_transport_t * g_transport = & irda_os_transport;
 
 int irda_errcode(void)
 {
@@ -172,6 +169,62 @@ int irda_cleanup(void)
 	}
 #endif
 
+/*
+ * Monotonic time in microseconds.  Deadlines must not use clock(), which
+ * counts processor time and so barely advances while blocked in select().
+ */
+long long irda_clock_us(void)
+{
+#if defined(_WIN32) || defined(WIN32)
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER t;
+
+	if (freq.QuadPart == 0)
+		QueryPerformanceFrequency(& freq);
+
+	QueryPerformanceCounter(& t);
+	return (long long)(t.QuadPart / freq.QuadPart) * 1000000 +
+		(long long)(t.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart;
+#else
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, & t);
+	return (long long)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+#endif
+}
+
+static int os_socket_open(irda_t s)
+{
+	s->fd = socket(AF_IRDA, SOCK_STREAM, 0);
+	if (s->fd == INVALID_SOCKET)
+		return -1;
+
+	return 0;
+}
+
+static int os_socket_close(irda_t s)
+{
+	shutdown(s->fd, 0);
+
+#if defined(_WIN32) || defined(WIN32)
+	if (closesocket(s->fd) != 0)
+#else
+	if (close(s->fd) != 0)
+#endif
+		return -1;
+
+	return 0;
+}
+
+void irda_set_transport(const irda_transport_t * t)
+{
+	g_transport = t ? t : & irda_os_transport;
+}
+
+const char * irda_transport_name(void)
+{
+	return g_transport->name;
+}
+
 int irda_socket_open(irda_t * s)
 {
 	irda_t device;
@@ -190,8 +243,13 @@ int irda_socket_open(irda_t * s)
 	}
 
 	device->timeout = -1;
-	device->fd = socket(AF_IRDA, SOCK_STREAM, 0);
-	if (device->fd == INVALID_SOCKET)
+	device->deadline = 0;
+	device->fd = INVALID_SOCKET;
+	device->ops = g_transport;
+	device->priv = NULL;
+	memset(& device->stats, 0, sizeof(irda_stats_t));
+
+	if (device->ops->open(device) != 0)
 	{
 		free (device);
 		return -1;
@@ -204,22 +262,13 @@ int irda_socket_open(irda_t * s)
 
 int irda_socket_close(irda_t s)
 {
+	int rc;
 	CHECK_IRDA_HANDLE(s)
 
-	shutdown(s->fd, 0);
-
-#if defined(_WIN32) || defined(WIN32)
-	if (closesocket(s->fd) != 0)
-#else
-	if (close(s->fd) != 0)
-#endif
-	{
-		free(s);
-		return -1;
-	}
+	rc = s->ops->close(s);
 
 	free(s);
-	return 0;
+	return rc;
 }
 
 void irda_socket_shutdown(irda_t s)
@@ -267,6 +316,87 @@ int irda_socket_timeout(irda_t s, long * timeout)
 	return 0;
 }
 
+int irda_socket_set_deadline(irda_t s, long budget)
+{
+	long long now;
+
+	CHECK_IRDA_HANDLE(s)
+
+	now = irda_clock_us();
+
+	/* A Budget past the Range of the Clock is No Deadline */
+	if ((budget > 0) && ((long long)budget < (LLONG_MAX - now) / 1000))
+		s->deadline = now + (long long)budget * 1000;
+	else
+		s->deadline = 0;
+
+	return 0;
+}
+
+int irda_socket_set_budget(irda_t s, unsigned long nbytes)
+{
+	unsigned long long budget;
+	long timeout;
+
+	CHECK_IRDA_HANDLE(s)
+
+	timeout = (s->timeout < 0) ? 0 : s->timeout;
+
+	/* Scale in Parts and Clamp, so that Huge Sizes cannot Overflow */
+	if (nbytes / IRDA_XFER_MIN_RATE > LONG_MAX / 1000)
+		return irda_socket_set_deadline(s, LONG_MAX);
+
+	budget = (unsigned long long)(nbytes / IRDA_XFER_MIN_RATE) * 1000
+		+ (unsigned long long)(nbytes % IRDA_XFER_MIN_RATE) * 1000 / IRDA_XFER_MIN_RATE;
+
+	if (budget > (unsigned long long)(LONG_MAX - timeout))
+		budget = LONG_MAX;
+	else
+		budget += timeout;
+
+	return irda_socket_set_deadline(s, (long)budget);
+}
+
+int irda_socket_stats(irda_t s, irda_stats_t * stats)
+{
+	CHECK_IRDA_HANDLE(s)
+	CHECK_IRDA_HANDLE(stats)
+
+	* stats = s->stats;
+
+	return 0;
+}
+
+int irda_socket_reset_stats(irda_t s)
+{
+	CHECK_IRDA_HANDLE(s)
+
+	memset(& s->stats, 0, sizeof(irda_stats_t));
+
+	return 0;
+}
+
+/* Record the Wait Time of a Read */
+static void record_wait(irda_t s, long long t0, size_t nbytes)
+{
+	unsigned long wait = (unsigned long)(irda_clock_us() - t0);
+	unsigned long ms = wait / 1000;
+	unsigned int b = 0;
+
+	while (ms && (b < IRDA_WAIT_BUCKETS - 1))
+	{
+		ms >>= 1;
+		b++;
+	}
+
+	s->stats.reads++;
+	s->stats.bytes += nbytes;
+	s->stats.wait_us += wait;
+	if (wait > s->stats.max_wait_us)
+		s->stats.max_wait_us = wait;
+	s->stats.hist[b]++;
+}
+
 #define DISCOVER_MAX_DEVICES 16	// Maximum number of devices.
 #define DISCOVER_MAX_RETRIES 4	// Maximum number of retries.
 
@@ -278,7 +408,7 @@ int irda_socket_timeout(irda_t s, long * timeout)
 #define NUMDEVICES len
 #endif
 
-int irda_socket_discover(irda_t s, irda_callback_t cb, void * userdata)
+static int os_socket_discover(irda_t s, irda_callback_t cb, void * userdata)
 {
 	int rc = 0;
 	unsigned int nretries = 0;
@@ -292,8 +422,6 @@ int irda_socket_discover(irda_t s, irda_callback_t cb, void * userdata)
 	socklen_t size = sizeof(data);
 #endif
 
-	CHECK_IRDA_HANDLE(s)
-
 	while ((rc = getsockopt(s->fd, SOL_IRLMP, IRLMP_ENUMDEVICES, (char *)data, & size)) != 0 || list->NUMDEVICES == 0)
 	{
 		// Check for an error in getsockopt() other than socket timeout
@@ -383,7 +511,7 @@ int internal_select(irda_t s, int writing, long interval)
 		pollfd.fd = s->fd;
 		pollfd.events = writing ? POLLOUT : POLLIN;
 
-		n = poll(& pollfd, 1, s->timeout);
+		n = poll(& pollfd, 1, interval);
 	}
 #else
 	{
@@ -410,10 +538,32 @@ int internal_select(irda_t s, int writing, long interval)
 	return 0;
 }
 
-long ms_time(void)
+/*
+ * Deadline for an operation starting now: the per-operation timeout, cut
+ * short by the overall deadline if that comes first.
+ */
+static long long select_deadline(irda_t s)
 {
-	clock_t t = clock();
-	return (t * 1000 / CLOCKS_PER_SEC);
+	long long deadline = irda_clock_us() + (long long)s->timeout * 1000;
+
+	if (s->deadline && (s->deadline < deadline))
+		deadline = s->deadline;
+
+	return deadline;
+}
+
+/*
+ * Milliseconds left until the deadline, rounded up so that select() does
+ * not return just short of it, or -1 once it has passed.
+ */
+static long select_interval(long long deadline)
+{
+	long long left = deadline - irda_clock_us();
+
+	if (left <= 0)
+		return -1;
+
+	return (long)((left + 999) / 1000);
 }
 
 #if defined(_WIN32) || defined(WIN32)
@@ -429,17 +579,21 @@ long ms_time(void)
 
 #define BEGIN_SELECT_LOOP(s) \
 	{ \
-		long deadline, interval = s->timeout; \
+		long long deadline = 0; \
+		long interval = s->timeout; \
 		int has_timeout = (s->timeout > 0); \
 		if (has_timeout) \
-			deadline = ms_time() + s->timeout; \
+		{ \
+			deadline = select_deadline(s); \
+			interval = select_interval(deadline); \
+		} \
 		while (1) { \
 			errno = 0;
 
 #define END_SELECT_LOOP(s) \
 			if (! has_timeout || (! CHECK_ERRNO(EWOULDBLOCK) && ! CHECK_ERRNO(EAGAIN))) \
 				break; \
-			interval = deadline - ms_time(); \
+			interval = select_interval(deadline); \
 		} \
 	}
 
@@ -521,7 +675,7 @@ int internal_connect(irda_t s, const struct sockaddr * addr, int len, int * time
 	return rc;
 }
 
-int irda_socket_connect_name(irda_t s, unsigned int address, const char * name, int * timeout)
+static int os_socket_connect_name(irda_t s, unsigned int address, const char * name, int * timeout)
 {
 #if defined(_WIN32) || defined(WIN32)
 	SOCKADDR_IRDA peer;
@@ -529,8 +683,6 @@ int irda_socket_connect_name(irda_t s, unsigned int address, const char * name,
 	struct sockaddr_irda peer;
 #endif
 
-	CHECK_IRDA_HANDLE(s)
-
 #if defined(_WIN32) || defined(WIN32)
 	peer.irdaAddressFamily = AF_IRDA;
 	peer.irdaDeviceID[0] = (address >> 24) & 0xFF;
@@ -553,7 +705,7 @@ int irda_socket_connect_name(irda_t s, unsigned int address, const char * name,
 	return internal_connect(s, (struct sockaddr *) &peer, sizeof(peer), timeout);
 }
 
-int irda_socket_connect_lsap(irda_t s, unsigned int address, unsigned int lsap, int * timeout)
+static int os_socket_connect_lsap(irda_t s, unsigned int address, unsigned int lsap, int * timeout)
 {
 #if defined(_WIN32) || defined(WIN32)
 	SOCKADDR_IRDA peer;
@@ -561,8 +713,6 @@ int irda_socket_connect_lsap(irda_t s, unsigned int address, unsigned int lsap,
 	struct sockaddr_irda peer;
 #endif
 
-	CHECK_IRDA_HANDLE(s)
-
 #if defined(_WIN32) || defined(WIN32)
 	peer.irdaAddressFamily = AF_IRDA;
 	peer.irdaDeviceID[0] = (address >> 24) & 0xFF;
@@ -580,6 +730,37 @@ int irda_socket_connect_lsap(irda_t s, unsigned int address, unsigned int lsap,
 	return internal_connect(s, (struct sockaddr *) &peer, sizeof(peer), timeout);
 }
 
+static const irda_transport_t irda_os_transport =
+{
+	"irda",
+	os_socket_open,
+	os_socket_close,
+	os_socket_discover,
+	os_socket_connect_name,
+	os_socket_connect_lsap,
+};
+
+int irda_socket_discover(irda_t s, irda_callback_t cb, void * userdata)
+{
+	CHECK_IRDA_HANDLE(s)
+
+	return s->ops->discover(s, cb, userdata);
+}
+
+int irda_socket_connect_name(irda_t s, unsigned int address, const char * name, int * timeout)
+{
+	CHECK_IRDA_HANDLE(s)
+
+	return s->ops->connect_name(s, address, name, timeout);
+}
+
+int irda_socket_connect_lsap(irda_t s, unsigned int address, unsigned int lsap, int * timeout)
+{
+	CHECK_IRDA_HANDLE(s)
+
+	return s->ops->connect_lsap(s, address, lsap, timeout);
+}
+
 int irda_socket_available(irda_t s)
 {
 #if defined(_WIN32) || defined(WIN32)
@@ -606,7 +787,8 @@ int irda_socket_available(irda_t s)
 
 int irda_socket_read(irda_t s, void * data, size_t * size, int * timeoutp)
 {
-	int timeout;
+	int timeout = 0;
+	long long t0;
 
 #if defined(_WIN32) || defined(WIN32)
 	int outlen = 0;
@@ -638,6 +820,8 @@ int irda_socket_read(irda_t s, void * data, size_t * size, int * timeoutp)
 #endif
 	}
 
+	t0 = irda_clock_us();
+
 	BEGIN_SELECT_LOOP(s)
 	timeout = internal_select(s, 0, interval);
 	if (! timeout)
@@ -655,6 +839,11 @@ int irda_socket_read(irda_t s, void * data, size_t * size, int * timeoutp)
 	if (outlen < 0)
 		return -1;
 
+	if (timeout == 1)
+		s->stats.timeouts++;
+	else if (outlen > 0)
+		record_wait(s, t0, (size_t)outlen);
+
 	* size = (size_t)outlen;
 	return 0;
 }
@@ -44,6 +44,61 @@ typedef struct _irda_t * irda_t;
  */
 typedef void (* irda_callback_t)(unsigned int, const char *, unsigned int, unsigned int, void *);
 
+//! Number of Read Wait Time Histogram Buckets
+#define IRDA_WAIT_BUCKETS	16
+
+/*
+ * Slowest data rate expected from a working device, in bytes per second,
+ * used by irda_socket_set_budget().  A 9600 baud IrDA link carries about 900
+ * bytes per second.
+ */
+#define IRDA_XFER_MIN_RATE	250
+
+/**
+ * @brief IrDA Socket Read Statistics
+ *
+ * The wait time of a read runs from the call to irda_socket_read() until
+ * data arrives, measured on the monotonic clock.  Bucket 0 of the histogram
+ * counts waits under 1 ms and bucket i waits from 2^(i-1) up to 2^i ms; the
+ * last bucket also counts every longer wait.
+ */
+typedef struct
+{
+	unsigned long		reads;		///< Reads which returned Data
+	unsigned long		timeouts;	///< Reads which Timed Out
+	unsigned long		bytes;		///< Bytes Read
+
+	unsigned long long	wait_us;	///< Total Wait Time in Microseconds
+	unsigned long		max_wait_us;///< Longest Wait Time in Microseconds
+
+	unsigned long		hist[IRDA_WAIT_BUCKETS];	///< Reads by Wait Time
+
+} irda_stats_t;
+
+/**
+ * @brief IrDA Transport Type
+ *
+ * A transport provides the sockets returned by irda_socket_open().  The
+ * default transport is the operating system IrDA stack; others, such as the
+ * device simulator in irda_sim.h, may be selected with irda_set_transport().
+ */
+typedef struct irda_transport_ irda_transport_t;
+
+/**
+ * @brief Select the IrDA Transport
+ * @param [in] Transport, or NULL for the operating system IrDA stack
+ *
+ * Applies to sockets opened after the call; open sockets keep the transport
+ * which created them.  This should be called before any sockets are opened
+ * by other threads.
+ */
+void irda_set_transport(const irda_transport_t * t);
+
+/**
+ * @brief Return the name of the current IrDA Transport
+ */
+const char * irda_transport_name(void);
+
 /**
  * @brief Return the most recent IrDA error code
  *
@@ -127,6 +182,46 @@ int irda_socket_set_timeout(irda_t s, long timeout);
  */
 int irda_socket_timeout(irda_t s, long * timeout);
 
+/**
+ * @brief Set an overall deadline for IrDA socket operations
+ * @param [in] IrDA Socket Handle
+ * @param [in] Time budget in milliseconds from now, or 0 to clear
+ * @return 0 on success, -1 on failure
+ *
+ * Bounds a sequence of reads and writes, such as a whole transfer, in
+ * addition to the per-operation timeout: once the deadline has passed every
+ * read and write times out.  Only applies to sockets with a timeout set.  A
+ * budget too large for the clock to reach sets no deadline.
+ */
+int irda_socket_set_deadline(irda_t s, long budget);
+
+/**
+ * @brief Set a deadline for transferring a number of bytes
+ * @param [in] IrDA Socket Handle
+ * @param [in] Number of bytes to be transferred
+ * @return 0 on success, -1 on failure
+ *
+ * Sets the deadline to the socket timeout plus the time to move the bytes
+ * at IRDA_XFER_MIN_RATE, so that only a stalled or trickling link hits it
+ * however steadily the bytes arrive.
+ */
+int irda_socket_set_budget(irda_t s, unsigned long nbytes);
+
+/**
+ * @brief Return the IrDA socket read statistics
+ * @param [in] IrDA Socket Handle
+ * @param [out] Read Statistics
+ * @return 0 on success, -1 on failure
+ */
+int irda_socket_stats(irda_t s, irda_stats_t * stats);
+
+/**
+ * @brief Reset the IrDA socket read statistics
+ * @param [in] IrDA Socket Handle
+ * @return 0 on success, -1 on failure
+ */
+int irda_socket_reset_stats(irda_t s);
+
 /**
  * @brief Discover devices on the IrDA bus
  * @param [in] IrDA Socket Handle
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ * www.asymworks.com / info@asymworks.com
+ *
+ * This file is part of the Benthos Dive Log Package (benthos-log.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include <stddef.h>
+
+#include "irda_chunk.h"
+#include "irda_transport.h"
+
+#define CHUNK_FAST_US		20000	///< Longest Wait for a Quick Read
+#define CHUNK_GROW_AFTER	2		///< Quick Full Reads before Growing
+#define CHUNK_RETRIES		2		///< Timeouts Retried per Read
+
+void irda_chunk_init(irda_chunk_t * c, unsigned int min, unsigned int max, unsigned int size)
+{
+	if (min < 1)
+		min = 1;
+	if (max < min)
+		max = min;
+	if (size < min)
+		size = min;
+	if (size > max)
+		size = max;
+
+	c->min = min;
+	c->max = max;
+	c->size = size;
+	c->streak = 0;
+	c->retries = 0;
+
+	c->t_start = irda_clock_us();
+	c->bytes = 0;
+	c->rate = 0;
+}
+
+static void chunk_shrink(irda_chunk_t * c, unsigned int size)
+{
+	c->streak = 0;
+	c->size = (size < c->min) ? c->min : size;
+}
+
+int irda_chunk_read(irda_chunk_t * c, irda_t s, void * data, size_t * size, int * timeoutp)
+{
+	size_t want = * size;
+	long long t0;
+	long long t1;
+	size_t n;
+	int timeout;
+	int rc;
+
+	for (;;)
+	{
+		if (want > c->size)
+			want = c->size;
+
+		n = want;
+		timeout = 0;
+
+		t0 = irda_clock_us();
+		rc = irda_socket_read(s, data, & n, & timeout);
+		t1 = irda_clock_us();
+
+		/* Fail if the Link has Closed, rather than Reading Nothing Forever */
+		if ((rc != 0) || (! timeout && (n == 0) && (want > 0)))
+		{
+			* size = 0;
+			return -1;
+		}
+
+		if (! timeout)
+			break;
+
+		/* Retry a Timed-Out Read at Half the Size */
+		chunk_shrink(c, c->size / 2);
+		if (c->retries++ >= CHUNK_RETRIES)
+		{
+			if (timeoutp != NULL)
+				* timeoutp = 1;
+
+			* size = 0;
+			return 0;
+		}
+	}
+
+	c->retries = 0;
+	c->bytes += n;
+	if (t1 > c->t_start)
+		c->rate = (uint32_t)(c->bytes * 1000000 / (uint64_t)(t1 - c->t_start));
+
+	if (n < want)
+	{
+		/* Short Read: Back Off towards what the Link Delivered */
+		unsigned int next = c->size - c->size / 4;
+		chunk_shrink(c, (n > next) ? (unsigned int)n : next);
+	}
+	else if ((want == c->size) && (t1 - t0 < CHUNK_FAST_US))
+	{
+		/* Quick Full Read: Grow after a Run of Them */
+		if (++c->streak >= CHUNK_GROW_AFTER)
+		{
+			c->streak = 0;
+			c->size = (c->size > c->max / 2) ? c->max : c->size * 2;
+		}
+	}
+	else
+		c->streak = 0;
+
+	* size = n;
+	return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ * www.asymworks.com / info@asymworks.com
+ *
+ * This file is part of the Benthos Dive Log Package (benthos-log.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef IRDA_CHUNK_H_
+#define IRDA_CHUNK_H_
+
+/**
+ * @file src/common-irda/irda_chunk.h
+ * @brief Adaptive IrDA Read Size
+ *
+ * Chooses the size of each read in a bulk transfer.  Small reads waste time
+ * on per-read overhead, while large ones risk timeouts on a weak link.  The
+ * read size doubles after a run of reads which were filled quickly, and
+ * shrinks after a short read or a timeout.  A read which times out is
+ * retried at the smaller size a few times before the timeout is reported,
+ * so a link which stalls briefly does not end the transfer.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdint.h>
+
+#include "irda.h"
+
+/**
+ * @brief Adaptive Read Size State
+ */
+typedef struct
+{
+	unsigned int		min;		///< Smallest Read Size
+	unsigned int		max;		///< Largest Read Size
+	unsigned int		size;		///< Current Read Size
+
+	unsigned int		streak;		///< Consecutive Quick Full Reads
+	unsigned int		retries;	///< Timeouts Retried since the last Read
+
+	long long			t_start;	///< Start Time in Monotonic Microseconds
+	uint64_t			bytes;		///< Bytes Read
+	uint32_t			rate;		///< Achieved Rate in Bytes per Second
+
+} irda_chunk_t;
+
+/**
+ * @brief Start a Transfer
+ * @param [out] Read Size State
+ * @param [in] Smallest Read Size
+ * @param [in] Largest Read Size
+ * @param [in] Initial Read Size
+ *
+ * Resets the read size and the achieved rate.  Passing the same smallest and
+ * largest size gives fixed size reads.
+ */
+void irda_chunk_init(irda_chunk_t * c, unsigned int min, unsigned int max, unsigned int size);
+
+/**
+ * @brief Read the next Chunk of a Transfer
+ * @param [in,out] Read Size State
+ * @param [in] IrDA Socket Handle
+ * @param [in] Data Buffer Pointer
+ * @param [in,out] Data Buffer Size
+ * @param [out] Timeout Flag
+ * @return 0 on success, -1 on failure
+ *
+ * Behaves like irda_socket_read(), reading at most the current read size,
+ * and then updates the read size and the achieved rate.  Unlike
+ * irda_socket_read(), a link closed by the device is reported as a failure.
+ */
+int irda_chunk_read(irda_chunk_t * c, irda_t s, void * data, size_t * size, int * timeout);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* IRDA_CHUNK_H_ */
@@ -0,0 +1,504 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ * www.asymworks.com / info@asymworks.com
+ *
+ * This file is part of the Benthos Dive Log Package (benthos-log.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "irda_sim.h"
+#include "irda_transport.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL		0
+#endif
+
+#define SIM_NAME_LEN		32		///< Longest Device Name
+#define SIM_DIVE_HDRLEN		12		///< Dive Magic, Length and Timestamp
+#define SIM_FRAME_SIZE		64		///< Default Data Frame Size
+#define SIM_LOSS_SEED		0x5eed	///< Frame Loss Generator Seed
+
+//! Simulated Device
+typedef struct
+{
+	irda_sim_config_t	cfg;				///< Device Configuration
+	char				name[SIM_NAME_LEN];	///< Device Name
+
+	int					fd;					///< Device End of the Socket Pair
+	pthread_t			thread;				///< Device Thread
+	int					running;			///< Device Thread Started
+
+	uint8_t *			sel;				///< Dives Selected by Token
+	uint32_t			rng;				///< Frame Loss Generator State
+
+} sim_device_t;
+
+static irda_sim_config_t	g_config = { 1, "UWATEC Galileo", 17, 0, 0, NULL, 0, 0, 0, SIM_FRAME_SIZE, 0, 0 };
+static char					g_name[SIM_NAME_LEN] = "UWATEC Galileo";
+
+static uint32_t sim_le32(const uint8_t * p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void sim_put_le32(uint8_t * p, uint32_t v)
+{
+	p[0] = (uint8_t)(v);
+	p[1] = (uint8_t)(v >> 8);
+	p[2] = (uint8_t)(v >> 16);
+	p[3] = (uint8_t)(v >> 24);
+}
+
+/*
+ * Advance the pacing clock by the given number of microseconds and sleep
+ * until it is reached.  Pacing from a running deadline rather than sleeping
+ * for each interval keeps oversleeps from accumulating over a transfer.
+ *
+ * Long sleeps wait in poll() so that they end as soon as the host closes its
+ * end of the socket.  Returns -1 if it has.
+ */
+static int sim_delay(sim_device_t * dev, struct timespec * t, unsigned long usec)
+{
+	struct pollfd pfd;
+	struct timespec now;
+	struct timespec d;
+	long long left;
+
+	t->tv_sec += usec / 1000000;
+	t->tv_nsec += (long)(usec % 1000000) * 1000;
+	if (t->tv_nsec >= 1000000000)
+	{
+		t->tv_sec++;
+		t->tv_nsec -= 1000000000;
+	}
+
+	for (;;)
+	{
+		clock_gettime(CLOCK_MONOTONIC, & now);
+		left = (long long)(t->tv_sec - now.tv_sec) * 1000000 + (t->tv_nsec - now.tv_nsec) / 1000;
+		if (left <= 0)
+			return 0;
+
+		if (left < 2000)
+			break;
+
+		/* Only Hangup and Errors are Reported with No Events */
+		pfd.fd = dev->fd;
+		pfd.events = 0;
+		pfd.revents = 0;
+		if (poll(& pfd, 1, (int)(left / 1000) - 1) > 0)
+			return -1;
+	}
+
+	d.tv_sec = 0;
+	d.tv_nsec = (long)left * 1000;
+	while ((nanosleep(& d, & d) != 0) && (errno == EINTR))
+		;
+
+	return 0;
+}
+
+static int sim_recv(sim_device_t * dev, void * buf, size_t len)
+{
+	size_t pos = 0;
+
+	while (pos < len)
+	{
+		ssize_t n = recv(dev->fd, (char *)buf + pos, len - pos, 0);
+		if ((n < 0) && (errno == EINTR))
+			continue;
+		if (n <= 0)
+			return -1;
+
+		pos += n;
+	}
+
+	return 0;
+}
+
+static int sim_send(sim_device_t * dev, const void * buf, size_t len)
+{
+	size_t pos = 0;
+
+	while (pos < len)
+	{
+		ssize_t n = send(dev->fd, (const char *)buf + pos, len - pos, MSG_NOSIGNAL);
+		if ((n < 0) && (errno == EINTR))
+			continue;
+		if (n <= 0)
+			return -1;
+
+		pos += n;
+	}
+
+	return 0;
+}
+
+/*
+ * Decide whether the next data frame is lost.  The generator is seeded when
+ * the socket is opened, so every run over the same link loses the same
+ * frames and runs can be compared.
+ */
+static int sim_lost(sim_device_t * dev)
+{
+	if (dev->cfg.loss == 0)
+		return 0;
+
+	/* xorshift32 */
+	dev->rng ^= dev->rng << 13;
+	dev->rng ^= dev->rng >> 17;
+	dev->rng ^= dev->rng << 5;
+
+	return (dev->rng % 1000) < dev->cfg.loss;
+}
+
+/*
+ * Send a short answer after the turnaround latency.  Each answer is sent
+ * with a single write so that the host reads it whole, as it would a frame.
+ */
+static int sim_answer(sim_device_t * dev, const uint8_t * ans, size_t len)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, & t);
+	if (sim_delay(dev, & t, dev->cfg.latency) != 0)
+		return -1;
+
+	return sim_send(dev, ans, len);
+}
+
+static int sim_answer_le32(sim_device_t * dev, uint32_t v)
+{
+	uint8_t ans[4];
+	sim_put_le32(ans, v);
+
+	return sim_answer(dev, ans, 4);
+}
+
+/*
+ * Select the dives later than the token.  The whole memory is returned in
+ * place for a zero token, otherwise the selected dives are gathered into a
+ * buffer owned by the device.
+ */
+static const uint8_t * sim_select(sim_device_t * dev, uint32_t token, uint32_t * len)
+{
+	static const uint8_t magic[4] = { 0xa5, 0xa5, 0x5a, 0x5a };
+
+	const uint8_t * data = (const uint8_t *)dev->cfg.data;
+	uint32_t size = dev->cfg.size;
+	uint32_t pos = 0;
+	uint32_t n = 0;
+
+	free(dev->sel);
+	dev->sel = NULL;
+
+	if ((token == 0) || (size == 0))
+	{
+		* len = size;
+		return data;
+	}
+
+	dev->sel = (uint8_t *)malloc(size);
+	if (dev->sel == NULL)
+	{
+		* len = size;
+		return data;
+	}
+
+	while (pos + SIM_DIVE_HDRLEN <= size)
+	{
+		uint32_t dlen = sim_le32(data + pos + 4);
+		if ((memcmp(data + pos, magic, 4) != 0) || (dlen < SIM_DIVE_HDRLEN) || (dlen > size - pos))
+			break;
+
+		if (sim_le32(data + pos + 8) > token)
+		{
+			memcpy(dev->sel + n, data + pos, dlen);
+			n += dlen;
+		}
+
+		pos += dlen;
+	}
+
+	/* Pass Trailing Data which is not a Dive through Unfiltered */
+	memcpy(dev->sel + n, data + pos, size - pos);
+	n += size - pos;
+
+	* len = n;
+	return dev->sel;
+}
+
+/*
+ * Send the transfer length and then the data, in frames paced to the link
+ * byte rate.  The length follows the turnaround latency like any answer.  A
+ * lost frame arrives after the retransmit delay on top of its own time.
+ */
+static int sim_stream(sim_device_t * dev, const uint8_t * data, uint32_t len)
+{
+	struct timespec t;
+	unsigned int frame = dev->cfg.frame_size ? dev->cfg.frame_size : SIM_FRAME_SIZE;
+	uint32_t pos = 0;
+
+	if (sim_answer_le32(dev, len + 4) != 0)
+		return -1;
+
+	clock_gettime(CLOCK_MONOTONIC, & t);
+	while (pos < len)
+	{
+		uint32_t n = (len - pos > frame) ? frame : len - pos;
+
+		if (dev->cfg.byte_rate && (sim_delay(dev, & t, (unsigned long)((uint64_t)n * 1000000 / dev->cfg.byte_rate)) != 0))
+			return -1;
+
+		if (sim_lost(dev))
+		{
+			clock_gettime(CLOCK_MONOTONIC, & t);
+			if (sim_delay(dev, & t, dev->cfg.stall) != 0)
+				return -1;
+		}
+
+		if (sim_send(dev, data + pos, n) != 0)
+			return -1;
+
+		pos += n;
+	}
+
+	return 0;
+}
+
+static void * sim_device_run(void * arg)
+{
+	sim_device_t * dev = (sim_device_t *)arg;
+	const uint8_t * data;
+	uint8_t cmd;
+	uint8_t args[8];
+	uint8_t ack = 0x01;
+	uint32_t len;
+	int rc;
+
+	/* Answer Commands until the Host Closes the Socket */
+	while (sim_recv(dev, & cmd, 1) == 0)
+	{
+		switch (cmd)
+		{
+		case 0x1b:
+			rc = sim_answer(dev, & ack, 1);
+			break;
+
+		case 0x1c:
+			rc = sim_recv(dev, args, 4);
+			if (rc == 0)
+				rc = sim_answer(dev, & ack, 1);
+			break;
+
+		case 0x10:
+			rc = sim_answer(dev, & dev->cfg.model, 1);
+			break;
+
+		case 0x14:
+			rc = sim_answer_le32(dev, dev->cfg.serial);
+			break;
+
+		case 0x1a:
+			rc = sim_answer_le32(dev, dev->cfg.ticks);
+			break;
+
+		case 0xc6:
+			rc = sim_recv(dev, args, 8);
+			if (rc == 0)
+			{
+				sim_select(dev, sim_le32(args), & len);
+				rc = sim_answer_le32(dev, len);
+			}
+			break;
+
+		case 0xc4:
+			rc = sim_recv(dev, args, 8);
+			if (rc == 0)
+			{
+				data = sim_select(dev, sim_le32(args), & len);
+				rc = sim_stream(dev, data, len);
+			}
+			break;
+
+		default:
+			/* The Device Ignores Unknown Commands */
+			rc = 0;
+			break;
+		}
+
+		if (rc != 0)
+			break;
+	}
+
+	return NULL;
+}
+
+static int sim_socket_open(irda_t s)
+{
+	sim_device_t * dev;
+	int sv[2];
+
+	dev = (sim_device_t *)malloc(sizeof(sim_device_t));
+	if (dev == NULL)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+	{
+		free(dev);
+		return -1;
+	}
+
+	dev->cfg = g_config;
+	memcpy(dev->name, g_name, SIM_NAME_LEN);
+	dev->fd = sv[1];
+	dev->running = 0;
+	dev->sel = NULL;
+	dev->rng = SIM_LOSS_SEED;
+
+	s->fd = sv[0];
+	s->priv = dev;
+
+	return 0;
+}
+
+static int sim_socket_close(irda_t s)
+{
+	sim_device_t * dev = (sim_device_t *)s->priv;
+
+	/* Closing the Host End Stops the Device Thread */
+	shutdown(s->fd, SHUT_RDWR);
+	close(s->fd);
+
+	if (dev->running)
+		pthread_join(dev->thread, NULL);
+
+	close(dev->fd);
+	free(dev->sel);
+	free(dev);
+
+	return 0;
+}
+
+static int sim_socket_discover(irda_t s, irda_callback_t cb, void * userdata)
+{
+	sim_device_t * dev = (sim_device_t *)s->priv;
+
+	if (dev->cfg.name == NULL)
+		return 0;
+
+	if (cb != NULL)
+		cb(dev->cfg.address, dev->name, 0, 0, userdata);
+
+	return 1;
+}
+
+static int sim_socket_connect(irda_t s, unsigned int address, int * timeout)
+{
+	sim_device_t * dev = (sim_device_t *)s->priv;
+	int rc;
+
+	* timeout = 0;
+
+	if ((dev->cfg.name == NULL) || (address != dev->cfg.address))
+	{
+		errno = EHOSTUNREACH;
+		return -1;
+	}
+
+	if (dev->running)
+	{
+		errno = EISCONN;
+		return -1;
+	}
+
+	rc = pthread_create(& dev->thread, NULL, sim_device_run, dev);
+	if (rc != 0)
+	{
+		errno = rc;
+		return -1;
+	}
+
+	dev->running = 1;
+	return 0;
+}
+
+static int sim_socket_connect_name(irda_t s, unsigned int address, const char * name, int * timeout)
+{
+	return sim_socket_connect(s, address, timeout);
+}
+
+static int sim_socket_connect_lsap(irda_t s, unsigned int address, unsigned int lsap, int * timeout)
+{
+	return sim_socket_connect(s, address, timeout);
+}
+
+static const irda_transport_t irda_sim_ops =
+{
+	"sim",
+	sim_socket_open,
+	sim_socket_close,
+	sim_socket_discover,
+	sim_socket_connect_name,
+	sim_socket_connect_lsap,
+};
+
+void irda_sim_default_config(irda_sim_config_t * cfg)
+{
+	memset(cfg, 0, sizeof(irda_sim_config_t));
+
+	cfg->address = 1;
+	cfg->name = "UWATEC Galileo";
+	cfg->model = 17;
+	cfg->frame_size = SIM_FRAME_SIZE;
+}
+
+int irda_sim_configure(const irda_sim_config_t * cfg)
+{
+	if ((cfg == NULL) || ((cfg->data == NULL) && (cfg->size != 0)))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	g_config = * cfg;
+
+	if (cfg->name != NULL)
+	{
+		strncpy(g_name, cfg->name, SIM_NAME_LEN - 1);
+		g_name[SIM_NAME_LEN - 1] = 0;
+	}
+
+	return 0;
+}
+
+const irda_transport_t * irda_sim_transport(void)
+{
+	return & irda_sim_ops;
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ * www.asymworks.com / info@asymworks.com
+ *
+ * This file is part of the Benthos Dive Log Package (benthos-log.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef IRDA_SIM_H_
+#define IRDA_SIM_H_
+
+/**
+ * @file src/common-irda/irda_sim.h
+ * @brief Simulated Uwatec Smart IrDA Device
+ *
+ * An IrDA transport which, in place of the operating system IrDA stack,
+ * connects sockets to a simulated Uwatec Smart device over a socket pair.
+ * The device runs on its own thread and answers the Smart command set used
+ * by the smart plugin and smartid: the 0x1b/0x1c handshake, model (0x10),
+ * serial number (0x14), clock (0x1a), transfer size (0xc6) and transfer data
+ * (0xc4).  Answers are delayed by a fixed turnaround latency and the data
+ * stream is paced to a byte rate, so the whole transfer stack above the
+ * socket can be exercised and timed without hardware.  A lossy link is
+ * modelled by holding back a fraction of the data frames for a retransmit
+ * delay, as the IrLAP layer would while it recovers them.
+ *
+ * Only available on POSIX systems.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdint.h>
+
+#include "irda.h"
+
+/**
+ * @brief Simulated Device Configuration
+ */
+typedef struct
+{
+	unsigned int		address;	///< IrDA Device Address
+	const char *		name;		///< IrDA Device Name (NULL if nothing is discovered)
+
+	uint8_t				model;		///< Model Number
+	uint32_t			serial;		///< Serial Number
+	uint32_t			ticks;		///< Device Clock
+
+	const void *		data;		///< Dive Memory
+	uint32_t			size;		///< Dive Memory Size
+
+	unsigned long		byte_rate;	///< Link Rate in Bytes per Second (0 for unlimited)
+	unsigned long		latency;	///< Command Turnaround in Microseconds
+	unsigned int		frame_size;	///< Largest Data Frame in Bytes
+
+	unsigned int		loss;		///< Data Frames Lost per Thousand
+	unsigned long		stall;		///< Retransmit Delay for a Lost Frame in Microseconds
+
+} irda_sim_config_t;
+
+/**
+ * @brief Fill a Configuration with Defaults
+ * @param [out] Configuration
+ *
+ * The default device is a Galileo at address 1 with no dives, on a link
+ * with no rate limit, latency or loss.
+ */
+void irda_sim_default_config(irda_sim_config_t * cfg);
+
+/**
+ * @brief Configure the Simulated Device
+ * @param [in] Configuration
+ * @return 0 on success, -1 on failure
+ *
+ * Applies to sockets opened after the call.  The configuration is copied,
+ * except for the dive memory which must stay valid until every simulated
+ * socket has been closed.
+ *
+ * The dive memory is a sequence of dives as the device would return them.
+ * A transfer with a non-zero token returns only the dives whose timestamp is
+ * later than the token, in memory order; anything that does not parse as a
+ * dive is always returned.
+ */
+int irda_sim_configure(const irda_sim_config_t * cfg);
+
+/**
+ * @brief Return the Simulator Transport
+ *
+ * Pass the result to irda_set_transport() to route new sockets to the
+ * simulated device.
+ */
+const irda_transport_t * irda_sim_transport(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* IRDA_SIM_H_ */
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2013 Asymworks, LLC.  All Rights Reserved.
+ * www.asymworks.com / info@asymworks.com
+ *
+ * This file is part of the Benthos Dive Log Package (benthos-log.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef IRDA_TRANSPORT_H_
+#define IRDA_TRANSPORT_H_
+
+/**
+ * @file src/common-irda/irda_transport.h
+ * @brief IrDA Transport Interface
+ *
+ * Private to the IrDA module and its transports.  A transport supplies the
+ * operations which differ between a real IrDA stack and a stand-in for one:
+ * creating and closing the stream socket, discovery and connection.  Once a
+ * socket is connected all transports carry data over an ordinary stream file
+ * descriptor, so reads, writes, timeouts and select() are shared code in
+ * irda.c.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "irda.h"
+
+#if defined(_WIN32) || defined(WIN32)
+#include <winsock2.h>
+typedef SOCKET			socket_t;
+#else
+typedef int				socket_t;
+#endif
+
+/**
+ * @brief IrDA Socket Structure
+ */
+struct _irda_t
+{
+	socket_t					fd;			///< Stream Socket
+	long						timeout;	///< Timeout in Milliseconds (-1 to block)
+	long long					deadline;	///< Overall Deadline in Monotonic Microseconds (0 for none)
+
+	irda_stats_t				stats;		///< Read Statistics
+
+	const irda_transport_t *	ops;		///< Transport which opened the Socket
+	void *						priv;		///< Transport Private Data
+
+};
+
+/**
+ * @brief IrDA Transport Operations
+ *
+ * The open function is called with fd and priv cleared and must set fd; the
+ * close function must close fd and release priv.  The remaining functions
+ * have the same contract as the irda_socket_ function of the same name.
+ */
+struct irda_transport_
+{
+	const char *	name;		///< Transport Name
+
+	int (* open)(irda_t s);
+	int (* close)(irda_t s);
+	int (* discover)(irda_t s, irda_callback_t cb, void * userdata);
+	int (* connect_name)(irda_t s, unsigned int address, const char * name, int * timeout);
+	int (* connect_lsap)(irda_t s, unsigned int address, unsigned int lsap, int * timeout);
+
+};
+
+/**
+ * @brief Monotonic Time in Microseconds
+ */
+long long irda_clock_us(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* IRDA_TRANSPORT_H_ */
@@ -22,41 +22,234 @@
 
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include <benthos/divecomputer/unpack.h>
+
 #include "smart_extract.h"
 
-int smart_extract_dives(void * buffer, uint32_t size, divedata_callback_fn_t cb, void * userdata)
+#define SMART_DIVE_HDRLEN		12		///< Dive Header Length (Magic, Length, Token)
+
+struct smart_extractor_
+{
+	divedata_callback_fn_t	cb;			///< Dive Callback Function
+	void *					userdata;	///< Dive Callback Data
+	int						flags;		///< Extractor Flags
+
+	const uint8_t *			start;		///< Start of the Pending Dive (Contiguous Mode)
+	uint8_t *				carry;		///< Carry-over Buffer for Split Dives
+	uint32_t				csize;		///< Carry-over Buffer Capacity
+	uint32_t				have;		///< Bytes of the Pending Dive Received
+	uint32_t				dlen;		///< Length of the Pending Dive (0 if not yet known)
+	int						status;		///< Sticky Error Status
+};
+
+static void smart_extractor_init(struct smart_extractor_ * ex, divedata_callback_fn_t cb, void * userdata, int flags)
+{
+	ex->cb = cb;
+	ex->userdata = userdata;
+	ex->flags = flags;
+
+	ex->start = 0;
+	ex->carry = 0;
+	ex->csize = 0;
+	ex->have = 0;
+	ex->dlen = 0;
+	ex->status = EXTRACT_SUCCESS;
+}
+
+static int smart_extract_header(const uint8_t * data, uint32_t * dlen)
+{
+	static const uint8_t magic[4] = { 0xa5, 0xa5, 0x5a, 0x5a };
+
+	if (memcmp(data, magic, 4) != 0)
+		return EXTRACT_CORRUPT;
+
+	* dlen = uint32_le(data, 4);
+	if (* dlen < SMART_DIVE_HDRLEN)
+		return EXTRACT_CORRUPT;
+
+	return EXTRACT_SUCCESS;
+}
+
+static void smart_extract_emit(struct smart_extractor_ * ex, const uint8_t * data, uint32_t dlen)
 {
 	char token[20];
-	uint8_t hdr[4] = { 0xa5, 0xa5, 0x5a, 0x5a };
-	uint32_t dlen = 0;
-	uint32_t tok = 0;
-	uint32_t pos = 0;
 
-	if (! buffer)
+	sprintf(token, "%u", uint32_le(data, 8));
+
+	if (ex->cb)
+		ex->cb(ex->userdata, (void *)data, dlen, token);
+}
+
+static int smart_extractor_reserve(struct smart_extractor_ * ex, uint32_t size)
+{
+	uint32_t ncap;
+	uint8_t * p;
+
+	if (size <= ex->csize)
+		return 0;
+
+	ncap = ex->csize ? ex->csize : 256;
+	while (ncap < size)
+		ncap *= 2;
+
+	p = (uint8_t *)realloc(ex->carry, ncap);
+	if (p == NULL)
+		return -1;
+
+	ex->carry = p;
+	ex->csize = ncap;
+	return 0;
+}
+
+int smart_extractor_create(smart_extractor_t * ex, divedata_callback_fn_t cb, void * userdata, int flags)
+{
+	if (ex == NULL)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	smart_extractor_t e = (smart_extractor_t)malloc(sizeof(struct smart_extractor_));
+	if (e == NULL)
+		return -1;
+
+	smart_extractor_init(e, cb, userdata, flags);
+
+	* ex = e;
+	return 0;
+}
+
+void smart_extractor_close(smart_extractor_t ex)
+{
+	if (ex == NULL)
+		return;
+
+	free(ex->carry);
+	free(ex);
+}
+
+int smart_extractor_feed(smart_extractor_t ex, const void * chunk, uint32_t len)
+{
+	const uint8_t * data = (const uint8_t *)chunk;
+	const uint8_t * pend;
+	uint32_t need;
+	uint32_t take;
+	int rc;
+
+	if (! ex || (! chunk && len))
+		return EXTRACT_INVALID;
+
+	if (ex->status != EXTRACT_SUCCESS)
+		return ex->status;
+
+	// Contiguous Chunks must follow on directly from the Pending Dive
+	if ((ex->flags & SMART_EXTRACT_CONTIGUOUS) && (ex->have != 0) && (data != ex->start + ex->have))
 		return EXTRACT_INVALID;
 
-	while (pos < size)
+	while (len > 0)
 	{
-		if (strncmp((char *)(& ((uint8_t *)buffer)[pos]), (char *)hdr, 4) != 0)
-			return EXTRACT_CORRUPT;
+		if (ex->have == 0)
+		{
+			ex->start = data;
 
-		dlen = * (uint32_t *)(& ((uint8_t *)buffer)[pos + 4]);
-		if (pos + dlen > size)
-			return EXTRACT_TOO_SHORT;
+			if (len >= SMART_DIVE_HDRLEN)
+			{
+				rc = smart_extract_header(data, & ex->dlen);
+				if (rc != EXTRACT_SUCCESS)
+					return (ex->status = rc);
 
-		tok = * (uint32_t *)(& ((uint8_t *)buffer)[pos + 8]);
-		sprintf(token, "%u", tok);
+				// Emit Dives lying wholly within the Chunk without Copying
+				if (ex->dlen <= len)
+				{
+					smart_extract_emit(ex, data, ex->dlen);
 
-		if (cb)
-			cb(userdata, & ((uint8_t *)buffer)[pos], dlen, token);
+					data += ex->dlen;
+					len -= ex->dlen;
+					ex->dlen = 0;
+					continue;
+				}
+			}
+		}
 
-		pos += dlen;
-	}
+		// Collect the Header, then the Body of a Split Dive
+		need = (ex->dlen ? ex->dlen : SMART_DIVE_HDRLEN) - ex->have;
+		take = (len < need) ? len : need;
+
+		if (! (ex->flags & SMART_EXTRACT_CONTIGUOUS))
+		{
+			if (smart_extractor_reserve(ex, ex->have + take) != 0)
+				return (ex->status = EXTRACT_NO_MEMORY);
+
+			memcpy(ex->carry + ex->have, data, take);
+		}
+
+		ex->have += take;
+		data += take;
+		len -= take;
+
+		pend = (ex->flags & SMART_EXTRACT_CONTIGUOUS) ? ex->start : ex->carry;
 
-	if (pos != size)
-		return EXTRACT_EXTRA_DATA;
+		if ((ex->dlen == 0) && (ex->have == SMART_DIVE_HDRLEN))
+		{
+			rc = smart_extract_header(pend, & ex->dlen);
+			if (rc != EXTRACT_SUCCESS)
+				return (ex->status = rc);
+		}
+
+		if ((ex->dlen != 0) && (ex->have == ex->dlen))
+		{
+			smart_extract_emit(ex, pend, ex->dlen);
+
+			ex->have = 0;
+			ex->dlen = 0;
+		}
+	}
 
 	return EXTRACT_SUCCESS;
 }
+
+int smart_extractor_finish(smart_extractor_t ex)
+{
+	int rc;
+
+	if (! ex)
+		return EXTRACT_INVALID;
+
+	if (ex->status != EXTRACT_SUCCESS)
+		rc = ex->status;
+	else if (ex->have == 0)
+		rc = EXTRACT_SUCCESS;
+	else if (ex->dlen == 0)
+		rc = EXTRACT_EXTRA_DATA;
+	else
+		rc = EXTRACT_TOO_SHORT;
+
+	// Reset for the next Stream
+	ex->start = 0;
+	ex->have = 0;
+	ex->dlen = 0;
+	ex->status = EXTRACT_SUCCESS;
+
+	return rc;
+}
+
+int smart_extract_dives(void * buffer, uint32_t size, divedata_callback_fn_t cb, void * userdata)
+{
+	struct smart_extractor_ ex;
+	int rc;
+
+	if (! buffer)
+		return EXTRACT_INVALID;
+
+	// The whole Buffer is one Chunk, so no Carry-over is ever allocated
+	smart_extractor_init(& ex, cb, userdata, SMART_EXTRACT_CONTIGUOUS);
+
+	rc = smart_extractor_feed(& ex, buffer, size);
+	if (rc != EXTRACT_SUCCESS)
+		return rc;
+
+	return smart_extractor_finish(& ex);
+}
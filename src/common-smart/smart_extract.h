@@ -55,8 +55,17 @@ extern "C" {
 #define EXTRACT_CORRUPT			2		///< Invalid/Corrupt Data
 #define EXTRACT_TOO_SHORT		3		///< Length Extends Past End of Buffer
 #define EXTRACT_EXTRA_DATA		4		///< Extra Data at End of Buffer
+#define EXTRACT_NO_MEMORY		5		///< Out of Memory
 /*@}*/
 
+/**@{
+ * @name Extractor Flags
+ */
+#define SMART_EXTRACT_CONTIGUOUS	1	///< Chunks are consecutive and stay valid
+/*@}*/
+
+typedef struct smart_extractor_ *	smart_extractor_t;
+
 /**
  * @brief Extract Dives from a Transferred Data Buffer
  * @param[in] Dive Data Buffer Pointer
@@ -69,6 +78,56 @@ extern "C" {
  */
 int smart_extract_dives(void * buffer, uint32_t size, divedata_callback_fn_t cb, void * userdata);
 
+/**
+ * @brief Create an Incremental Dive Extractor
+ * @param[out] Extractor Handle
+ * @param[in] Dive Callback Function
+ * @param[in] Dive Callback Data
+ * @param[in] Extractor Flags
+ * @return 0 on success, -1 on error
+ *
+ * The extractor splits a transfer stream which arrives in chunks, such as
+ * from an IrDA read loop or a file, into dives.  A dive which lies wholly
+ * within one chunk is passed to the callback in place.  A dive split across
+ * chunks is gathered in an internal carry-over buffer, and the pointer given
+ * to the callback is only valid for the duration of the callback.
+ *
+ * If SMART_EXTRACT_CONTIGUOUS is given, each chunk must directly follow the
+ * previous one in memory and all chunks must remain valid, as is the case
+ * for a transfer buffer being filled or a mapped file.  Dives are then always
+ * passed in place and nothing is copied.
+ */
+int smart_extractor_create(smart_extractor_t * ex, divedata_callback_fn_t cb, void * userdata, int flags);
+
+/**
+ * @brief Free an Incremental Dive Extractor
+ * @param[in] Extractor Handle
+ */
+void smart_extractor_close(smart_extractor_t ex);
+
+/**
+ * @brief Feed the next Chunk of the Transfer Stream
+ * @param[in] Extractor Handle
+ * @param[in] Chunk Data Pointer
+ * @param[in] Chunk Length
+ * @return EXTRACT_SUCCESS or an EXTRACT_ error code
+ *
+ * Calls the callback function for each dive completed by this chunk.  Errors
+ * are sticky: once the stream is found to be corrupt, further calls return
+ * the same error until smart_extractor_finish() is called.
+ */
+int smart_extractor_feed(smart_extractor_t ex, const void * chunk, uint32_t len);
+
+/**
+ * @brief Finish the Transfer Stream
+ * @param[in] Extractor Handle
+ * @return EXTRACT_SUCCESS, or an EXTRACT_ error code if the stream was corrupt
+ * or ended partway through a dive
+ *
+ * Resets the extractor so that it may be fed another stream.
+ */
+int smart_extractor_finish(smart_extractor_t ex);
+
 #ifdef __cplusplus
 }
 #endif
@@ -62,6 +62,32 @@ typedef struct
 
 } alarm_entry_t;
 
+/*
+ * Smart DTI Decode Tables
+ *
+ * Map the leading byte(s) of a sample to the index of its entry in the
+ * model's DTI table, so that the type bits need not be scanned one at a
+ * time.
+ */
+#define DTI_DECODE_INVALID	0xFF	///< Invalid DTI Code
+#define DTI_DECODE_NEXT		0xFE	///< DTI Code Continues in Next Byte
+
+/*
+ * Smart Sample Handler
+ *
+ * Called by the profile decode loop once for each complete sample, before
+ * the sample time is advanced.
+ */
+typedef void (* smart_sample_fn_t)(smart_parser_t, void *);
+
+/*
+ * Smart Profile Decode Loop
+ *
+ * One loop is generated for each model's DTI table (see SMART_DEFINE_WALKER)
+ * and selected when the parser is created.
+ */
+typedef int (* smart_walk_fn_t)(smart_parser_t, const unsigned char *, uint32_t, smart_sample_fn_t, void *);
+
 enum
 {
 	DTI_PRESSURE_DEPTH,		///< Pressure/Depth DTI
@@ -86,6 +112,10 @@ struct smart_parser_
 	uint8_t					alarm_size;		///< Alarm Table Size
 	const alarm_entry_t *	alarm_table;	///< Alarm Table Pointer
 
+	uint8_t					decode[2][256];	///< DTI Decode Tables (Lead/Next Byte)
+	smart_walk_fn_t			walk_model;		///< Decode Loop Specialized for the Model
+	smart_walk_fn_t			walk;			///< Decode Loop in Use
+
 	uint32_t				time;			///< Current Time
 	uint32_t				depth;			///< Current Depth
 	uint32_t				temp;			///< Current Temperature
@@ -216,6 +246,346 @@ static const dti_entry_t smart_tec_table[] =
 	{DTI_RBT,				1,	0,	14,	1,	1},		// 1111 1111 1111 10dd dddd dddd
 };
 
+#define NBYTES	8
+#define NBITS	8
+
+static uint8_t smart_identify(const unsigned char * data, uint32_t size)
+{
+	uint8_t count = 0;
+	uint8_t i;
+	uint8_t j;
+
+	for (i = 0; i < ((size > NBYTES) ? NBYTES : size); ++i)
+	{
+		uint8_t value = data[i];
+		for (j = 0; j < NBITS; ++j)
+		{
+			uint8_t mask = (1 << (NBITS - 1 - j));
+			if ((value & mask) == 0)
+				return count;
+
+			count++;
+		}
+	}
+
+	return (uint8_t)(-1);
+}
+
+static uint8_t galileo_identify(const unsigned char value)
+{
+	if ((value & 0x80) == 0)
+		return 0;
+
+	if ((value & 0xE0) == 0x80)
+		return 1;
+
+	if ((value & 0xF0) != 0xF0)
+		return ((value & 0x70) >> 4);
+
+	return (value & 0x0F) + 7;
+}
+
+static uint32_t smart_fixsignbit(uint32_t x, uint32_t n)
+{
+	if ((n == 0) || (n > 32))
+		return 0;
+
+	uint32_t signbit = (1 << (n - 1));
+	uint32_t mask = (0xFFFFFFFF << n);
+
+	if ((x & signbit) == signbit)
+		return x | mask;
+	return x & ~mask;
+}
+
+static void smart_build_decode_table(smart_parser_t parser)
+{
+	unsigned char code[2];
+	unsigned int i;
+
+	for (i = 0; i < 256; ++i)
+	{
+		code[0] = (unsigned char)i;
+		code[1] = (unsigned char)i;
+
+		if (parser->dev->model == MDL_GALILEO_SOL)
+		{
+			/* Galileo DTI Codes fit in the Lead Byte */
+			parser->decode[0][i] = galileo_identify(code[0]);
+			parser->decode[1][i] = DTI_DECODE_INVALID;
+			continue;
+		}
+
+		/* Lead Byte Table (0xFF continues into the next byte) */
+		parser->decode[0][i] = smart_identify(code, 1);
+		if (parser->decode[0][i] == (uint8_t)(-1))
+			parser->decode[0][i] = DTI_DECODE_NEXT;
+
+		/* Next Byte Table (following a 0xFF lead byte) */
+		code[0] = 0xFF;
+		parser->decode[1][i] = smart_identify(code, 2);
+	}
+}
+
+#if defined(__GNUC__)
+#define SMART_INLINE	static inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define SMART_INLINE	static __forceinline
+#else
+#define SMART_INLINE	static inline
+#endif
+
+SMART_INLINE int smart_parse_dti(smart_parser_t parser, const dti_entry_t * dti, uint32_t value, int32_t svalue)
+{
+	switch (dti->type)
+	{
+	case DTI_PRESSURE_DEPTH:
+		parser->pressure += ((signed char)((svalue >> NBITS) & 0xFF)) * 250;
+		parser->depth += ((signed char)(svalue & 0xFF)) * 2;
+		parser->complete = 1;
+		break;
+
+	case DTI_RBT:
+		if (dti->abs)
+		{
+			parser->rbt = value;
+			parser->have_rbt = 1;
+		}
+		else
+		{
+			parser->rbt += svalue;
+		}
+
+		break;
+
+	case DTI_TEMPERATURE:
+		if (dti->abs)
+		{
+			parser->temp = value * 40;
+			parser->have_temp = 1;
+		}
+		else
+		{
+			parser->temp += svalue * 40;
+		}
+
+		break;
+
+	case DTI_PRESSURE:
+		if (dti->abs)
+		{
+			parser->pressure = value * 250;
+			parser->tank = dti->idx;
+			parser->have_pressure = 1;
+		}
+		else
+		{
+			parser->pressure += svalue * 250;
+		}
+
+		break;
+
+	case DTI_DEPTH:
+		if (dti->abs)
+		{
+			parser->depth = value * 2;
+			if (! parser->calibrated)
+			{
+				parser->calibrated = 1;
+				parser->dcal = parser->depth;
+			}
+
+			parser->have_depth = 1;
+		}
+		else
+		{
+			parser->depth += svalue * 2;
+		}
+
+		parser->complete = 1;
+		break;
+
+	case DTI_HEARTRATE:
+		if (dti->abs)
+		{
+			parser->heartrate = value;
+			parser->have_heartrate = 1;
+		}
+		else
+		{
+			parser->heartrate += svalue;
+		}
+
+		break;
+
+	case DTI_BEARING:
+		parser->bearing = value;
+		parser->have_bearing = 1;
+		break;
+
+	case DTI_ALARMS:
+		parser->alarms[dti->idx] = value;
+		parser->have_alarms = 1;
+		break;
+
+	case DTI_TIME:
+		parser->complete = value;
+		break;
+
+	default:
+		//WARNING("Unknown Sample Type");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Decode a single DTI and apply it to the parser state.  This is always
+ * inlined with a constant table entry in the model decode loops, so that
+ * the field widths and the type dispatch are resolved at compile time.
+ */
+SMART_INLINE int smart_decode_dti(smart_parser_t parser, const unsigned char * data, uint32_t size,
+		uint32_t * offset, const dti_entry_t * dti)
+{
+	const uint8_t n = dti->ntb % NBITS;
+	const uint8_t vbits = ((n > 0) && ! dti->ignore) ? (NBITS - n) : 0;
+	uint32_t value;
+	int32_t svalue;
+	uint8_t i;
+
+	// Mask the Value Bits out of the Last Type Byte
+	*offset += (dti->ntb / NBITS) + ((n > 0) ? 1 : 0);
+	value = vbits ? (data[*offset - 1] & (0xFF >> n)) : 0;
+
+	// Check for Overflow
+	if (*offset + dti->extra > size)
+	{
+		parser->dev->errcode = DRIVER_ERR_INVALID;
+		parser->dev->errmsg = "DTI extends past end of data buffer";
+		return -1;
+	}
+
+	// Process Extra Bits
+	for (i = 0; i < dti->extra; ++i)
+	{
+		value <<= NBITS;
+		value += data[*offset];
+		(*offset)++;
+	}
+
+	// Fix Sign Bit
+	svalue = (int32_t)smart_fixsignbit(value, vbits + dti->extra * NBITS);
+
+	// Parse the DTI
+	if (smart_parse_dti(parser, dti, value, svalue) != 0)
+		//WARNING("Unknown DTI Type");
+	{ }
+
+	return 0;
+}
+
+#define SMART_MAX_DTI		20		///< Largest Supported DTI Table
+
+#define SMART_DTI_CASE(k) \
+	case k: \
+		if ((k < ntable) && (smart_decode_dti(parser, data, size, & offset, & table[k]) != 0)) \
+			return -1; \
+		break;
+
+/*
+ * Profile Decode Loop over a DTI Table.  Each DTI index has its own case, so
+ * when the table is a constant each case decodes a fixed entry.
+ */
+SMART_INLINE int smart_walk_table(smart_parser_t parser, const unsigned char * data, uint32_t size,
+		smart_sample_fn_t fn, void * userdata, const dti_entry_t * table, uint8_t ntable)
+{
+	uint32_t offset = parser->hdr_size;
+	while (offset < size)
+	{
+		// Find the DTI Entry
+		uint8_t id = parser->decode[0][data[offset]];
+		if ((id == DTI_DECODE_NEXT) && (offset + 1 < size))
+			id = parser->decode[1][data[offset + 1]];
+
+		if (id >= ntable)
+		{
+			parser->dev->errcode = DRIVER_ERR_INVALID;
+			parser->dev->errmsg = "Invalid DTI Code";
+			return -1;
+		}
+
+		// Decode and Parse the DTI
+		switch (id)
+		{
+		SMART_DTI_CASE(0)	SMART_DTI_CASE(1)	SMART_DTI_CASE(2)	SMART_DTI_CASE(3)
+		SMART_DTI_CASE(4)	SMART_DTI_CASE(5)	SMART_DTI_CASE(6)	SMART_DTI_CASE(7)
+		SMART_DTI_CASE(8)	SMART_DTI_CASE(9)	SMART_DTI_CASE(10)	SMART_DTI_CASE(11)
+		SMART_DTI_CASE(12)	SMART_DTI_CASE(13)	SMART_DTI_CASE(14)	SMART_DTI_CASE(15)
+		SMART_DTI_CASE(16)	SMART_DTI_CASE(17)	SMART_DTI_CASE(18)	SMART_DTI_CASE(19)
+		}
+
+		// Process the Sample
+		while (parser->complete)
+		{
+			fn(parser, userdata);
+
+			// Done with Sample
+			parser->time += 4;
+			parser->complete--;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Define the Decode Loop for a Model's DTI Table
+ */
+#define SMART_DEFINE_WALKER(name, table) \
+	typedef char smart_walk_##name##_fits[(sizeof(table) / sizeof(dti_entry_t) <= SMART_MAX_DTI) ? 1 : -1]; \
+	static int smart_walk_##name(smart_parser_t parser, const unsigned char * data, uint32_t size, \
+			smart_sample_fn_t fn, void * userdata) \
+	{ \
+		return smart_walk_table(parser, data, size, fn, userdata, table, sizeof(table) / sizeof(dti_entry_t)); \
+	}
+
+SMART_DEFINE_WALKER(smart_pro, smart_pro_table)
+SMART_DEFINE_WALKER(galileo_sol, smart_galileo_sol_table)
+SMART_DEFINE_WALKER(aladin, smart_aladin_table)
+SMART_DEFINE_WALKER(aladin_tec2g, smart_aladin_tec2g_table)
+SMART_DEFINE_WALKER(smart_com, smart_com_table)
+SMART_DEFINE_WALKER(smart_tec, smart_tec_table)
+
+/*
+ * Generic Decode Loop, reading the DTI Table at Run Time
+ */
+static int smart_walk_generic(smart_parser_t parser, const unsigned char * data, uint32_t size,
+		smart_sample_fn_t fn, void * userdata)
+{
+	return smart_walk_table(parser, data, size, fn, userdata, parser->dti_table, parser->dti_size);
+}
+
+static int smart_parser_walk(smart_parser_t parser, const void * buffer, uint32_t size, smart_sample_fn_t fn, void * userdata)
+{
+	if (size < parser->hdr_size)
+	{
+		parser->dev->errcode = DRIVER_ERR_INVALID;
+		parser->dev->errmsg = "Data buffer is too short";
+		return -1;
+	}
+
+	uint32_t psize =  uint32_le((const unsigned char *)buffer, 4);
+	if (psize != size)
+	{
+		parser->dev->errcode = DRIVER_ERR_INVALID;
+		parser->dev->errmsg = "Data buffer size does not match header-specified data size";
+		return -1;
+	}
+
+	return parser->walk(parser, (const unsigned char *)buffer, size, fn, userdata);
+}
+
 int smart_parser_create(parser_handle_t * abstract, dev_handle_t abstract_dev)
 {
 	smart_parser_t * parser = (smart_parser_t *)(abstract);
@@ -239,6 +609,7 @@ int smart_parser_create(parser_handle_t * abstract, dev_handle_t abstract_dev)
 		p->hdr_size = 92;
 		p->dti_size = sizeof(smart_pro_table) / sizeof(dti_entry_t);
 		p->dti_table = smart_pro_table;
+		p->walk_model = smart_walk_smart_pro;
 		p->alarm_size = 0;
 		p->alarm_table = 0;
 		break;
@@ -247,6 +618,7 @@ int smart_parser_create(parser_handle_t * abstract, dev_handle_t abstract_dev)
 		p->hdr_size = 152;
 		p->dti_size = sizeof(smart_galileo_sol_table) / sizeof(dti_entry_t);
 		p->dti_table = smart_galileo_sol_table;
+		p->walk_model = smart_walk_galileo_sol;
 		p->alarm_size = 0;
 		p->alarm_table = 0;
 		break;
@@ -255,6 +627,7 @@ int smart_parser_create(parser_handle_t * abstract, dev_handle_t abstract_dev)
 		p->hdr_size = 108;
 		p->dti_size = sizeof(smart_aladin_table) / sizeof(dti_entry_t);
 		p->dti_table = smart_aladin_table;
+		p->walk_model = smart_walk_aladin;
 		p->alarm_size = 0;
 		p->alarm_table = 0;
 		break;
@@ -263,6 +636,7 @@ int smart_parser_create(parser_handle_t * abstract, dev_handle_t abstract_dev)
 		p->hdr_size = 116;
 		p->dti_size = sizeof(smart_aladin_tec2g_table) / sizeof(dti_entry_t);
 		p->dti_table = smart_aladin_tec2g_table;
+		p->walk_model = smart_walk_aladin_tec2g;
 		p->alarm_size = sizeof(smart_aladin_tec2g_alarms) / sizeof(alarm_entry_t);
 		p->alarm_table = smart_aladin_tec2g_alarms;
 		break;
@@ -271,6 +645,7 @@ int smart_parser_create(parser_handle_t * abstract, dev_handle_t abstract_dev)
 		p->hdr_size = 100;
 		p->dti_size = sizeof(smart_com_table) / sizeof(dti_entry_t);
 		p->dti_table = smart_com_table;
+		p->walk_model = smart_walk_smart_com;
 		p->alarm_size = 0;
 		p->alarm_table = 0;
 		break;
@@ -280,6 +655,7 @@ int smart_parser_create(parser_handle_t * abstract, dev_handle_t abstract_dev)
 		p->hdr_size = 132;
 		p->dti_size = sizeof(smart_tec_table) / sizeof(dti_entry_t);
 		p->dti_table = smart_tec_table;
+		p->walk_model = smart_walk_smart_tec;
 		p->alarm_size = 0;
 		p->alarm_table = 0;
 		break;
@@ -292,12 +668,24 @@ int smart_parser_create(parser_handle_t * abstract, dev_handle_t abstract_dev)
 
 	}
 
+	p->walk = p->walk_model;
+
+	smart_build_decode_table(p);
 	smart_parser_reset((parser_handle_t)p);
 
 	*abstract = (parser_handle_t)p;
 	return 0;
 }
 
+void smart_parser_set_specialized(parser_handle_t abstract, int enable)
+{
+	smart_parser_t parser = (smart_parser_t)(abstract);
+	if (parser == NULL)
+		return;
+
+	parser->walk = enable ? parser->walk_model : smart_walk_generic;
+}
+
 void smart_parser_close(parser_handle_t abstract)
 {
 	smart_parser_t parser = (smart_parser_t)(abstract);
@@ -663,224 +1051,142 @@ int smart_parser_parse_header(parser_handle_t abstract, const void * buffer, uin
 	return 0;
 }
 
-#define NBYTES	8
-#define NBITS	8
-
-static uint8_t smart_identify(const unsigned char * data, uint32_t size)
+static const char * alarm_name(smart_parser_t parser, uint8_t idx, uint8_t mask)
 {
-	uint8_t count = 0;
-	uint8_t i;
-	uint8_t j;
+	if ((parser == NULL) || ! parser->alarm_size)
+		return 0;
 
-	for (i = 0; i < ((size > NBYTES) ? NBYTES : size); ++i)
+	int i;
+	for (i = 0; i < parser->alarm_size; ++i)
 	{
-		uint8_t value = data[i];
-		for (j = 0; j < NBITS; ++j)
-		{
-			uint8_t mask = (1 << (NBITS - 1 - j));
-			if ((value & mask) == 0)
-				return count;
-
-			count++;
-		}
+		if ((parser->alarm_table[i].idx == idx) && (parser->alarm_table[i].mask == mask))
+			return parser->alarm_table[i].name;
 	}
 
-	return (uint8_t)(-1);
+	return 0;
 }
 
-static uint8_t galileo_identify(const unsigned char value)
+typedef struct
 {
-	if ((value & 0x80) == 0)
-		return 0;
-
-	if ((value & 0xE0) == 0x80)
-		return 1;
+	waypoint_callback_fn_t	cb;				///< Waypoint Callback Function
+	void *					userdata;		///< Waypoint Callback Data
 
-	if ((value & 0xF0) != 0xF0)
-		return ((value & 0x70) >> 4);
-
-	return (value & 0x0F) + 7;
-}
+} smart_waypoint_data_t;
 
-static uint32_t smart_fixsignbit(uint32_t x, uint32_t n)
+static void smart_emit_waypoint(smart_parser_t parser, void * userdata)
 {
-	if ((n == 0) || (n > 32))
-		return 0;
+	smart_waypoint_data_t * wd = (smart_waypoint_data_t *)(userdata);
+	waypoint_callback_fn_t cb = wd->cb;
 
-	uint32_t signbit = (1 << (n - 1));
-	uint32_t mask = (0xFFFFFFFF << n);
-
-	if ((x & signbit) == signbit)
-		return x | mask;
-	return x & ~mask;
-}
+	// Send the Waypoint Time
+	if (cb) cb(wd->userdata, DIVE_WAYPOINT_TIME, parser->time, 0, 0);
 
-int smart_process_dti(smart_parser_t parser, const unsigned char * data, uint32_t size,
-		uint32_t * offset, const dti_entry_t * dti, uint32_t * value, int32_t * svalue)
-{
-	uint8_t i;
+	// Send Depth Data
+	if (parser->have_depth)
+		if (cb) cb(wd->userdata, DIVE_WAYPOINT_DEPTH, parser->depth - parser->dcal, 0, 0);
 
-	// Skip the Processed Type Bits
-	*offset += dti->ntb / NBITS;
+	// Send Temperature Data
+	if (parser->have_temp)
+		if (cb) cb(wd->userdata, DIVE_WAYPOINT_TEMP, parser->temp, 0, 0);
 
-	// Process Remaining Bits
-	uint8_t nbits = 0;
-	uint8_t n = dti->ntb % NBITS;
-	if (n > 0)
-	{
-		nbits = NBITS - n;
-		*value = data[*offset] & (0xFF >> n);
-		if (dti->ignore)
-		{
-			nbits = 0;
-			*value = 0;
-		}
+	// Send Pressure Data
+	if (parser->have_pressure)
+		if (cb) cb(wd->userdata, DIVE_WAYPOINT_PX, parser->pressure, parser->tank, 0);
 
-		(*offset)++;
-	}
+	// Send RBT Data
+	if (parser->have_rbt)
+		if (cb) cb(wd->userdata, DIVE_WAYPOINT_RBT, parser->rbt, 0, 0);
 
-	// Check for Overflow
-	if (*offset + dti->extra > size)
-	{
-		parser->dev->errcode = DRIVER_ERR_INVALID;
-		parser->dev->errmsg = "DTI extends past end of data buffer";
-		return -1;
-	}
+	// Send Heart Rate Data
+	if (parser->have_heartrate)
+		if (cb) cb(wd->userdata, DIVE_WAYPOINT_HEARTRATE, parser->heartrate, 0, 0);
 
-	// Process Extra Bits
-	for (i = 0; i < dti->extra; ++i)
+	// Send Bearing Data
+	if (parser->have_bearing)
 	{
-		nbits += NBITS;
-		(*value) <<= NBITS;
-		(*value) += data[*offset];
-		(*offset)++;
+		if (cb) cb(wd->userdata, DIVE_WAYPOINT_BEARING, parser->bearing, 0, 0);
+		parser->have_bearing = 0;
 	}
 
-	// Fix Sign Bit
-	*svalue = (int32_t)smart_fixsignbit(*value, nbits);
-
-	// Done with DTI Processing
-	return 0;
-}
-
-int smart_parse_dti(smart_parser_t parser, const dti_entry_t * dti, uint32_t value, int32_t svalue)
-{
-	switch (dti->type)
+	// Send Alarm Data
+	if (parser->have_alarms)
 	{
-	case DTI_PRESSURE_DEPTH:
-		parser->pressure += ((signed char)((svalue >> NBITS) & 0xFF)) * 250;
-		parser->depth += ((signed char)(svalue & 0xFF)) * 2;
-		parser->complete = 1;
-		break;
-
-	case DTI_RBT:
-		if (dti->abs)
-		{
-			parser->rbt = value;
-			parser->have_rbt = 1;
-		}
-		else
-		{
-			parser->rbt += svalue;
-		}
-
-		break;
-
-	case DTI_TEMPERATURE:
-		if (dti->abs)
-		{
-			parser->temp = value * 40;
-			parser->have_temp = 1;
-		}
-		else
-		{
-			parser->temp += svalue * 40;
-		}
-
-		break;
-
-	case DTI_PRESSURE:
-		if (dti->abs)
-		{
-			parser->pressure = value * 250;
-			parser->tank = dti->idx;
-			parser->have_pressure = 1;
-		}
-		else
-		{
-			parser->pressure += svalue * 250;
-		}
-
-		break;
+		uint8_t i;
+		uint8_t j;
 
-	case DTI_DEPTH:
-		if (dti->abs)
+		for (i = 0; i < 3; i++)
 		{
-			parser->depth = value * 2;
-			if (! parser->calibrated)
+			for (j = 0; j < 9; j++)
 			{
-				parser->calibrated = 1;
-				parser->dcal = parser->depth;
+				uint16_t mask = (1 << j);
+				if (((parser->alarms[i] & mask) == mask) && cb)
+				{
+					const char * aname = alarm_name(parser, i, mask);
+					if (! aname)
+					{
+						char buf[20];
+						sprintf(buf, "alarm%u-%u", i, j);
+						cb(wd->userdata, DIVE_WAYPOINT_ALARM, j, i, buf);
+					}
+					else
+					{
+						cb(wd->userdata, DIVE_WAYPOINT_ALARM, j, i, aname);
+					}
+				}
 			}
-
-			parser->have_depth = 1;
-		}
-		else
-		{
-			parser->depth += svalue * 2;
-		}
-
-		parser->complete = 1;
-		break;
-
-	case DTI_HEARTRATE:
-		if (dti->abs)
-		{
-			parser->heartrate = value;
-			parser->have_heartrate = 1;
-		}
-		else
-		{
-			parser->heartrate += svalue;
 		}
 
-		break;
-
-	case DTI_BEARING:
-		parser->bearing = value;
-		parser->have_bearing = 1;
-		break;
-
-	case DTI_ALARMS:
-		parser->alarms[dti->idx] = value;
-		parser->have_alarms = 1;
-		break;
-
-	case DTI_TIME:
-		parser->complete = value;
-		break;
-
-	default:
-		//WARNING("Unknown Sample Type");
-		return -1;
+		parser->have_alarms = 0;
 	}
-
-	return 0;
 }
 
-const char * alarm_name(smart_parser_t parser, uint8_t idx, uint8_t mask)
+/*
+ * Store a Sample in the Column Buffers.  Alarm flags are packed with bit
+ * (9 * group + flag), matching the (index, value) pairs of the waypoint
+ * alarm tokens.
+ */
+static void smart_store_columns(smart_parser_t parser, void * userdata)
 {
-	if ((parser == NULL) || ! parser->alarm_size)
-		return 0;
+	profile_columns_t * cols = (profile_columns_t *)(userdata);
+	uint32_t n = cols->count++;
+	uint8_t present = 0;
 
-	int i;
-	for (i = 0; i < parser->alarm_size; ++i)
+	if (n >= cols->capacity)
 	{
-		if ((parser->alarm_table[i].idx == idx) && (parser->alarm_table[i].mask == mask))
-			return parser->alarm_table[i].name;
+		parser->have_bearing = 0;
+		parser->have_alarms = 0;
+		return;
 	}
 
-	return 0;
+	if (cols->time) cols->time[n] = parser->time;
+	if (cols->depth) cols->depth[n] = parser->have_depth ? parser->depth - parser->dcal : 0;
+	if (cols->temp) cols->temp[n] = parser->have_temp ? parser->temp : 0;
+	if (cols->pressure) cols->pressure[n] = parser->have_pressure ? parser->pressure : 0;
+	if (cols->tank) cols->tank[n] = parser->have_pressure ? parser->tank : 0;
+	if (cols->rbt) cols->rbt[n] = parser->have_rbt ? parser->rbt : 0;
+	if (cols->heartrate) cols->heartrate[n] = parser->have_heartrate ? parser->heartrate : 0;
+	if (cols->bearing) cols->bearing[n] = parser->have_bearing ? parser->bearing : 0;
+	if (cols->alarms)
+	{
+		cols->alarms[n] = 0;
+		if (parser->have_alarms)
+			cols->alarms[n] = (uint32_t)(parser->alarms[0] & 0x1FF)
+				| ((uint32_t)(parser->alarms[1] & 0x1FF) << 9)
+				| ((uint32_t)(parser->alarms[2] & 0x1FF) << 18);
+	}
+
+	if (parser->have_depth) present |= DIVE_COLUMN_DEPTH;
+	if (parser->have_temp) present |= DIVE_COLUMN_TEMP;
+	if (parser->have_pressure) present |= DIVE_COLUMN_PX;
+	if (parser->have_rbt) present |= DIVE_COLUMN_RBT;
+	if (parser->have_heartrate) present |= DIVE_COLUMN_HEARTRATE;
+	if (parser->have_bearing) present |= DIVE_COLUMN_BEARING;
+	if (parser->have_alarms) present |= DIVE_COLUMN_ALARMS;
+
+	if (cols->present) cols->present[n] = present;
+
+	parser->have_bearing = 0;
+	parser->have_alarms = 0;
 }
 
 int smart_parser_parse_profile(parser_handle_t abstract, const void * buffer, uint32_t size, waypoint_callback_fn_t cb, void * userdata)
@@ -892,119 +1198,31 @@ int smart_parser_parse_profile(parser_handle_t abstract, const void * buffer, ui
 		return -1;
 	}
 
-	if (size < parser->hdr_size)
+	smart_waypoint_data_t wd;
+	wd.cb = cb;
+	wd.userdata = userdata;
+
+	return smart_parser_walk(parser, buffer, size, smart_emit_waypoint, & wd);
+}
+
+int smart_parser_parse_columns(parser_handle_t abstract, const void * buffer, uint32_t size, profile_columns_t * cols)
+{
+	smart_parser_t parser = (smart_parser_t)(abstract);
+	if ((parser == NULL) || (cols == NULL))
 	{
-		parser->dev->errcode = DRIVER_ERR_INVALID;
-		parser->dev->errmsg = "Data buffer is too short";
+		errno = EINVAL;
 		return -1;
 	}
 
-	uint32_t psize =  uint32_le((const unsigned char *)buffer, 4);
-	if (psize != size)
-	{
-		parser->dev->errcode = DRIVER_ERR_INVALID;
-		parser->dev->errmsg = "Data buffer size does not match header-specified data size";
+	cols->count = 0;
+	if (smart_parser_walk(parser, buffer, size, smart_store_columns, cols) != 0)
 		return -1;
-	}
 
-	const unsigned char * data = (const unsigned char *)buffer;
-	uint32_t offset = parser->hdr_size;
-	while (offset < size)
+	if (cols->count > cols->capacity)
 	{
-		// Find the DTI Entry
-		uint8_t id = 0;
-		if (parser->dev->model == MDL_GALILEO_SOL)
-			id = galileo_identify(data[offset]);
-		else
-			id = smart_identify(data + offset, size - offset);
-
-		if (id > parser->dti_size)
-		{
-			parser->dev->errcode = DRIVER_ERR_INVALID;
-			parser->dev->errmsg = "Invalid DTI Code";
-			return -1;
-		}
-
-		// Process the DTI
-		uint32_t value = 0;
-		int32_t svalue = 0;
-
-		if (smart_process_dti(parser, data, size, & offset, & parser->dti_table[id], & value, & svalue) != 0)
-			return -1;
-
-		// Parse the DTI
-		if (smart_parse_dti(parser, & parser->dti_table[id], value, svalue) != 0)
-			//WARNING("Unknown DTI Type");
-		{ }
-
-		// Process the Sample
-		while (parser->complete)
-		{
-			// Send the Waypoint Time
-			if (cb) cb(userdata, DIVE_WAYPOINT_TIME, parser->time, 0, 0);
-
-			// Send Depth Data
-			if (parser->have_depth)
-				if (cb) cb(userdata, DIVE_WAYPOINT_DEPTH, parser->depth - parser->dcal, 0, 0);
-
-			// Send Temperature Data
-			if (parser->have_temp)
-				if (cb) cb(userdata, DIVE_WAYPOINT_TEMP, parser->temp, 0, 0);
-
-			// Send Pressure Data
-			if (parser->have_pressure)
-				if (cb) cb(userdata, DIVE_WAYPOINT_PX, parser->pressure, parser->tank, 0);
-
-			// Send RBT Data
-			if (parser->have_rbt)
-				if (cb) cb(userdata, DIVE_WAYPOINT_RBT, parser->rbt, 0, 0);
-
-			// Send Heart Rate Data
-			if (parser->have_heartrate)
-				if (cb) cb(userdata, DIVE_WAYPOINT_HEARTRATE, parser->heartrate, 0, 0);
-
-			// Send Bearing Data
-			if (parser->have_bearing)
-			{
-				if (cb) cb(userdata, DIVE_WAYPOINT_BEARING, parser->bearing, 0, 0);
-				parser->have_bearing = 0;
-			}
-
-			// Send Alarm Data
-			if (parser->have_alarms)
-			{
-				uint8_t i;
-				uint8_t j;
-
-				for (i = 0; i < 3; i++)
-				{
-					for (j = 0; j < 9; j++)
-					{
-						uint16_t mask = (1 << j);
-						if (((parser->alarms[i] & mask) == mask) && cb)
-						{
-							const char * aname = alarm_name(parser, i, mask);
-							if (! aname)
-							{
-								char buf[20];
-								sprintf(buf, "alarm%u-%u", i, j);
-								cb(userdata, DIVE_WAYPOINT_ALARM, j, i, buf);
-							}
-							else
-							{
-								cb(userdata, DIVE_WAYPOINT_ALARM, j, i, aname);
-							}
-						}
-					}
-				}
-
-				parser->have_alarms = 0;
-			}
-
-			// Done with Sample
-			parser->time += 4;
-			parser->complete--;
-		}
+		parser->dev->errcode = DRIVER_ERR_INVALID;
+		parser->dev->errmsg = "Profile column buffers are too small";
+		return -1;
 	}
 
 	return 0;
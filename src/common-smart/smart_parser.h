@@ -49,8 +49,19 @@ int smart_parser_create(parser_handle_t * parser, dev_handle_t dev);
 void smart_parser_close(parser_handle_t parser);
 int smart_parser_reset(parser_handle_t parser);
 
+/**
+ * @brief Select the Profile Decode Loop
+ * @param[in] Parser Handle
+ * @param[in] Non-zero to use the loop specialized for the model (the default)
+ *
+ * The generic loop reads the model's DTI table at run time; it is kept so
+ * that the benchmarks can compare it against the specialized loops.
+ */
+void smart_parser_set_specialized(parser_handle_t parser, int enable);
+
 int smart_parser_parse_header(parser_handle_t parser, const void * buffer, uint32_t size, header_callback_fn_t cb, void * userdata);
 int smart_parser_parse_profile(parser_handle_t parser, const void * buffer, uint32_t size, waypoint_callback_fn_t cb, void * userdata);
+int smart_parser_parse_columns(parser_handle_t parser, const void * buffer, uint32_t size, profile_columns_t * cols);
 
 #ifdef __cplusplus
 }
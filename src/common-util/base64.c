@@ -22,25 +22,28 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <benthos/divecomputer/base64.h>
 
+#include "base64_simd.h"
+
 /*
  * Base64 Encoding Table
  */
-static char encoding_table[] = {'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H',
-                                'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P',
-                                'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X',
-                                'Y', 'Z', 'a', 'b', 'c', 'd', 'e', 'f',
-                                'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n',
-                                'o', 'p', 'q', 'r', 's', 't', 'u', 'v',
-                                'w', 'x', 'y', 'z', '0', '1', '2', '3',
-                                '4', '5', '6', '7', '8', '9', '+', '/'};
+static const char encoding_table[] = {'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H',
+                                      'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P',
+                                      'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X',
+                                      'Y', 'Z', 'a', 'b', 'c', 'd', 'e', 'f',
+                                      'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n',
+                                      'o', 'p', 'q', 'r', 's', 't', 'u', 'v',
+                                      'w', 'x', 'y', 'z', '0', '1', '2', '3',
+                                      '4', '5', '6', '7', '8', '9', '+', '/'};
 
 /*
  * Base64 Decoding Table
  */
-static char decoding_table[] = {
+static const signed char decoding_table[] = {
 	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,
 	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,
 	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	62,	-1,	-1,	-1,	63,
@@ -59,75 +62,325 @@ static char decoding_table[] = {
 	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1,	-1, -1,	-1,	-1
 };
 
+//! Vectorized Encoding Kernel
+typedef size_t (* encode_kernel_fn_t)(const unsigned char *, size_t, char *);
+
+//! Vectorized Decoding Kernel
+typedef size_t (* decode_kernel_fn_t)(const char *, size_t, unsigned char *);
+
 /*
- * Modulus Table
+ * Selected Implementation
+ *
+ * Resolved on first use.  Concurrent first calls may both run the detection,
+ * but they store the same values.
  */
-static int mod_table[] = {0, 2, 1};
+static int					g_impl = BASE64_IMPL_AUTO;
+static encode_kernel_fn_t	g_encode_kernel = 0;
+static decode_kernel_fn_t	g_decode_kernel = 0;
+
+int base64_select_impl(int impl)
+{
+	int best = BASE64_IMPL_SCALAR;
+
+#ifdef BASE64_HAVE_X86
+	if (base64_cpu_has_avx2())
+		best = BASE64_IMPL_AVX2;
+	else if (base64_cpu_has_sse41())
+		best = BASE64_IMPL_SSE41;
+#endif
+
+	if ((impl < BASE64_IMPL_SCALAR) || (impl > best))
+		impl = best;
+
+	switch (impl)
+	{
+#ifdef BASE64_HAVE_X86
+	case BASE64_IMPL_AVX2:
+		g_encode_kernel = base64_encode_avx2;
+		g_decode_kernel = base64_decode_avx2;
+		break;
+
+	case BASE64_IMPL_SSE41:
+		g_encode_kernel = base64_encode_sse41;
+		g_decode_kernel = base64_decode_sse41;
+		break;
+#endif
+
+	default:
+		g_encode_kernel = 0;
+		g_decode_kernel = 0;
+		break;
+	}
+
+	g_impl = impl;
+	return impl;
+}
+
+static void base64_init(void)
+{
+	if (g_impl == BASE64_IMPL_AUTO)
+		base64_select_impl(BASE64_IMPL_AUTO);
+}
+
+/* Encode whole 3-byte Groups, returning the Number of Characters Written */
+static size_t encode_groups(const unsigned char * data, size_t in_length, char * out)
+{
+	size_t i = 0;
+	size_t j;
+
+	if (g_encode_kernel)
+		i = g_encode_kernel(data, in_length, out);
+
+	for (j = (i / 3) * 4; i + 3 <= in_length; i += 3, j += 4)
+	{
+		uint32_t triple = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+
+		out[j + 0] = encoding_table[(triple >> 18) & 0x3F];
+		out[j + 1] = encoding_table[(triple >> 12) & 0x3F];
+		out[j + 2] = encoding_table[(triple >>  6) & 0x3F];
+		out[j + 3] = encoding_table[triple & 0x3F];
+	}
+
+	return j;
+}
+
+/* Encode a final Group of 1 or 2 Bytes with Padding */
+static size_t encode_tail(const unsigned char * data, size_t in_length, char * out)
+{
+	uint32_t triple;
+
+	if (in_length == 0)
+		return 0;
+
+	triple = data[0] << 16;
+	if (in_length > 1)
+		triple |= data[1] << 8;
+
+	out[0] = encoding_table[(triple >> 18) & 0x3F];
+	out[1] = encoding_table[(triple >> 12) & 0x3F];
+	out[2] = (in_length > 1) ? encoding_table[(triple >> 6) & 0x3F] : '=';
+	out[3] = '=';
+
+	return 4;
+}
+
+/*
+ * Decode whole 4-character Groups, of which only the last may be padded.
+ * The output may alias the input: every group is read before it is written,
+ * and output never runs ahead of input.
+ */
+static int decode_groups(const char * data, size_t in_length, unsigned char * out, size_t * out_length)
+{
+	const unsigned char * in = (const unsigned char *)data;
+	size_t i = 0;
+	size_t j;
+	int a, b, c, d;
+
+	if (g_decode_kernel)
+		i = g_decode_kernel(data, in_length, out);
+
+	for (j = (i / 4) * 3; i + 4 < in_length; i += 4, j += 3)
+	{
+		a = decoding_table[in[i]];
+		b = decoding_table[in[i + 1]];
+		c = decoding_table[in[i + 2]];
+		d = decoding_table[in[i + 3]];
+
+		if ((a | b | c | d) < 0)
+			return -1;
+
+		out[j + 0] = (unsigned char)((a << 2) | (b >> 4));
+		out[j + 1] = (unsigned char)((b << 4) | (c >> 2));
+		out[j + 2] = (unsigned char)((c << 6) | d);
+	}
+
+	// Last Group, which may end in "=" or "=="
+	if (i < in_length)
+	{
+		a = decoding_table[in[i]];
+		b = decoding_table[in[i + 1]];
+		c = (in[i + 2] == '=') ? 0 : decoding_table[in[i + 2]];
+		d = (in[i + 3] == '=') ? 0 : decoding_table[in[i + 3]];
+
+		if ((a | b | c | d) < 0)
+			return -1;
+		if ((in[i + 2] == '=') && (in[i + 3] != '='))
+			return -1;
+
+		out[j++] = (unsigned char)((a << 2) | (b >> 4));
+		if (in[i + 2] != '=')
+			out[j++] = (unsigned char)((b << 4) | (c >> 2));
+		if (in[i + 3] != '=')
+			out[j++] = (unsigned char)((c << 6) | d);
+	}
 
+	* out_length = j;
+	return 0;
+}
 
 char * base64_encode(const unsigned char * data, size_t input_length, size_t * output_length)
 {
-	int i, j;
 	char * encoded_data;
+	size_t n;
+
+	base64_init();
+
+	encoded_data = malloc(BASE64_ENCODE_BOUND(input_length) + 1);
+	if (encoded_data == NULL)
+		return NULL;
 
-	* output_length = ((input_length - 1) / 3) * 4 + 4;
+	n = encode_groups(data, input_length, encoded_data);
+	n += encode_tail(data + (input_length / 3) * 3, input_length % 3, encoded_data + n);
+	encoded_data[n] = 0;
 
-    encoded_data = malloc(* output_length);
-    if (encoded_data == NULL)
-    	return NULL;
+	* output_length = n;
+	return encoded_data;
+}
 
-    for (i = 0, j = 0; i < input_length; )
-    {
-        uint32_t octet_a = i < input_length ? data[i++] : 0;
-        uint32_t octet_b = i < input_length ? data[i++] : 0;
-        uint32_t octet_c = i < input_length ? data[i++] : 0;
+unsigned char * base64_decode(const char * data, size_t input_length, size_t * output_length)
+{
+	unsigned char * decoded_data;
 
-        uint32_t triple = (octet_a << 0x10) + (octet_b << 0x08) + octet_c;
+	if (input_length % 4 != 0)
+		return NULL;
 
-        encoded_data[j++] = encoding_table[(triple >> 3 * 6) & 0x3F];
-        encoded_data[j++] = encoding_table[(triple >> 2 * 6) & 0x3F];
-        encoded_data[j++] = encoding_table[(triple >> 1 * 6) & 0x3F];
-        encoded_data[j++] = encoding_table[(triple >> 0 * 6) & 0x3F];
-    }
+	decoded_data = malloc(BASE64_DECODE_BOUND(input_length) + 1);
+	if (decoded_data == NULL)
+		return NULL;
 
-    for (i = 0; i < mod_table[input_length % 3]; i++)
-        encoded_data[*output_length - 1 - i] = '=';
+	if (base64_decode_buf(data, input_length, decoded_data, output_length) != 0)
+	{
+		free(decoded_data);
+		return NULL;
+	}
 
-    return encoded_data;
+	return decoded_data;
 }
 
+int base64_decode_buf(const char * data, size_t input_length, unsigned char * out, size_t * output_length)
+{
+	base64_init();
+
+	if (input_length % 4 != 0)
+		return -1;
 
-unsigned char * base64_decode(const char *data, size_t input_length, size_t *output_length)
+	return decode_groups(data, input_length, out, output_length);
+}
+
+void base64_encoder_init(base64_encoder_t * enc)
 {
-	int i, j;
-	unsigned char * decoded_data;
+	enc->ncarry = 0;
+}
+
+size_t base64_encode_update(base64_encoder_t * enc, const unsigned char * data, size_t in_length, char * out)
+{
+	size_t n = 0;
+	size_t bulk;
+
+	base64_init();
+
+	// Complete the Carried-over Group
+	if (enc->ncarry)
+	{
+		while ((enc->ncarry < 3) && in_length)
+		{
+			enc->carry[enc->ncarry++] = * data++;
+			in_length--;
+		}
 
-    if (input_length % 4 != 0) return NULL;
+		if (enc->ncarry < 3)
+			return 0;
 
-    * output_length = (input_length >> 2) * 3;
-    if (data[input_length - 1] == '=') (* output_length)--;
-    if (data[input_length - 2] == '=') (* output_length)--;
+		n = encode_groups(enc->carry, 3, out);
+		enc->ncarry = 0;
+	}
 
-    decoded_data = malloc(* output_length);
-    if (decoded_data == NULL)
-    	return NULL;
+	bulk = (in_length / 3) * 3;
+	n += encode_groups(data, bulk, out + n);
 
-    for (i = 0, j = 0; i < input_length; )
-    {
-        uint32_t sextet_a = data[i] == '=' ? 0 & i++ : decoding_table[(unsigned char)data[i++]];
-        uint32_t sextet_b = data[i] == '=' ? 0 & i++ : decoding_table[(unsigned char)data[i++]];
-        uint32_t sextet_c = data[i] == '=' ? 0 & i++ : decoding_table[(unsigned char)data[i++]];
-        uint32_t sextet_d = data[i] == '=' ? 0 & i++ : decoding_table[(unsigned char)data[i++]];
+	// Carry the Remainder to the next Block
+	enc->ncarry = (unsigned int)(in_length - bulk);
+	memcpy(enc->carry, data + bulk, enc->ncarry);
 
-        uint32_t triple = (sextet_a << 3 * 6)
-        	+ (sextet_b << 2 * 6)
-        	+ (sextet_c << 1 * 6)
-        	+ (sextet_d << 0 * 6);
+	return n;
+}
+
+size_t base64_encode_final(base64_encoder_t * enc, char * out)
+{
+	size_t n = encode_tail(enc->carry, enc->ncarry, out);
+
+	enc->ncarry = 0;
+	return n;
+}
 
-        if (j < *output_length) decoded_data[j++] = (triple >> 2 * 8) & 0xFF;
-        if (j < *output_length) decoded_data[j++] = (triple >> 1 * 8) & 0xFF;
-        if (j < *output_length) decoded_data[j++] = (triple >> 0 * 8) & 0xFF;
-    }
+void base64_decoder_init(base64_decoder_t * dec)
+{
+	dec->ncarry = 0;
+	dec->done = 0;
+}
+
+int base64_decode_update(base64_decoder_t * dec, const char * data, size_t in_length,
+		unsigned char * out, size_t * out_length)
+{
+	size_t n = 0;
+	size_t bulk;
+	size_t k;
+
+	base64_init();
+
+	* out_length = 0;
+
+	// Nothing may follow the Padding
+	if (dec->done && in_length)
+		return -1;
+
+	// Complete the Carried-over Group
+	if (dec->ncarry)
+	{
+		while ((dec->ncarry < 4) && in_length)
+		{
+			dec->carry[dec->ncarry++] = * data++;
+			in_length--;
+		}
+
+		if (dec->ncarry < 4)
+			return 0;
+
+		if (decode_groups(dec->carry, 4, out, & n) != 0)
+			return -1;
+
+		dec->ncarry = 0;
+		dec->done = (dec->carry[3] == '=');
+
+		if (dec->done && in_length)
+			return -1;
+	}
+
+	bulk = in_length & ~(size_t)3;
+	if (bulk)
+	{
+		if (decode_groups(data, bulk, out + n, & k) != 0)
+			return -1;
+
+		n += k;
+		dec->done = (data[bulk - 1] == '=');
+
+		if (dec->done && (bulk != in_length))
+			return -1;
+	}
+
+	// Carry the Remainder to the next Block
+	dec->ncarry = (unsigned int)(in_length - bulk);
+	memcpy(dec->carry, data + bulk, dec->ncarry);
+
+	* out_length = n;
+	return 0;
+}
+
+int base64_decode_final(base64_decoder_t * dec)
+{
+	int rv = dec->ncarry ? -1 : 0;
 
-    return decoded_data;
+	base64_decoder_init(dec);
+	return rv;
 }
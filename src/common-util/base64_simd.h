@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ * www.asymworks.com / info@asymworks.com
+ *
+ * This file is part of the Benthos Dive Log Package (benthos-log.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+
+#ifndef BASE64_SIMD_H_
+#define BASE64_SIMD_H_
+
+/**
+ * @file src/common-util/base64_simd.h
+ * @brief Vectorized Base 64 Kernels
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ *
+ * Each kernel handles the bulk of a buffer and returns the number of input
+ * bytes it consumed, leaving the tail (and, for decoding, any block which
+ * contains padding or invalid characters) to the scalar code.  Decoding
+ * kernels may be run in place.
+ */
+
+#include <stddef.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#if defined(_MSC_VER) || (defined(__GNUC__) && ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || defined(__clang__)
+#define BASE64_HAVE_X86		1
+#endif
+#endif
+
+#ifdef BASE64_HAVE_X86
+
+/**@{
+ * @name x86 CPU Feature Detection
+ */
+int base64_cpu_has_sse41(void);
+int base64_cpu_has_avx2(void);
+/*@}*/
+
+/**@{
+ * @name x86 Encoding Kernels
+ */
+size_t base64_encode_sse41(const unsigned char * in, size_t len, char * out);
+size_t base64_encode_avx2(const unsigned char * in, size_t len, char * out);
+/*@}*/
+
+/**@{
+ * @name x86 Decoding Kernels
+ */
+size_t base64_decode_sse41(const char * in, size_t len, unsigned char * out);
+size_t base64_decode_avx2(const char * in, size_t len, unsigned char * out);
+/*@}*/
+
+#endif /* BASE64_HAVE_X86 */
+
+#endif /* BASE64_SIMD_H_ */
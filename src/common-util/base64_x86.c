@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ * www.asymworks.com / info@asymworks.com
+ *
+ * This file is part of the Benthos Dive Log Package (benthos-log.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+
+/*
+ * x86 Base 64 Kernels
+ *
+ * The encoder and decoder follow the pshufb-based approach of Wojciech Muła
+ * and Daniel Lemire ("Faster Base64 Encoding and Decoding using AVX2
+ * Instructions", ACM TOW 2018).  Encoding splits each 3-byte group into four
+ * sextets with a shuffle and two 16-bit multiplies, then maps sextets to ASCII
+ * by adding an offset picked from a 16-entry table.  Decoding validates each
+ * character by nibble lookups, translates with another offset table and packs
+ * the sextets back together with multiply-adds.
+ *
+ * The kernels are compiled with function target attributes so that the rest
+ * of the library needs no special compiler flags; callers must check the CPU
+ * features before using them.
+ */
+
+#include "base64_simd.h"
+
+#ifdef BASE64_HAVE_X86
+
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_SSE41
+#define TARGET_AVX2
+#else
+#define TARGET_SSE41		__attribute__((target("sse4.1")))
+#define TARGET_AVX2			__attribute__((target("avx2")))
+#endif
+
+/* CPU Feature Detection */
+#ifdef _MSC_VER
+
+int base64_cpu_has_sse41(void)
+{
+	int info[4];
+
+	__cpuid(info, 1);
+	return (info[2] & (1 << 19)) != 0;
+}
+
+int base64_cpu_has_avx2(void)
+{
+	int info[4];
+
+	// AVX State must be Enabled by the OS
+	__cpuid(info, 1);
+	if (! (info[2] & (1 << 27)) || ((_xgetbv(0) & 6) != 6))
+		return 0;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+}
+
+#else
+
+int base64_cpu_has_sse41(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse4.1");
+}
+
+int base64_cpu_has_avx2(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+/* Encode 12 Bytes to 16 Characters (Input is in Bytes 0-11) */
+TARGET_SSE41 static __m128i enc_sse41(__m128i in)
+{
+	const __m128i shuf = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+	const __m128i lut = _mm_setr_epi8(
+		'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+	__m128i t0, t1, t2, t3, idx, res;
+
+	// Split each 3-byte Group into 4 Sextets, one per Byte
+	in = _mm_shuffle_epi8(in, shuf);
+	t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+	t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+	t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+	t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+	idx = _mm_or_si128(t1, t3);
+
+	// Map Sextets to ASCII
+	res = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+	res = _mm_or_si128(res, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), idx), _mm_set1_epi8(13)));
+	return _mm_add_epi8(idx, _mm_shuffle_epi8(lut, res));
+}
+
+TARGET_SSE41 size_t base64_encode_sse41(const unsigned char * in, size_t len, char * out)
+{
+	size_t i;
+
+	// Each Block reads 16 Bytes but consumes 12
+	for (i = 0; i + 16 <= len; i += 12, out += 16)
+		_mm_storeu_si128((__m128i *)out, enc_sse41(_mm_loadu_si128((const __m128i *)(in + i))));
+
+	return i;
+}
+
+/* Encode 24 Bytes to 32 Characters (Input is in Bytes 0-11 of each Lane) */
+TARGET_AVX2 static __m256i enc_avx2(__m256i in)
+{
+	const __m256i shuf = _mm256_setr_epi8(
+		1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+		1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+	const __m256i lut = _mm256_setr_epi8(
+		'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+		'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+	__m256i t0, t1, t2, t3, idx, res;
+
+	in = _mm256_shuffle_epi8(in, shuf);
+	t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+	t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+	t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+	t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+	idx = _mm256_or_si256(t1, t3);
+
+	res = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+	res = _mm256_or_si256(res, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx), _mm256_set1_epi8(13)));
+	return _mm256_add_epi8(idx, _mm256_shuffle_epi8(lut, res));
+}
+
+TARGET_AVX2 size_t base64_encode_avx2(const unsigned char * in, size_t len, char * out)
+{
+	size_t i;
+
+	// Each Block reads Bytes 0-15 and 12-27 but consumes 24
+	for (i = 0; i + 28 <= len; i += 24, out += 32)
+	{
+		__m256i v = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(in + i))),
+			_mm_loadu_si128((const __m128i *)(in + i + 12)), 1);
+
+		_mm256_storeu_si256((__m256i *)out, enc_avx2(v));
+	}
+
+	return i;
+}
+
+TARGET_SSE41 size_t base64_decode_sse41(const char * in, size_t len, unsigned char * out)
+{
+	const __m128i lut_lo = _mm_setr_epi8(
+		0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+		0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m128i lut_hi = _mm_setr_epi8(
+		0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+		0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lut_roll = _mm_setr_epi8(
+		0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	const __m128i mask = _mm_set1_epi8(0x0f);
+
+	size_t i;
+
+	/*
+	 * Each Block consumes 16 Characters and writes 16 Bytes, of which 12 are
+	 * valid.  Stopping 24 Characters short of the end keeps the store inside
+	 * the output and leaves the last (possibly padded) group to the caller.
+	 */
+	for (i = 0; i + 24 <= len; i += 16, out += 12)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+		__m128i hi = _mm_and_si128(_mm_srli_epi32(v, 4), mask);
+		__m128i lo = _mm_and_si128(v, mask);
+		__m128i roll;
+
+		// Stop at the first Block with a Character outside the Alphabet
+		if (! _mm_testz_si128(_mm_shuffle_epi8(lut_lo, lo), _mm_shuffle_epi8(lut_hi, hi)))
+			break;
+
+		roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('/')), hi));
+		v = _mm_add_epi8(v, roll);
+
+		// Pack 4 Sextets into 3 Bytes
+		v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+		v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+		_mm_storeu_si128((__m128i *)out, _mm_shuffle_epi8(v, pack));
+	}
+
+	return i;
+}
+
+TARGET_AVX2 size_t base64_decode_avx2(const char * in, size_t len, unsigned char * out)
+{
+	const __m256i lut_lo = _mm256_setr_epi8(
+		0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+		0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+		0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+		0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m256i lut_hi = _mm256_setr_epi8(
+		0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+		0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+		0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+		0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m256i lut_roll = _mm256_setr_epi8(
+		0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i pack = _mm256_setr_epi8(
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	const __m256i perm = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+	const __m256i mask = _mm256_set1_epi8(0x0f);
+
+	size_t i;
+
+	// As for SSE4.1, with 32-Character Blocks writing 24 valid Bytes of 32
+	for (i = 0; i + 48 <= len; i += 32, out += 24)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i *)(in + i));
+		__m256i hi = _mm256_and_si256(_mm256_srli_epi32(v, 4), mask);
+		__m256i lo = _mm256_and_si256(v, mask);
+		__m256i roll;
+
+		if (! _mm256_testz_si256(_mm256_shuffle_epi8(lut_lo, lo), _mm256_shuffle_epi8(lut_hi, hi)))
+			break;
+
+		roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('/')), hi));
+		v = _mm256_add_epi8(v, roll);
+
+		v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+		v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+		v = _mm256_shuffle_epi8(v, pack);
+		_mm256_storeu_si256((__m256i *)out, _mm256_permutevar8x32_epi32(v, perm));
+	}
+
+	return i;
+}
+
+#endif /* BASE64_HAVE_X86 */
@@ -43,6 +43,10 @@ static const driver_interface_t libdc_driver_interface =
 	libdc_parser_reset,			// parser_reset
 	libdc_parser_parse_header,	// parser_parse_header
 	libdc_parser_parse_profile,	// parser_parse_profile
+	libdc_parser_parse_columns,	// parser_parse_columns
+	NULL,						// driver_transfer_stream
+	NULL,						// driver_open_offline
+	NULL,						// driver_transfer_rate
 };
 
 int plugin_load()
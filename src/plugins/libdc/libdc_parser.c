@@ -36,6 +36,8 @@ struct libdc_parser_
 
 	waypoint_callback_fn_t	wcb;			///< Waypoint Callback Function
 	void *					wcb_data;		///< Waypoint Callback Data
+
+	profile_columns_t *		cols;			///< Profile Column Buffers
 };
 
 void libdc_sample_cb(dc_sample_type_t type, dc_sample_value_t value, void * userdata)
@@ -100,6 +102,92 @@ void libdc_sample_cb(dc_sample_type_t type, dc_sample_value_t value, void * user
 	}
 }
 
+/*
+ * Store a Sample in the Column Buffers.  A DC_SAMPLE_TIME sample starts a new
+ * row; samples which arrive before the first time sample are discarded.
+ * Alarm events set bit (event type) in the alarm bitmask.
+ */
+void libdc_column_cb(dc_sample_type_t type, dc_sample_value_t value, void * userdata)
+{
+	libdc_parser_t parser = (libdc_parser_t)(userdata);
+	if ((parser == NULL) || (parser->cols == NULL))
+		return;
+
+	profile_columns_t * cols = parser->cols;
+	uint32_t n;
+
+	if (type == DC_SAMPLE_TIME)
+	{
+		n = cols->count++;
+		if (n >= cols->capacity)
+			return;
+
+		if (cols->time) cols->time[n] = value.time;
+		if (cols->depth) cols->depth[n] = 0;
+		if (cols->temp) cols->temp[n] = 0;
+		if (cols->pressure) cols->pressure[n] = 0;
+		if (cols->tank) cols->tank[n] = 0;
+		if (cols->rbt) cols->rbt[n] = 0;
+		if (cols->heartrate) cols->heartrate[n] = 0;
+		if (cols->bearing) cols->bearing[n] = 0;
+		if (cols->alarms) cols->alarms[n] = 0;
+		if (cols->present) cols->present[n] = 0;
+		return;
+	}
+
+	if ((cols->count == 0) || (cols->count > cols->capacity))
+		return;
+
+	n = cols->count - 1;
+	switch (type)
+	{
+	case DC_SAMPLE_DEPTH:
+		// Centimeters
+		if (cols->depth) cols->depth[n] = (uint32_t)round(value.depth * 100.0);
+		if (cols->present) cols->present[n] |= DIVE_COLUMN_DEPTH;
+		break;
+
+	case DC_SAMPLE_TEMPERATURE:
+		// Centidegrees Celsius
+		if (cols->temp) cols->temp[n] = (int32_t)round(value.temperature * 100.0);
+		if (cols->present) cols->present[n] |= DIVE_COLUMN_TEMP;
+		break;
+
+	case DC_SAMPLE_PRESSURE:
+		// Millibar
+		if (cols->pressure) cols->pressure[n] = (uint32_t)round(value.pressure.value);
+		if (cols->tank) cols->tank[n] = value.pressure.tank;
+		if (cols->present) cols->present[n] |= DIVE_COLUMN_PX;
+		break;
+
+	case DC_SAMPLE_RBT:
+		if (cols->rbt) cols->rbt[n] = value.rbt;
+		if (cols->present) cols->present[n] |= DIVE_COLUMN_RBT;
+		break;
+
+	case DC_SAMPLE_HEARTBEAT:
+		if (cols->heartrate) cols->heartrate[n] = value.heartbeat;
+		if (cols->present) cols->present[n] |= DIVE_COLUMN_HEARTRATE;
+		break;
+
+	case DC_SAMPLE_BEARING:
+		if (cols->bearing) cols->bearing[n] = value.bearing;
+		if (cols->present) cols->present[n] |= DIVE_COLUMN_BEARING;
+		break;
+
+	case DC_SAMPLE_EVENT:
+		if (value.event.type < 32)
+		{
+			if (cols->alarms) cols->alarms[n] |= (1u << value.event.type);
+			if (cols->present) cols->present[n] |= DIVE_COLUMN_ALARMS;
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
 int libdc_parser_create(parser_handle_t * abstract, dev_handle_t abstract_dev)
 {
 	libdc_parser_t * parser = (libdc_parser_t *)(abstract);
@@ -117,6 +205,9 @@ int libdc_parser_create(parser_handle_t * abstract, dev_handle_t abstract_dev)
 
 	p->dev = dev;
 	p->parser = NULL;
+	p->wcb = NULL;
+	p->wcb_data = NULL;
+	p->cols = NULL;
 
 	dc_status_t rc = dc_parser_new(& p->parser, p->dev->device);
 	if (rc != DC_STATUS_SUCCESS)
@@ -279,3 +370,42 @@ int libdc_parser_parse_profile(parser_handle_t abstract, const void * buffer, ui
 
 	return 0;
 }
+
+int libdc_parser_parse_columns(parser_handle_t abstract, const void * buffer, uint32_t size, profile_columns_t * cols)
+{
+	libdc_parser_t parser = (libdc_parser_t)(abstract);
+	if ((parser == NULL) || (cols == NULL))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	dc_status_t rc = dc_parser_set_data(parser->parser, buffer, size);
+	if (rc != DC_STATUS_SUCCESS)
+	{
+		parser->dev->errcode = DRIVER_ERR_PARSER;
+		parser->dev->errmsg = "Failed to set parser data";
+		return -1;
+	}
+
+	cols->count = 0;
+	parser->cols = cols;
+	rc = dc_parser_samples_foreach(parser->parser, libdc_column_cb, parser);
+	parser->cols = NULL;
+
+	if (rc != DC_STATUS_SUCCESS)
+	{
+		parser->dev->errcode = DRIVER_ERR_PARSER;
+		parser->dev->errmsg = "Failed to parse profile data";
+		return -1;
+	}
+
+	if (cols->count > cols->capacity)
+	{
+		parser->dev->errcode = DRIVER_ERR_INVALID;
+		parser->dev->errmsg = "Profile column buffers are too small";
+		return -1;
+	}
+
+	return 0;
+}
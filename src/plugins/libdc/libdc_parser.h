@@ -40,6 +40,7 @@ int libdc_parser_reset(parser_handle_t parser);
 
 int libdc_parser_parse_header(parser_handle_t parser, const void * buffer, uint32_t size, header_callback_fn_t cb, void * userdata);
 int libdc_parser_parse_profile(parser_handle_t parser, const void * buffer, uint32_t size, waypoint_callback_fn_t cb, void * userdata);
+int libdc_parser_parse_columns(parser_handle_t parser, const void * buffer, uint32_t size, profile_columns_t * cols);
 
 #ifdef __cplusplus
 }
@@ -45,6 +45,10 @@ static const driver_interface_t smart_driver_interface =
 	smart_parser_reset,			// parser_reset
 	smart_parser_parse_header,	// parser_parse_header
 	smart_parser_parse_profile,	// parser_parse_profile
+	smart_parser_parse_columns,	// parser_parse_columns
+	smart_driver_transfer_stream,	// driver_transfer_stream
+	smart_driver_open_offline,	// driver_open_offline
+	smart_driver_transfer_rate,	// driver_transfer_rate
 };
 
 int plugin_load()
@@ -33,6 +33,12 @@
 #include "smart_driver.h"
 #include "smart_io.h"
 
+/*
+ * Largest read size the adaptive read size may grow to by default.  Reads
+ * return at most one IrLAP frame, which carries up to 2048 bytes.
+ */
+#define SMART_CHUNK_MAX			256
+
 void smart_driver_discover_cb(unsigned int address, const char * name, unsigned int charset, unsigned int hints, void * userdata)
 {
 	smart_device_t dev = (smart_device_t)(userdata);
@@ -146,6 +152,9 @@ int smart_driver_create(dev_handle_t * abstract)
 	sd->epname = 0;
 	sd->lsap = 1;
 	sd->csize = 4;
+	sd->cmax = SMART_CHUNK_MAX;
+	memset(& sd->chunk, 0, sizeof(irda_chunk_t));
+	sd->xfer_timeout = -1;
 
 	/* Return New Device */
 	* dev = sd;
@@ -161,8 +170,10 @@ int smart_driver_open(dev_handle_t abstract, const char * devpath, const char *
 	smart_device_t dev = (smart_device_t)(abstract);
 
 	uint32_t chunk_size = 8;
+	uint32_t chunk_max = SMART_CHUNK_MAX;
 	uint32_t lsap = 1;
 	int32_t irda_timeout = 2000;
+	int32_t xfer_timeout = -1;
 
 	/* Check Magic Number */
 	if (! CHECK_DEV(dev))
@@ -186,19 +197,33 @@ int smart_driver_open(dev_handle_t abstract, const char * devpath, const char *
 	if (rc != 0)
 		chunk_size = 8;
 
+	rc = arglist_read_uint(arglist, "chunk_max", & chunk_max);
+	if (rc != 0)
+		chunk_max = SMART_CHUNK_MAX;
+
 	rc = arglist_read_uint(arglist, "lsap", & lsap);
 	if (rc != 0)
 		lsap = 1;
 
+	rc = arglist_read_int(arglist, "xfer_timeout", & xfer_timeout);
+	if (rc != 0)
+		xfer_timeout = -1;
+
 	arglist_close(arglist);
 
 	if (chunk_size < 2)
 		chunk_size = 2;
 	if (chunk_size > 32)
 		chunk_size = 32;
+	if (chunk_max < chunk_size)
+		chunk_max = chunk_size;
+	if (chunk_max > 2048)
+		chunk_max = 2048;
 
 	dev->lsap = lsap;
 	dev->csize = chunk_size;
+	dev->cmax = chunk_max;
+	dev->xfer_timeout = xfer_timeout;
 
 	// Open IrDA Socket
 	rc = irda_socket_open(& dev->s);
@@ -298,6 +323,30 @@ int smart_driver_open(dev_handle_t abstract, const char * devpath, const char *
 	return DRIVER_ERR_SUCCESS;
 }
 
+int smart_driver_open_offline(dev_handle_t abstract, uint8_t model, uint32_t serial, uint32_t ticks, time_t xfer_time)
+{
+	smart_device_t dev = (smart_device_t)(abstract);
+
+	/* Check Magic Number */
+	if (! CHECK_DEV(dev))
+	{
+		errno = EINVAL;
+		return DRIVER_ERR_INVALID;
+	}
+
+	/* Load the Device Information from the Saved Transfer */
+	dev->base.model = model;
+	dev->base.serial = serial;
+	dev->base.ticks = ticks;
+
+	/* Calculate Time Correction as of the Transfer */
+	dev->base.epoch = smart_driver_epoch();
+	dev->base.tcorr = xfer_time * 2 - dev->base.ticks;
+
+	/* Success */
+	return DRIVER_ERR_SUCCESS;
+}
+
 void smart_driver_close(dev_handle_t abstract)
 {
 	smart_device_t dev = (smart_device_t)(abstract);
@@ -310,6 +359,8 @@ void smart_driver_close(dev_handle_t abstract)
 	if (dev->s != NULL)
 		irda_socket_close(dev->s);
 
+	dev->s = NULL;
+
 	/* Free Endpoint Name String */
 	if (dev->epname)
 	{
@@ -392,7 +443,7 @@ int smart_driver_get_serial(dev_handle_t abstract, uint32_t * outval)
 	return DRIVER_ERR_SUCCESS;
 }
 
-int smart_driver_transfer(dev_handle_t abstract, void ** buffer, uint32_t * size, device_callback_fn_t dcb, transfer_callback_fn_t pcb, void * userdata)
+static int smart_driver_read_memory(dev_handle_t abstract, void ** buffer, uint32_t * size, device_callback_fn_t dcb, transfer_callback_fn_t pcb, divedata_callback_fn_t cb, void * userdata)
 {
 	smart_device_t dev = (smart_device_t)(abstract);
 
@@ -444,6 +495,12 @@ int smart_driver_transfer(dev_handle_t abstract, void ** buffer, uint32_t * size
 	if (* size == 0)
 		return 0;
 
+	// Bound the Whole Transfer as well as each Read
+	if (dev->xfer_timeout >= 0)
+		irda_socket_set_deadline(dev->s, dev->xfer_timeout);
+	else
+		irda_socket_set_budget(dev->s, * size);
+
 	// Allocate the Data Buffer
 	(* buffer) = malloc(* size);
 	if (* buffer == NULL)
@@ -458,6 +515,7 @@ int smart_driver_transfer(dev_handle_t abstract, void ** buffer, uint32_t * size
 	uint32_t len = (* size);
 	uint32_t nb;
 	uint32_t pos;
+	smart_extractor_t ex = NULL;
 
 	* (uint32_t *)(& cmd2[1]) = token;
 
@@ -476,6 +534,9 @@ int smart_driver_transfer(dev_handle_t abstract, void ** buffer, uint32_t * size
 		return DRIVER_ERR_INTERNAL;
 	}
 
+	// Adapt the Read Size from chunk_size up to chunk_max, or Keep it Fixed
+	irda_chunk_init(& dev->chunk, (dev->cmax > dev->csize) ? 2 : dev->csize, dev->cmax, dev->csize);
+
 	// Start Transfer
 	if (pcb != NULL)
 		pcb(userdata, 0, (* size), & cancel);
@@ -486,29 +547,41 @@ int smart_driver_transfer(dev_handle_t abstract, void ** buffer, uint32_t * size
 		return DRIVER_ERR_CANCELLED;
 	}
 
+	// Stream Dives out of the Buffer as it Fills
+	if ((cb != NULL) && (smart_extractor_create(& ex, cb, userdata, SMART_EXTRACT_CONTIGUOUS) != 0))
+	{
+		smart_device_set_error(dev->base, ENOMEM, "Unable to allocate dive extractor", 0);
+		return DRIVER_ERR_INTERNAL;
+	}
+
 	pos = 0;
 	while (len > 0)
 	{
-		size_t nt;
-
-		if (len > dev->csize)
-			nt = dev->csize;
-		else
-			nt = len;
+		size_t nt = len;
 
-		rc = irda_socket_read(dev->s, & ((unsigned char *)(* buffer))[pos], & nt, & timeout);
+		rc = irda_chunk_read(& dev->chunk, dev->s, & ((unsigned char *)(* buffer))[pos], & nt, & timeout);
 		if (rc != 0)
 		{
+			smart_extractor_close(ex);
 			smart_device_set_error(dev->base, DRIVER_ERR_READ, "Failed to read bytes from the Uwatec Smart device", 0);
 			return DRIVER_ERR_READ;
 		}
 
 		if (timeout)
 		{
+			smart_extractor_close(ex);
 			smart_device_set_error(dev->base, DRIVER_ERR_TIMEOUT, "Timed out reading data from the Uwatec Smart device", 0);
 			return DRIVER_ERR_TIMEOUT;
 		}
 
+		// Stream Dives which have been Completely Received
+		if ((ex != NULL) && (smart_extractor_feed(ex, & ((unsigned char *)(* buffer))[pos], nt) != EXTRACT_SUCCESS))
+		{
+			smart_extractor_close(ex);
+			smart_device_set_error(dev->base, DRIVER_ERR_READ, "Invalid or Corrupt Data", 0);
+			return DRIVER_ERR_READ;
+		}
+
 		len -= nt;
 		pos += nt;
 
@@ -517,15 +590,67 @@ int smart_driver_transfer(dev_handle_t abstract, void ** buffer, uint32_t * size
 
 		if (cancel)
 		{
+			smart_extractor_close(ex);
 			smart_device_set_error(dev->base, DRIVER_ERR_CANCELLED, "Operation was cancelled by the user", 0);
 			return DRIVER_ERR_CANCELLED;
 		}
 	}
 
+	// Check for a Partial Dive at the End of the Stream
+	rc = (ex != NULL) ? smart_extractor_finish(ex) : EXTRACT_SUCCESS;
+	smart_extractor_close(ex);
+
+	if (rc != EXTRACT_SUCCESS)
+	{
+		smart_device_set_error(dev->base, DRIVER_ERR_READ, "Dive extends past end of Buffer", 0);
+		return DRIVER_ERR_READ;
+	}
+
 	// Transfer Succeeded
 	return 0;
 }
 
+static int smart_driver_do_transfer(dev_handle_t abstract, void ** buffer, uint32_t * size, device_callback_fn_t dcb, transfer_callback_fn_t pcb, divedata_callback_fn_t cb, void * userdata)
+{
+	smart_device_t dev = (smart_device_t)(abstract);
+	int rc;
+
+	rc = smart_driver_read_memory(abstract, buffer, size, dcb, pcb, cb, userdata);
+
+	/* Lift the Transfer Deadline from later Commands */
+	if (CHECK_DEV(dev) && (dev->s != NULL))
+		irda_socket_set_deadline(dev->s, 0);
+
+	return rc;
+}
+
+int smart_driver_transfer(dev_handle_t abstract, void ** buffer, uint32_t * size, device_callback_fn_t dcb, transfer_callback_fn_t pcb, void * userdata)
+{
+	return smart_driver_do_transfer(abstract, buffer, size, dcb, pcb, NULL, userdata);
+}
+
+int smart_driver_transfer_stream(dev_handle_t abstract, void ** buffer, uint32_t * size, device_callback_fn_t dcb, transfer_callback_fn_t pcb, divedata_callback_fn_t cb, void * userdata)
+{
+	return smart_driver_do_transfer(abstract, buffer, size, dcb, pcb, cb, userdata);
+}
+
+int smart_driver_transfer_rate(dev_handle_t abstract, uint32_t * rate, uint32_t * chunk)
+{
+	smart_device_t dev = (smart_device_t)(abstract);
+
+	/* Check Magic Number */
+	if (! CHECK_DEV(dev) || ! rate || ! chunk)
+	{
+		errno = EINVAL;
+		return DRIVER_ERR_INVALID;
+	}
+
+	* rate = dev->chunk.rate;
+	* chunk = dev->chunk.size;
+
+	return DRIVER_ERR_SUCCESS;
+}
+
 int smart_driver_extract(dev_handle_t abstract, void * buffer, uint32_t size, divedata_callback_fn_t cb, void * userdata)
 {
 	int rc;
@@ -46,6 +46,7 @@ extern "C" {
 #include <stdint.h>
 
 #include <common-irda/irda.h>
+#include <common-irda/irda_chunk.h>
 #include <common-smart/smart_device_base.h>
 
 #include <benthos/divecomputer/plugin/driver.h>
@@ -68,6 +69,9 @@ struct smart_device_
 
 	int							lsap;		///< IrDA LSAP Identifier
 	unsigned int				csize;		///< IrDA ChunK Size
+	unsigned int				cmax;		///< Largest IrDA Chunk Size
+	irda_chunk_t				chunk;		///< Adaptive IrDA Read Size
+	int32_t						xfer_timeout;	///< Transfer Time Limit (ms, < 0 for Automatic)
 
 };
 
@@ -82,6 +86,7 @@ typedef struct smart_device_ *		smart_device_t;
  */
 int smart_driver_create(dev_handle_t * dev);
 int smart_driver_open(dev_handle_t dev, const char *, const char * args);
+int smart_driver_open_offline(dev_handle_t dev, uint8_t model, uint32_t serial, uint32_t ticks, time_t xfer_time);
 void smart_driver_close(dev_handle_t dev);
 void smart_driver_shutdown(dev_handle_t dev);
 const char * smart_driver_name(dev_handle_t dev);
@@ -92,7 +97,9 @@ int smart_driver_get_model(dev_handle_t dev, uint8_t * outval);
 int smart_driver_get_serial(dev_handle_t dev, uint32_t * outval);
 
 int smart_driver_transfer(dev_handle_t dev, void ** buffer, uint32_t * size, device_callback_fn_t dcb, transfer_callback_fn_t pcb, void * userdata);
+int smart_driver_transfer_stream(dev_handle_t dev, void ** buffer, uint32_t * size, device_callback_fn_t dcb, transfer_callback_fn_t pcb, divedata_callback_fn_t cb, void * userdata);
 int smart_driver_extract(dev_handle_t dev, void * buffer, uint32_t size, divedata_callback_fn_t cb, void * userdata);
+int smart_driver_transfer_rate(dev_handle_t dev, uint32_t * rate, uint32_t * chunk);
 /*@}*/
 
 #ifdef __cplusplus
@@ -45,6 +45,10 @@ static const driver_interface_t smarti_driver_interface =
 	smart_parser_reset,			// parser_reset
 	smart_parser_parse_header,	// parser_parse_header
 	smart_parser_parse_profile,	// parser_parse_profile
+	smart_parser_parse_columns,	// parser_parse_columns
+	smarti_driver_transfer_stream,	// driver_transfer_stream
+	smarti_driver_open_offline,	// driver_open_offline
+	smarti_driver_transfer_rate,	// driver_transfer_rate
 };
 
 int plugin_load()
@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -40,19 +41,48 @@
 
 #include <regex.h>
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #include <benthos/divecomputer/base64.h>
 #include <benthos/smarti/smarti_codes.h>
 
 #include "smarti_client.h"
 
+//! Size of the per-Client Receive Buffer
+#define SMARTIC_RBUF_SIZE	16384
+
+/*
+ * Timeout for the OPEN Response (ms).  The server holds OPEN until the IrDA
+ * adapter is free, which can take as long as another client's transfer.
+ */
+#define SMARTIC_OPEN_TIMEOUT	600000
+
+/**@{
+ * @name Server Capabilities
+ */
+#define SMARTIC_CAP_BINARY	0x01	///< Binary Transfer Frames
+#define SMARTIC_CAP_DEFLATE	0x02	///< Deflate Compressed Frames
+/*@}*/
+
 struct smarti_client_t_
 {
 	int				s;			///< Network Socket File Descriptor
 	long			timeout;	///< Network Socket Timeout (ms)
 
+	char			rbuf[SMARTIC_RBUF_SIZE];	///< Receive Buffer
+	size_t			rpos;		///< Receive Buffer Read Position
+	size_t			rlen;		///< Receive Buffer Fill Level
+
 	char *			s_id;		///< Smart-I Server Name String
 	char *			s_addr;		///< Smart-I Server Address
 	uint16_t		s_port;		///< Smart-I Server Port
+	unsigned int	caps;		///< Server Capabilities
+	int				binary;		///< Server Sends Binary Transfer Data
+
+	smarti_data_cb_t	xfer_cb;	///< Transfer Data Callback
+	void *			xfer_data;	///< Transfer Data Callback User Data
 
 	int				errcode;	///< Error Code
 	const char *	errmsg;		///< Error Message
@@ -91,6 +121,18 @@ void * get_in_addr(struct sockaddr * sa)
     return & (((struct sockaddr_in6 *)sa)->sin6_addr);
 }
 
+/*
+ * Helper to return monotonic time in milliseconds.  Deadlines must not use
+ * clock(), which counts processor time and so barely advances while blocked
+ * in select().
+ */
+static long smartic_ms_time(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, & t);
+	return (long)t.tv_sec * 1000 + t.tv_nsec / 1000000;
+}
+
 /* Helper to call select() on the client socket with timeout */
 int smartic_socket_select(int fd, int writing, long interval)
 {
@@ -98,6 +140,10 @@ int smartic_socket_select(int fd, int writing, long interval)
 	fd_set fds;
 	struct timeval tv;
 
+	/* Deadline has Passed */
+	if (interval < 0)
+		return 1;
+
 	tv.tv_sec = interval / 1000;
 	tv.tv_usec = (interval % 1000) * 1000;
 
@@ -123,7 +169,7 @@ int smartic_socket_select(int fd, int writing, long interval)
 		long deadline, interval = s->timeout; \
 		int has_timeout = (s->timeout > 0); \
 		if (has_timeout) \
-			deadline = (clock() * 1000 / CLOCKS_PER_SEC) + s->timeout; \
+			deadline = smartic_ms_time() + s->timeout; \
 		while (1) { \
 			errno = 0;
 
@@ -131,7 +177,7 @@ int smartic_socket_select(int fd, int writing, long interval)
 #define END_SELECT_LOOP(s) \
 			if (! has_timeout || (! (errno == EWOULDBLOCK) && ! (errno == EAGAIN))) \
 				break; \
-			interval = deadline - (clock() * 1000 / CLOCKS_PER_SEC); \
+			interval = deadline - smartic_ms_time(); \
 		} \
 	}
 
@@ -146,97 +192,157 @@ int smartic_socket_available(smarti_client_t c)
 	if (ioctl(c->s, FIONREAD, & bytes) != 0)
 		return -1;
 
-	return bytes;
+	return bytes + (int)(c->rlen - c->rpos);
 }
 
-/* Helper to read a line from the server */
-ssize_t smartic_socket_readln(smarti_client_t c, char * buffer, size_t len, int * timeoutp)
+/*
+ * Helper to wait for data and receive as much as is available into a buffer,
+ * up to len bytes.  Returns the number of bytes received, 0 on end of file or
+ * timeout (in which case timeoutp is set), or -1 on error.
+ */
+static ssize_t smartic_socket_recv(smarti_client_t c, char * buffer, size_t len, int * timeoutp)
 {
-	ssize_t nr;
-	size_t tot;
+	ssize_t nr = -1;
 	int timeout;
-	char * buf;
-	char ch;
-
-	if (! IS_SELECTABLE(c->s) || ! buffer || (len <= 0))
-	{
-		errno = EINVAL;
-		return -1;
-	}
 
-	buf = buffer;
-	tot = 0;
 	for (;;)
 	{
 		BEGIN_SELECT_LOOP(c);
 			timeout = smartic_socket_select(c->s, 0, interval);
 			if (! timeout)
-				nr = read(c->s, & ch, 1);
+				nr = recv(c->s, buffer, len, 0);
 
 			if (timeout == 1)
 			{
-				if (timeoutp) * timeoutp = 1;
+				* timeoutp = 1;
 				break;
 			}
 		END_SELECT_LOOP(c);
 
-		if (timeout)
-		{
-			if (tot == 0)
-			{
-				/* No bytes read */
-				return 0;
-			}
-			else
-			{
-				/* Add NUL and return */
-				break;
-			}
-		}
+		if (timeout == 1)
+			return 0;
 
-		if (nr == -1)
+		if ((timeout == -1) || (nr == -1))
 		{
 			if (errno == EINTR)
 			{
-				/* Interrupted -> Restart read() */
+				/* Interrupted -> Restart select() */
 				continue;
 			}
-			else
-			{
-				/* Some other error */
-				return -1;
-			}
+
+			return -1;
 		}
-		else if (nr == 0)
+
+		return nr;
+	}
+}
+
+/* Helper to read a line from the server */
+ssize_t smartic_socket_readln(smarti_client_t c, char * buffer, size_t len, int * timeoutp)
+{
+	ssize_t nr;
+	size_t tot;
+	size_t n;
+	size_t ncopy;
+	int timeout = 0;
+	char * eol;
+
+	if (! IS_SELECTABLE(c->s) || ! buffer || (len <= 0))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	tot = 0;
+	for (;;)
+	{
+		/* Refill the Receive Buffer once it has been Consumed */
+		if (c->rpos == c->rlen)
 		{
-			/* End of File */
-			if (tot == 0)
-			{
-				/* No bytes read */
-				return 0;
-			}
-			else
+			c->rpos = 0;
+			c->rlen = 0;
+
+			nr = smartic_socket_recv(c, c->rbuf, SMARTIC_RBUF_SIZE, & timeout);
+			if (nr == -1)
+				return -1;
+
+			if (nr == 0)
 			{
-				/* Add NUL and return */
+				/* Timeout or End of File: return what has been read */
+				if (timeout && timeoutp)
+					* timeoutp = 1;
 				break;
 			}
+
+			c->rlen = nr;
 		}
-		else
-		{
-			/* Skip Newline */
-			if (ch == '\n')
-				break;
 
-			/* Append the Character */
-			if (tot < (len - 1))
-			{
-				++tot;
-				*buf++ = ch;
-			}
+		/* Take everything up to the Newline (or the whole Buffer) */
+		eol = (char *)memchr(c->rbuf + c->rpos, '\n', c->rlen - c->rpos);
+		n = eol ? (size_t)(eol - (c->rbuf + c->rpos)) : c->rlen - c->rpos;
+
+		/* Append the Characters, dropping any that do not fit */
+		ncopy = (n < len - 1 - tot) ? n : len - 1 - tot;
+		memcpy(buffer + tot, c->rbuf + c->rpos, ncopy);
+		tot += ncopy;
+
+		c->rpos += n;
+
+		/* Skip Newline */
+		if (eol)
+		{
+			c->rpos++;
+			break;
 		}
 	}
 
-	* buf = 0;
+	buffer[tot] = 0;
+
+	return tot;
+}
+
+/*
+ * Helper to read exactly len bytes from the server.  Buffered data is used
+ * first and the remainder is received directly into the caller's buffer.
+ * Returns the number of bytes read, which is less than len only on timeout
+ * (timeoutp is set) or end of file, or -1 on error.
+ */
+static ssize_t smartic_socket_read(smarti_client_t c, char * buffer, size_t len, int * timeoutp)
+{
+	ssize_t nr;
+	size_t tot;
+	int timeout = 0;
+
+	if (! IS_SELECTABLE(c->s) || (! buffer && len))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* Drain the Receive Buffer */
+	tot = c->rlen - c->rpos;
+	if (tot > len)
+		tot = len;
+
+	memcpy(buffer, c->rbuf + c->rpos, tot);
+	c->rpos += tot;
+
+	/* Receive the Rest in Bulk */
+	while (tot < len)
+	{
+		nr = smartic_socket_recv(c, buffer + tot, len - tot, & timeout);
+		if (nr == -1)
+			return -1;
+
+		if (nr == 0)
+		{
+			if (timeout && timeoutp)
+				* timeoutp = 1;
+			break;
+		}
+
+		tot += nr;
+	}
 
 	return tot;
 }
@@ -341,27 +447,35 @@ int smartic_parse_response(const char * line, int * code, const char ** message)
 /**
  * @brief Parse the Greeting Message
  * @param[in] Greeting Line
- * @param[out] Status Code
  * @param[out] Server ID String
+ * @param[out] Server Version String
  * @param[out] Extra Message
+ * @param[out] Server Capabilities
  * @return Zero on Success, Non-Zero on Failure
  *
  * Parses the greeting string from the server, which is defined to be formatted
  * <SERVER_ID> <VER_MAJ>.<VER_MIN>[.<VER_PATCH>[_<VER_REL>]] <EXTRA>
  *
  * So a valid server greeting string would look like
- * Smart-I Daemon 1.0.5 Ready
+ * Smart-I Daemon 1.0.5 Ready [binary deflate]
  *
  * which parses into
  * - NAME: Smart-I Daemon
  * - VERS: 1.0.5
- * - EXTRA: Ready
+ * - EXTRA: Ready [binary deflate]
+ *
+ * The extra message may end with a bracketed, space-separated list of server
+ * capabilities, which are returned as SMARTIC_CAP_ flags.  Unknown names are
+ * ignored, and servers which do not list any have no capabilities.
  */
-int smartic_parse_greeting(const char * line, char ** name, char ** version, char ** extra)
+int smartic_parse_greeting(const char * line, char ** name, char ** version, char ** extra, unsigned int * caps)
 {
 	int rv;
 	regex_t re;
 	regmatch_t m[12];
+	const char * p;
+	const char * end;
+	size_t n;
 
 	rv = regcomp(& re, "(.*) (([0-9]+)\\.([0-9]+)(\\.([0-9])(_([A-Za-z0-9]*))?)?) (.*)", REG_EXTENDED);
 	if (rv != 0)
@@ -381,7 +495,29 @@ int smartic_parse_greeting(const char * line, char ** name, char ** version, cha
 	}
 
 	regfree(& re);
-	return rv;
+	if (rv != 0)
+		return rv;
+
+	/* Parse the Capability List */
+	* caps = 0;
+
+	p = strchr(* extra, '[');
+	end = p ? strchr(p, ']') : 0;
+	if (! end)
+		return 0;
+
+	for (++p; p < end; p += n)
+	{
+		p += strspn(p, " ");
+		n = strcspn(p, " ]");
+
+		if ((n == strlen(SMARTI_CAP_BINARY)) && (strncasecmp(p, SMARTI_CAP_BINARY, n) == 0))
+			* caps |= SMARTIC_CAP_BINARY;
+		else if ((n == strlen(SMARTI_CAP_DEFLATE)) && (strncasecmp(p, SMARTI_CAP_DEFLATE, n) == 0))
+			* caps |= SMARTIC_CAP_DEFLATE;
+	}
+
+	return 0;
 }
 
 /**
@@ -467,6 +603,138 @@ int smartic_parse_devinfo(const char * line, char ** info)
 	return rv;
 }
 
+/* Read and Parse one Response Line */
+static int smartic_read_response(smarti_client_t c, char * r_line, int * r_code, const char ** r_msg)
+{
+	int rv;
+	int timeout = 0;
+
+	/* Read Response Line */
+	rv = smartic_socket_readln(c, r_line, 1024, & timeout);
+	if (rv == -1)
+	{
+		SET_ERROR(c, errno, strerror(errno))
+		return -1;
+	}
+
+	if (timeout)
+	{
+		SET_ERROR(c, ETIMEDOUT, "Timed Out")
+		return -1;
+	}
+
+	/* Parse Line */
+	rv = smartic_parse_response(r_line, r_code, r_msg);
+	if (rv != 0)
+	{
+		if (rv == 1)
+		{
+			SET_ERROR(c, errno, strerror(errno))
+		}
+		else if (rv == 2)
+		{
+			SET_ERROR(c, EINVAL, "Invalid response string received")
+		}
+		else
+		{
+			SET_ERROR(c, rv, * r_msg)
+		}
+
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Read the Response to one Command of a Pipelined Batch.  Returns -1 if the
+ * connection failed, 1 if the server returned an unexpected status and 0 on
+ * success, in which case the value of an Info response is stored in value.
+ * A server error is only recorded if no earlier command in the batch failed,
+ * so that the error reported is the one which caused the rest to fail.
+ */
+static int smartic_read_status(smarti_client_t c, int expect, uint32_t * value, int failed)
+{
+	int rv;
+	char r_line[1024];
+	int r_code;
+	const char * r_msg;
+	char * r_info;
+
+	rv = smartic_read_response(c, r_line, & r_code, & r_msg);
+	if (rv != 0)
+		return -1;
+
+	if (r_code != expect)
+	{
+		if (! failed)
+		{
+			snprintf(g_server_error, 1024, "%d %s", r_code, r_msg);
+			SET_ERROR(c, r_code, g_server_error)
+		}
+
+		return 1;
+	}
+
+	if (expect != SMARTI_STATUS_INFO)
+		return 0;
+
+	/* Parse Response */
+	rv = smartic_parse_devinfo(r_msg, & r_info);
+	if (rv != 0)
+	{
+		SET_ERROR(c, EINVAL, "Invalid response string received")
+		return -1;
+	}
+
+	* value = strtoul(r_info, 0, 10);
+	free(r_info);
+
+	return 0;
+}
+
+/*
+ * Send a Batch of Commands in one Write and Read their Responses in Order.
+ * Every response is read even after a failure so that the connection stays
+ * in step with the server.
+ */
+static int smartic_pipeline(smarti_client_t c, const char * cmds, int n, const int * expect, uint32_t * values)
+{
+	int rv;
+	int i;
+	int failed = 0;
+	int timeout = 0;
+	size_t len = strlen(cmds);
+
+	/* Send the Commands */
+	rv = smartic_socket_write(c, cmds, & len, & timeout);
+	if ((rv != 0) || timeout)
+	{
+		if (timeout)
+		{
+			SET_ERROR(c, ETIMEDOUT, "Timed Out")
+		}
+		else
+		{
+			SET_ERROR(c, errno, strerror(errno))
+		}
+
+		return -1;
+	}
+
+	/* Read the Responses */
+	for (i = 0; i < n; ++i)
+	{
+		rv = smartic_read_status(c, expect[i], & values[i], failed);
+		if (rv < 0)
+			return -1;
+
+		failed |= rv;
+	}
+
+	return failed ? -1 : 0;
+}
+
 int smarti_client_alloc(smarti_client_t * c)
 {
 	smarti_client_t ret;
@@ -480,9 +748,17 @@ int smarti_client_alloc(smarti_client_t * c)
 	ret->s = -1;
 	ret->timeout = 2000;
 
+	ret->rpos = 0;
+	ret->rlen = 0;
+
 	ret->s_id = 0;
 	ret->s_addr = 0;
 	ret->s_port = 0;
+	ret->caps = 0;
+	ret->binary = 0;
+
+	ret->xfer_cb = 0;
+	ret->xfer_data = 0;
 
 	ret->errcode = 0;
 	ret->errmsg = 0;
@@ -558,39 +834,100 @@ int smarti_client_close(smarti_client_t c)
 	return 0;
 }
 
-int smarti_client_connect(smarti_client_t c, const char * addr, uint16_t port)
+/*
+ * Ask the Server for Binary Transfer Data, compressed if both ends support
+ * it.  Servers which do not advertise binary transfers in their greeting keep
+ * sending Base 64 and are not asked.
+ */
+static int smartic_negotiate(smarti_client_t c)
 {
 	int rv;
-	int fd = -1;
-	int delay_flag;
 	int timeout = 0;
-	char port_str[10];
-	char addr_str[INET6_ADDRSTRLEN];
-	char g_line[1024];
-	struct addrinfo hints;
-	struct addrinfo * servinfo;
-	struct addrinfo * it;
-	int g_code;
-	const char * g_msg;
-	char sv_id[1024];
-	char * sv_name;
-	char * sv_ver;
-	char * sv_extra;
+	char r_line[1024];
+	int r_code;
+	const char * r_msg;
 
-	CHECK_CLIENT_PTR(c)
+	const char * cmd = "OPTION BINARY\n";
+	size_t len;
 
-	/* Set the Port String */
-	snprintf(port_str, 10, "%hu", port);
+	c->binary = 0;
 
-	/* Retrieve Server Address Info */
-	memset(& hints, 0, sizeof(struct addrinfo));
-	hints.ai_family = AF_UNSPEC;
-	hints.ai_socktype = SOCK_STREAM;
+	if (! (c->caps & SMARTIC_CAP_BINARY))
+		return 0;
 
-	if ((rv = getaddrinfo(addr, port_str, & hints, & servinfo)) != 0)
-	{
-		SET_ERROR(c, rv, gai_strerror(rv))
-		return -1;
+#ifdef HAVE_ZLIB
+	if (c->caps & SMARTIC_CAP_DEFLATE)
+		cmd = "OPTION BINARY " SMARTI_CAP_DEFLATE "\n";
+#endif
+
+	len = strlen(cmd);
+
+	/* Send OPTION Command */
+	rv = smartic_socket_write(c, cmd, & len, & timeout);
+	if (rv != 0)
+	{
+		SET_ERROR(c, errno, strerror(errno))
+		return -1;
+	}
+
+	/* Read Response Line */
+	rv = smartic_socket_readln(c, r_line, 1024, & timeout);
+	if (rv == -1)
+	{
+		SET_ERROR(c, errno, strerror(errno))
+		return -1;
+	}
+
+	if (timeout)
+	{
+		SET_ERROR(c, ETIMEDOUT, "Timed Out")
+		return -1;
+	}
+
+	if (smartic_parse_response(r_line, & r_code, & r_msg) != 0)
+	{
+		SET_ERROR(c, EINVAL, "Invalid response string received")
+		return -1;
+	}
+
+	c->binary = (r_code == SMARTI_STATUS_SUCCESS);
+
+	return 0;
+}
+
+int smarti_client_connect(smarti_client_t c, const char * addr, uint16_t port)
+{
+	int rv;
+	int fd = -1;
+	int delay_flag;
+	int timeout = 0;
+	char port_str[10];
+	char addr_str[INET6_ADDRSTRLEN];
+	char g_line[1024];
+	struct addrinfo hints;
+	struct addrinfo * servinfo;
+	struct addrinfo * it;
+	int g_code;
+	const char * g_msg;
+	char sv_id[1024];
+	char * sv_name;
+	char * sv_ver;
+	char * sv_extra;
+
+	CHECK_CLIENT_PTR(c)
+
+	/* Set the Port String */
+	snprintf(port_str, 10, "%hu", port);
+
+	/* Retrieve Server Address Info */
+	memset(& hints, 0, sizeof(struct addrinfo));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	if ((rv = getaddrinfo(addr, port_str, & hints, & servinfo)) != 0)
+	{
+		SET_ERROR(c, rv, gai_strerror(rv))
+		return -1;
 	}
 
 	/* Connect to First Available Address */
@@ -619,6 +956,8 @@ int smarti_client_connect(smarti_client_t c, const char * addr, uint16_t port)
 
 	c->s = fd;
 	c->timeout = 2000;
+	c->rpos = 0;
+	c->rlen = 0;
 	c->s_addr = strdup(addr_str);
 	c->s_port = port;
 
@@ -675,7 +1014,7 @@ int smarti_client_connect(smarti_client_t c, const char * addr, uint16_t port)
 	}
 
 	/* Parse the Greeting Message */
-	rv = smartic_parse_greeting(g_msg, & sv_name, & sv_ver, & sv_extra);
+	rv = smartic_parse_greeting(g_msg, & sv_name, & sv_ver, & sv_extra, & c->caps);
 	if (rv != 0)
 	{
 		SET_ERROR(c, EINVAL, "Invalid greeting string received")
@@ -690,6 +1029,13 @@ int smarti_client_connect(smarti_client_t c, const char * addr, uint16_t port)
 	free(sv_ver);
 	free(sv_extra);
 
+	/* Request Binary (and Compressed) Transfers */
+	if (smartic_negotiate(c) != 0)
+	{
+		smarti_client_disconnect(c);
+		return -1;
+	}
+
 	/* Successfully Connected */
 	return 0;
 }
@@ -712,6 +1058,11 @@ int smarti_client_disconnect(smarti_client_t c)
 	c->s_id = 0;
 	c->s_addr = 0;
 	c->s_port = 0;
+	c->caps = 0;
+	c->binary = 0;
+
+	c->rpos = 0;
+	c->rlen = 0;
 
 	return rv;
 }
@@ -984,6 +1335,8 @@ int smarti_client_open(smarti_client_t c, uint32_t addr, uint32_t lsap, uint8_t
 	char cmd[1024];
 	size_t len;
 
+	unsigned long old_timeout;
+
 	CHECK_CLIENT_PTR(c)
 
 	/* Check Chunk Size is 2-32 */
@@ -999,19 +1352,30 @@ int smarti_client_open(smarti_client_t c, uint32_t addr, uint32_t lsap, uint8_t
 
 	len = strlen(cmd);
 
+	/* Wait for the Adapter to be Leased */
+	old_timeout = c->timeout;
+	c->timeout = SMARTIC_OPEN_TIMEOUT;
+
 	/* Send OPEN Command */
 	rv = smartic_socket_write(c, cmd, & len, & timeout);
 	if (rv != 0)
+	{
+		c->timeout = old_timeout;
 		return rv;
+	}
 
 	/* Read Response Line */
 	rv = smartic_socket_readln(c, r_line, 1024, & timeout);
 	if (rv == -1)
 	{
 		SET_ERROR(c, errno, strerror(errno))
+		c->timeout = old_timeout;
 		return -1;
 	}
 
+	/* Restore Timeout */
+	c->timeout = old_timeout;
+
 	if (timeout)
 	{
 		SET_ERROR(c, ETIMEDOUT, "Timed Out")
@@ -1048,6 +1412,48 @@ int smarti_client_open(smarti_client_t c, uint32_t addr, uint32_t lsap, uint8_t
 	return 0;
 }
 
+int smarti_client_open_info(smarti_client_t c, uint32_t addr, uint32_t lsap, uint8_t chunk_size,
+		uint8_t * model, uint32_t * serial, uint32_t * ticks)
+{
+	static const int expect[4] = { SMARTI_STATUS_SUCCESS, SMARTI_STATUS_INFO, SMARTI_STATUS_INFO, SMARTI_STATUS_INFO };
+
+	int rv;
+	char cmd[1024];
+	uint32_t values[4];
+	unsigned long old_timeout;
+
+	CHECK_CLIENT_PTR(c)
+	CHECK_CLIENT_PTR(model)
+	CHECK_CLIENT_PTR(serial)
+	CHECK_CLIENT_PTR(ticks)
+
+	/* Check Chunk Size is 2-32 */
+	if (chunk_size < 2)
+		chunk_size = 2;
+	if (chunk_size > 32)
+		chunk_size = 32;
+
+	/* Format the OPEN, MODEL, SERIAL and TICKS Commands */
+	rv = snprintf(cmd, 1024, "OPEN %u %u %u\nMODEL\nSERIAL\nTICKS\n", addr, lsap, chunk_size);
+	if (rv < 0)
+		return rv;
+
+	/* Wait for the Adapter to be Leased */
+	old_timeout = c->timeout;
+	c->timeout = SMARTIC_OPEN_TIMEOUT;
+
+	rv = smartic_pipeline(c, cmd, 4, expect, values);
+	c->timeout = old_timeout;
+	if (rv != 0)
+		return rv;
+
+	* model = (uint8_t)values[1];
+	* serial = values[2];
+	* ticks = values[3];
+
+	return 0;
+}
+
 int smarti_client_serial(smarti_client_t c, uint32_t * serial)
 {
 	int rv;
@@ -1363,140 +1769,544 @@ int smarti_client_ticks(smarti_client_t c, uint32_t * ticks)
 	return 0;
 }
 
+int smarti_client_token_size(smarti_client_t c, uint32_t token, uint32_t * size)
+{
+	static const int expect[2] = { SMARTI_STATUS_SUCCESS, SMARTI_STATUS_INFO };
+
+	int rv;
+	char cmd[1024];
+	uint32_t values[2];
+
+	CHECK_CLIENT_PTR(c)
+	CHECK_CLIENT_PTR(size)
+
+	/* Format the TOKEN and SIZE Commands */
+	rv = snprintf(cmd, 1024, "TOKEN %u\nSIZE\n", token);
+	if (rv < 0)
+		return rv;
+
+	rv = smartic_pipeline(c, cmd, 2, expect, values);
+	if (rv != 0)
+		return rv;
+
+	* size = values[1];
+
+	return 0;
+}
+
 #define isb64(c) ((('A' <= (c)) && ((c) <= 'Z')) || (('a' <= (c)) && ((c) <= 'z')) || (('0' <= (c)) && ((c) <= '9')) || ((c) == '+') || ((c) == '/') || ((c) == '='))
 
-int smarti_client_xfer(smarti_client_t c, void ** buffer, size_t * size)
+//! Longest Line in a Chunked Transfer (encodes 3072 bytes)
+#define SMARTIC_XFER_LINE	4096
+
+/* Pass Data just Added to the Transfer Buffer to the Data Callback */
+static void smartic_xfer_feed(smarti_client_t c, const unsigned char * data, size_t len)
+{
+	if (c->xfer_cb && (len > 0))
+		c->xfer_cb(c->xfer_data, data, len);
+}
+
+/*
+ * Dispose of the Data Buffer of a Failed Transfer.  Once data has been passed
+ * to the data callback the buffer is handed back instead, as the callback may
+ * still refer to it.
+ */
+static void smartic_xfer_discard(smarti_client_t c, unsigned char * data, size_t pos, void ** buffer, size_t * size)
+{
+	if (c->xfer_cb && (pos > 0))
+	{
+		* ((unsigned char **) buffer) = data;
+		* size = pos;
+		return;
+	}
+
+	free(data);
+}
+
+/* Send an XFER Command and Read the Response Line */
+static int smartic_xfer_request(smarti_client_t c, const char * cmd, char * r_line,
+		int * r_code, const char ** r_msg)
 {
 	int rv;
 	int timeout = 0;
-	char r_line[1024];
-	int r_code;
-	const char * r_msg;
+	size_t len = strlen(cmd);
+
+	/* Send XFER Command */
+	rv = smartic_socket_write(c, cmd, & len, & timeout);
+	if (rv != 0)
+		return rv;
+
+	return smartic_read_response(c, r_line, r_code, r_msg);
+}
+
+/* Parse the Length from a Data Follows Response */
+static int smartic_xfer_length(smarti_client_t c, const char * r_msg, uint32_t * r_len)
+{
 	char * r_info;
+
+	if (smartic_parse_devinfo(r_msg, & r_info) != 0)
+	{
+		SET_ERROR(c, EINVAL, "Invalid response string received")
+		return -1;
+	}
+
+	* r_len = strtoul(r_info, 0, 10);
+	free(r_info);
+
+	return 0;
+}
+
+/*
+ * Read a Transfer sent as a single Base 64 Line (301 Data Follows).  The line
+ * length is known from the response, so the data is read in bulk and only the
+ * line ending goes through the line reader.
+ */
+static int smartic_xfer_line(smarti_client_t c, const char * r_msg, void ** buffer, size_t * size)
+{
+	int timeout = 0;
 	uint32_t r_len;
+	char r_tail[16];
+	ssize_t r_nr;
 
 	char * b64_data;
-	size_t b64_len;
 	ssize_t b64_nr;
 
-	unsigned long old_timeout;
-
-	const char * cmd = "XFER\n";
-	size_t len = strlen(cmd);
-
-	CHECK_CLIENT_PTR(c)
-	CHECK_CLIENT_PTR(buffer)
-	CHECK_CLIENT_PTR(size)
+	if (smartic_xfer_length(c, r_msg, & r_len) != 0)
+		return -1;
 
-	/* Set Socket Timeout to 60s */
-	old_timeout = c->timeout;
-	c->timeout = 60000;
+	/* Initialize Data Buffer */
+	b64_data = (char *)malloc(r_len + 1);
 
-	/* Send SERIAL Command */
-	rv = smartic_socket_write(c, cmd, & len, & timeout);
-	if (rv != 0)
+	if (! b64_data)
 	{
-		c->timeout = old_timeout;
-		return rv;
+		SET_ERROR(c, ENOMEM, "Failed to allocate data buffer")
+		return -1;
 	}
 
-	/* Read Response Line */
-	rv = smartic_socket_readln(c, r_line, 1024, & timeout);
-	if (rv == -1)
+	/* Read Data */
+	b64_nr = smartic_socket_read(c, b64_data, r_len, & timeout);
+	if (b64_nr < 0)
 	{
+		free(b64_data);
 		SET_ERROR(c, errno, strerror(errno))
-		c->timeout = old_timeout;
 		return -1;
 	}
 
 	if (timeout)
 	{
+		free(b64_data);
 		SET_ERROR(c, ETIMEDOUT, "Timed Out")
-		c->timeout = old_timeout;
 		return -1;
 	}
 
-	/* Restore Timeout */
-	c->timeout = old_timeout;
+	/* Read the Line Ending, which must not contain more Data */
+	r_nr = smartic_socket_readln(c, r_tail, sizeof(r_tail), & timeout);
+	if (r_nr < 0)
+	{
+		free(b64_data);
+		SET_ERROR(c, errno, strerror(errno))
+		return -1;
+	}
 
-	/* Parse Line */
-	rv = smartic_parse_response(r_line, & r_code, & r_msg);
-	if (rv != 0)
+	while ((r_nr > 0) && ! isb64(r_tail[r_nr - 1]))
+		r_tail[--r_nr] = '\0';
+
+	/* Check Data Length */
+	if ((b64_nr != r_len) || (r_nr != 0))
 	{
-		if (rv == 1)
+		free(b64_data);
+		SET_ERROR(c, EIO, "Data Length Mismatch in XFER")
+		return -1;
+	}
+
+	/* Base 64 Decode in Place */
+	if (base64_decode_buf(b64_data, b64_nr, (unsigned char *)b64_data, size) != 0)
+	{
+		free(b64_data);
+		SET_ERROR(c, EIO, "Invalid Base 64 Data in XFER")
+		return -1;
+	}
+
+	* ((unsigned char **) buffer) = (unsigned char *)b64_data;
+	smartic_xfer_feed(c, (unsigned char *)b64_data, * size);
+
+	return 0;
+}
+
+/*
+ * Read a Chunked Transfer (302 Data Follows), decoding each line into the
+ * data buffer as it arrives.  The data ends with a blank line followed by a
+ * status line for the whole transfer.
+ */
+static int smartic_xfer_chunked(smarti_client_t c, const char * r_msg, void ** buffer, size_t * size)
+{
+	int rv;
+	int timeout = 0;
+	uint32_t r_len;
+	char r_line[1024];
+	int r_code;
+
+	char b64_line[SMARTIC_XFER_LINE + 2];
+	ssize_t b64_nr;
+	base64_decoder_t dec;
+
+	unsigned char * data;
+	size_t cap;
+	size_t pos;
+	size_t n;
+
+	if (smartic_xfer_length(c, r_msg, & r_len) != 0)
+		return -1;
+
+	/* Initialize Data Buffer (rounded up to whole Base 64 Groups) */
+	cap = ((r_len + 2) / 3) * 3;
+	data = (unsigned char *)malloc(cap ? cap : 1);
+
+	if (! data)
+	{
+		SET_ERROR(c, ENOMEM, "Failed to allocate data buffer")
+		return -1;
+	}
+
+	base64_decoder_init(& dec);
+	pos = 0;
+
+	for (;;)
+	{
+		b64_nr = smartic_socket_readln(c, b64_line, sizeof(b64_line), & timeout);
+		if (b64_nr < 0)
 		{
+			smartic_xfer_discard(c, data, pos, buffer, size);
 			SET_ERROR(c, errno, strerror(errno))
+			return -1;
 		}
-		else if (rv == 2)
+
+		if (timeout)
 		{
-			SET_ERROR(c, EINVAL, "Invalid response string received")
+			smartic_xfer_discard(c, data, pos, buffer, size);
+			SET_ERROR(c, ETIMEDOUT, "Timed Out")
+			return -1;
 		}
-		else
+
+		/* Trim Trailing Invalid Characters */
+		while ((b64_nr > 0) && ! isb64(b64_line[b64_nr - 1]))
+			b64_line[--b64_nr] = '\0';
+
+		/* Blank Line ends the Data */
+		if (b64_nr == 0)
+			break;
+
+		if ((b64_nr > SMARTIC_XFER_LINE) || (pos + BASE64_DECODE_BOUND(b64_nr) > cap))
 		{
-			SET_ERROR(c, rv, r_msg)
+			smartic_xfer_discard(c, data, pos, buffer, size);
+			SET_ERROR(c, EIO, "Data Length Mismatch in XFER")
+			return -1;
 		}
 
+		if (base64_decode_update(& dec, b64_line, b64_nr, data + pos, & n) != 0)
+		{
+			smartic_xfer_discard(c, data, pos, buffer, size);
+			SET_ERROR(c, EIO, "Invalid Base 64 Data in XFER")
+			return -1;
+		}
+
+		smartic_xfer_feed(c, data + pos, n);
+		pos += n;
+	}
+
+	if (base64_decode_final(& dec) != 0)
+	{
+		smartic_xfer_discard(c, data, pos, buffer, size);
+		SET_ERROR(c, EIO, "Invalid Base 64 Data in XFER")
 		return -1;
 	}
 
-	/* Check for Data */
-	if (r_code != SMARTI_DATA_FOLLOWS)
+	/* Read the Transfer Status */
+	rv = smartic_socket_readln(c, r_line, 1024, & timeout);
+	if ((rv <= 0) || timeout || (smartic_parse_response(r_line, & r_code, & r_msg) != 0))
 	{
-		SET_ERROR(c, r_code, r_msg);
+		smartic_xfer_discard(c, data, pos, buffer, size);
+		SET_ERROR(c, EIO, "Missing Status after XFER Data")
 		return -1;
 	}
 
-	/* Parse Response */
-	rv = smartic_parse_devinfo(r_msg, & r_info);
-	if (rv != 0)
+	if (r_code != SMARTI_STATUS_SUCCESS)
 	{
-		SET_ERROR(c, errno, strerror(errno))
+		smartic_xfer_discard(c, data, pos, buffer, size);
+		snprintf(g_server_error, 1024, "%d %s", r_code, r_msg);
+		SET_ERROR(c, r_code, g_server_error)
 		return -1;
 	}
 
-	r_len = strtoul(r_info, 0, 10);
+	/* Check Data Length */
+	if (pos != r_len)
+	{
+		smartic_xfer_discard(c, data, pos, buffer, size);
+		SET_ERROR(c, EIO, "Data Length Mismatch in XFER")
+		return -1;
+	}
+
+	* ((unsigned char **) buffer) = data;
+	* size = pos;
+
+	return 0;
+}
+
+/*
+ * Read a Binary Transfer (301 Binary or Deflate Data Follows).  The data
+ * arrives as frames prefixed with a 4-byte length in network byte order.
+ * Uncompressed frames are read directly into the data buffer; compressed
+ * frames are read in blocks and inflated into it.  A zero-length frame ends
+ * the data and is followed by a status line for the whole transfer.
+ */
+static int smartic_xfer_binary(smarti_client_t c, const char * r_msg, int deflated, void ** buffer, size_t * size)
+{
+	int rv;
+	int timeout = 0;
+	uint32_t r_len;
+	char r_line[1024];
+	int r_code;
+
+	unsigned char hdr[4];
+	unsigned char * data;
+	uint32_t flen;
+	uint32_t n;
+	size_t pos;
+	ssize_t nr = 0;
+	int done = 0;
+	int bad = 0;
+
+	unsigned char block[SMARTIC_XFER_LINE];
+
+#ifdef HAVE_ZLIB
+	z_stream zs;
+	int zrv = Z_OK;
+#endif
+
+	if (smartic_xfer_length(c, r_msg, & r_len) != 0)
+		return -1;
+
+#ifdef HAVE_ZLIB
+	memset(& zs, 0, sizeof(z_stream));
+	if (deflated && (inflateInit(& zs) != Z_OK))
+	{
+		SET_ERROR(c, ENOMEM, "Failed to initialize decompressor")
+		return -1;
+	}
+#else
+	if (deflated)
+	{
+		SET_ERROR(c, EIO, "Compressed XFER is not supported")
+		return -1;
+	}
+#endif
 
 	/* Initialize Data Buffer */
-	b64_len = r_len * 2;
-	b64_data = (char *)malloc(b64_len * sizeof(char));
+	data = (unsigned char *)malloc(r_len ? r_len : 1);
+	pos = 0;
 
-	if (! b64_data)
+	while (data && ! done)
+	{
+		/* Read the Frame Length */
+		nr = smartic_socket_read(c, (char *)hdr, 4, & timeout);
+		if ((nr != 4) || timeout)
+			break;
+
+		flen = ((uint32_t)hdr[0] << 24) | ((uint32_t)hdr[1] << 16) | ((uint32_t)hdr[2] << 8) | hdr[3];
+
+		/* Zero-Length Frame ends the Data */
+		if (flen == 0)
+		{
+			done = 1;
+			break;
+		}
+
+		while (flen > 0)
+		{
+			/* Uncompressed Frames are Read Straight into the Buffer */
+			if (! deflated && ! bad && (flen <= r_len - pos))
+			{
+				nr = smartic_socket_read(c, (char *)data + pos, flen, & timeout);
+				if ((nr != (ssize_t)flen) || timeout)
+					break;
+
+				smartic_xfer_feed(c, data + pos, flen);
+				pos += flen;
+				flen = 0;
+				break;
+			}
+
+			/* Otherwise Read a Block to Inflate, or to Discard after an Error */
+			n = (flen < sizeof(block)) ? flen : sizeof(block);
+
+			nr = smartic_socket_read(c, (char *)block, n, & timeout);
+			if ((nr != (ssize_t)n) || timeout)
+				break;
+
+			flen -= n;
+
+			if (! deflated || bad)
+			{
+				bad = 1;
+				continue;
+			}
+
+#ifdef HAVE_ZLIB
+			zs.next_in = block;
+			zs.avail_in = n;
+			zs.next_out = data + pos;
+			zs.avail_out = r_len - pos;
+
+			/* All Input is Consumed unless the Stream or the Buffer Ends */
+			zrv = inflate(& zs, Z_NO_FLUSH);
+			smartic_xfer_feed(c, data + pos, r_len - zs.avail_out - pos);
+			pos = r_len - zs.avail_out;
+
+			if (((zrv != Z_OK) && (zrv != Z_STREAM_END)) || (zs.avail_in != 0))
+				bad = 1;
+#endif
+		}
+
+		if (flen > 0)
+			break;
+	}
+
+#ifdef HAVE_ZLIB
+	if (deflated)
+	{
+		inflateEnd(& zs);
+		bad |= (zrv != Z_STREAM_END);
+	}
+#endif
+
+	if (! data)
 	{
 		SET_ERROR(c, ENOMEM, "Failed to allocate data buffer")
 		return -1;
 	}
 
-	/* Read Data */
-	b64_nr = smartic_socket_readln(c, b64_data, b64_len, & timeout);
-	if (b64_nr < 0)
+	if (! done)
 	{
-		free(b64_data);
-		SET_ERROR(c, errno, strerror(errno))
+		smartic_xfer_discard(c, data, pos, buffer, size);
+
+		if (nr < 0)
+		{
+			SET_ERROR(c, errno, strerror(errno))
+		}
+		else if (timeout)
+		{
+			SET_ERROR(c, ETIMEDOUT, "Timed Out")
+		}
+		else
+		{
+			SET_ERROR(c, EIO, "Connection closed during XFER")
+		}
+
 		return -1;
 	}
 
-	if (timeout)
+	/* Read the Transfer Status */
+	rv = smartic_socket_readln(c, r_line, 1024, & timeout);
+	if ((rv <= 0) || timeout || (smartic_parse_response(r_line, & r_code, & r_msg) != 0))
 	{
-		free(b64_data);
-		SET_ERROR(c, ETIMEDOUT, "Timed Out")
-		c->timeout = old_timeout;
+		smartic_xfer_discard(c, data, pos, buffer, size);
+		SET_ERROR(c, EIO, "Missing Status after XFER Data")
 		return -1;
 	}
 
-	/* Trim Trailing Invalid Characters */
-	while (! isb64(b64_data[b64_nr - 1]))
-		b64_data[--b64_nr] = '\0';
+	if (r_code != SMARTI_STATUS_SUCCESS)
+	{
+		smartic_xfer_discard(c, data, pos, buffer, size);
+		snprintf(g_server_error, 1024, "%d %s", r_code, r_msg);
+		SET_ERROR(c, r_code, g_server_error)
+		return -1;
+	}
 
-	/* Check Data Length */
-	if (b64_nr != r_len)
+	/* Check the Data */
+	if (bad || (pos != r_len))
 	{
-		free(b64_data);
-		SET_ERROR(c, EIO, "Data Length Mismatch in XFER")
+		smartic_xfer_discard(c, data, pos, buffer, size);
+		SET_ERROR(c, EIO, deflated ? "Invalid Compressed Data in XFER" : "Data Length Mismatch in XFER")
 		return -1;
 	}
 
-	/* Base 64 Decode */
-	* ((unsigned char **) buffer) = base64_decode(b64_data, b64_nr, size);
+	* ((unsigned char **) buffer) = data;
+	* size = pos;
 
 	return 0;
 }
+
+int smarti_client_xfer(smarti_client_t c, void ** buffer, size_t * size)
+{
+	return smarti_client_xfer_stream(c, buffer, size, 0, 0);
+}
+
+int smarti_client_xfer_stream(smarti_client_t c, void ** buffer, size_t * size, smarti_data_cb_t cb, void * userdata)
+{
+	int rv;
+	char r_line[1024];
+	int r_code;
+	const char * r_msg;
+
+	unsigned long old_timeout;
+
+	CHECK_CLIENT_PTR(c)
+	CHECK_CLIENT_PTR(buffer)
+	CHECK_CLIENT_PTR(size)
+
+	/* Set Socket Timeout to 60s for the Transfer */
+	old_timeout = c->timeout;
+	c->timeout = 60000;
+
+	c->xfer_cb = cb;
+	c->xfer_data = userdata;
+
+	/*
+	 * Binary Transfers were negotiated at connection time.  Otherwise request
+	 * a Chunked Transfer, falling back for Servers without it.
+	 */
+	if (c->binary)
+	{
+		rv = smartic_xfer_request(c, "XFER\n", r_line, & r_code, & r_msg);
+	}
+	else
+	{
+		rv = smartic_xfer_request(c, "XFER CHUNKED\n", r_line, & r_code, & r_msg);
+		if ((rv == 0) && (r_code == SMARTI_ERROR_INVALID_COMMAND))
+			rv = smartic_xfer_request(c, "XFER\n", r_line, & r_code, & r_msg);
+	}
+
+	if (rv == 0)
+	{
+		if (c->binary && (r_code == SMARTI_DATA_FOLLOWS) && (strncasecmp(r_msg, "Binary", 6) == 0))
+		{
+			rv = smartic_xfer_binary(c, r_msg, 0, buffer, size);
+		}
+		else if (c->binary && (r_code == SMARTI_DATA_FOLLOWS) && (strncasecmp(r_msg, "Deflate", 7) == 0))
+		{
+			rv = smartic_xfer_binary(c, r_msg, 1, buffer, size);
+		}
+		else if (r_code == SMARTI_DATA_CHUNKED)
+		{
+			rv = smartic_xfer_chunked(c, r_msg, buffer, size);
+		}
+		else if (r_code == SMARTI_DATA_FOLLOWS)
+		{
+			rv = smartic_xfer_line(c, r_msg, buffer, size);
+		}
+		else
+		{
+			snprintf(g_server_error, 1024, "%d %s", r_code, r_msg);
+			SET_ERROR(c, r_code, g_server_error)
+			rv = -1;
+		}
+	}
+
+	/* Restore Timeout */
+	c->timeout = old_timeout;
+
+	c->xfer_cb = 0;
+	c->xfer_data = 0;
+
+	return rv;
+}
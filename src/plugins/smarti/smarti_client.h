@@ -43,6 +43,14 @@ typedef struct smarti_client_t_ *	smarti_client_t;
  */
 typedef int (* smarti_enum_cb_t)(void *, uint32_t, const char *);
 
+/**
+ * @brief Smart-I Transfer Data Callback
+ * @param[in] User Data
+ * @param[in] Data received since the last Call
+ * @param[in] Length of the Data
+ */
+typedef void (* smarti_data_cb_t)(void *, const void *, size_t);
+
 /**
  * @brief Initialize the Smart-I Client
  * @return Zero on Success, Non-Zero on Failure
@@ -79,7 +87,9 @@ const char * smarti_client_errmsg(smarti_client_t);
  * @return Zero on Success, Non-Zero on Failure
  *
  * Attempts to connect to a Smart-I protocol daemon running on the given
- * host and port.
+ * host and port.  After the greeting the client asks the server to send
+ * transfer data in binary; servers which do not support this continue to
+ * send base64 data.
  */
 int smarti_client_connect(smarti_client_t, const char *, uint16_t);
 
@@ -122,6 +132,24 @@ int smarti_client_enumerate(smarti_client_t, smarti_enum_cb_t, void *);
  */
 int smarti_client_open(smarti_client_t, uint32_t, uint32_t, uint8_t);
 
+/**
+ * @brief Open a Smart Device and Read its Identification
+ * @param[in] Smart-I Client Handle
+ * @param[in] Device Address
+ * @param[in] LSAP Endpoint
+ * @param[in] Chunk Size
+ * @param[out] Smart Device Model Number
+ * @param[out] Smart Device Serial Number
+ * @param[out] Smart Device Tick Count
+ * @return Zero on Success, Non-Zero on Failure
+ *
+ * Equivalent to smarti_client_open() followed by smarti_client_model(),
+ * smarti_client_serial() and smarti_client_ticks(), but the four commands are
+ * pipelined in a single write so that they cost one round trip to the server.
+ * If the device fails to open, the error reported is that of the OPEN command.
+ */
+int smarti_client_open_info(smarti_client_t, uint32_t, uint32_t, uint8_t, uint8_t *, uint32_t *, uint32_t *);
+
 //! @brief Close the current Smart Device
 int smarti_client_close(smarti_client_t);
 
@@ -172,6 +200,18 @@ int smarti_client_set_token(smarti_client_t, uint32_t);
  */
 int smarti_client_size(smarti_client_t, uint32_t *);
 
+/**
+ * @brief Set the Transfer Token and Get the Transfer Data Size
+ * @param[in] Smart-I Client Handle
+ * @param[in] Transfer Token
+ * @param[out] Transfer Data Size
+ * @return Zero on Success, Non-Zero on Failure
+ *
+ * Equivalent to smarti_client_set_token() followed by smarti_client_size(),
+ * with both commands pipelined in a single write.
+ */
+int smarti_client_token_size(smarti_client_t, uint32_t, uint32_t *);
+
 /**
  * @brief Transfer Data from the Device
  * @param[in] Smart-I Client Handle
@@ -187,4 +227,24 @@ int smarti_client_size(smarti_client_t, uint32_t *);
  */
 int smarti_client_xfer(smarti_client_t, void **, size_t *);
 
+/**
+ * @brief Transfer Data from the Device, Streaming it as it Arrives
+ * @param[in] Smart-I Client Handle
+ * @param[out] Data Buffer Pointer
+ * @param[out] Data Buffer Size
+ * @param[in] Data Callback Function
+ * @param[in] Data Callback User Data
+ * @return Zero on Success, Non-Zero on Failure
+ *
+ * Behaves like smarti_client_xfer(), but also calls the data callback with
+ * each run of bytes as it is added to the data buffer.  The buffer is not
+ * moved during the transfer, so the data passed to the callback stays valid
+ * until the buffer is freed.
+ *
+ * If the transfer fails after the callback has been called, the partial
+ * buffer is still stored in the location given, with the size set to the
+ * number of bytes received, and the client must free it.
+ */
+int smarti_client_xfer_stream(smarti_client_t, void **, size_t *, smarti_data_cb_t, void *);
+
 #endif /* SMARTI_CLIENT_H_ */
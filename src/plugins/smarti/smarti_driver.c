@@ -52,6 +52,8 @@ struct smarti_device_
 
 	int							lsap;		///< Device LSAP Identifier
 	unsigned int				csize;		///< Device Chunk Size
+
+	uint32_t					rate;		///< Last Transfer Rate (bytes/s)
 };
 
 /* Smart-I Device Handle */
@@ -140,6 +142,7 @@ int smarti_driver_create(dev_handle_t * abstract)
 	sd->epname = NULL;
 	sd->lsap = 1;
 	sd->csize = 4;
+	sd->rate = 0;
 
 	/* Create the Smart-I Client Handle */
 	rv = smarti_client_alloc(& sd->client);
@@ -229,8 +232,9 @@ int smarti_driver_open(dev_handle_t abstract, const char * devpath, const char *
 		return DRIVER_ERR_NO_DEVICE;
 	}
 
-	/* Connect to the Device */
-	rc = smarti_client_open(dev->client, dev->epaddr, lsap, chunk_size);
+	/* Connect to the Device and Read the Model, Serial Number and Tick Count */
+	rc = smarti_client_open_info(dev->client, dev->epaddr, lsap, chunk_size,
+		& dev->base.model, & dev->base.serial, & dev->base.ticks);
 	if (rc != 0)
 	{
 		switch (smarti_client_errcode(dev->client))
@@ -258,37 +262,34 @@ int smarti_driver_open(dev_handle_t abstract, const char * devpath, const char *
 		return DRIVER_ERR_INTERNAL;
 	}
 
-	/* Read Model Number */
-	rc = smarti_client_model(dev->client, & dev->base.model);
-	if (rc != 0)
-	{
-		smart_device_set_error(dev->base, DRIVER_ERR_INTERNAL, smarti_client_errmsg(dev->client), 1);
-		smarti_client_disconnect(dev->client);
-		return DRIVER_ERR_INTERNAL;
-	}
+	/* Calculate Time Correction */
+	time_t hstime = time(NULL) * 2;
+	dev->base.epoch = smarti_driver_epoch();
+	dev->base.tcorr = hstime - dev->base.ticks;
 
-	/* Read Serial Number */
-	rc = smarti_client_serial(dev->client, & dev->base.serial);
-	if (rc != 0)
-	{
-		smart_device_set_error(dev->base, DRIVER_ERR_INTERNAL, smarti_client_errmsg(dev->client), 1);
-		smarti_client_disconnect(dev->client);
-		return DRIVER_ERR_INTERNAL;
-	}
+	/* Success */
+	return DRIVER_ERR_SUCCESS;
+}
 
-	/* Read Tick Count */
-	rc = smarti_client_ticks(dev->client, & dev->base.ticks);
-	if (rc != 0)
+int smarti_driver_open_offline(dev_handle_t abstract, uint8_t model, uint32_t serial, uint32_t ticks, time_t xfer_time)
+{
+	smarti_device_t dev = (smarti_device_t)(abstract);
+
+	/* Check Magic Number */
+	if (! CHECK_DEV(dev))
 	{
-		smart_device_set_error(dev->base, DRIVER_ERR_INTERNAL, smarti_client_errmsg(dev->client), 1);
-		smarti_client_disconnect(dev->client);
-		return DRIVER_ERR_INTERNAL;
+		errno = EINVAL;
+		return DRIVER_ERR_INVALID;
 	}
 
-	/* Calculate Time Correction */
-	time_t hstime = time(NULL) * 2;
+	/* Load the Device Information from the Saved Transfer */
+	dev->base.model = model;
+	dev->base.serial = serial;
+	dev->base.ticks = ticks;
+
+	/* Calculate Time Correction as of the Transfer */
 	dev->base.epoch = smarti_driver_epoch();
-	dev->base.tcorr = hstime - dev->base.ticks;
+	dev->base.tcorr = xfer_time * 2 - dev->base.ticks;
 
 	/* Success */
 	return DRIVER_ERR_SUCCESS;
@@ -385,7 +386,56 @@ int smarti_driver_get_serial(dev_handle_t abstract, uint32_t * outval)
 	return DRIVER_ERR_SUCCESS;
 }
 
-int smarti_driver_transfer(dev_handle_t abstract, void ** buffer, uint32_t * size, device_callback_fn_t dcb, transfer_callback_fn_t pcb, void * userdata)
+/* Dive Streaming State for a Transfer */
+typedef struct
+{
+	smarti_device_t				dev;		///< Smart-I Device
+	smart_extractor_t			ex;			///< Dive Extractor (NULL if not Streaming)
+	int							failed;		///< Extractor Found Corrupt Data
+
+	transfer_callback_fn_t		pcb;		///< Transfer Progress Callback
+	void *						userdata;	///< Callback User Data
+
+	uint32_t					pos;		///< Bytes Received
+	uint32_t					total;		///< Transfer Size
+	struct timespec				t0;			///< Transfer Start Time
+
+} smarti_stream_t;
+
+/* Report the Transfer Rate since the Start of the Transfer */
+static void smarti_driver_update_rate(smarti_device_t dev, const struct timespec * t0, uint32_t bytes)
+{
+	struct timespec t1;
+	double elapsed;
+
+	clock_gettime(CLOCK_MONOTONIC, & t1);
+
+	elapsed = (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) / 1e9;
+	if (elapsed > 0)
+		dev->rate = (uint32_t)(bytes / elapsed);
+}
+
+/*
+ * Called by the client as data arrives.  The client buffer does not move, so
+ * the extractor can pass dives to the caller in place as they complete.
+ */
+static void smarti_driver_data_cb(void * userdata, const void * data, size_t len)
+{
+	smarti_stream_t * st = (smarti_stream_t *)(userdata);
+
+	st->pos += len;
+
+	if ((st->ex != NULL) && ! st->failed && (smart_extractor_feed(st->ex, data, len) != EXTRACT_SUCCESS))
+		st->failed = 1;
+
+	smarti_driver_update_rate(st->dev, & st->t0, st->pos);
+
+	/* Completion is Reported once the Server Confirms the Transfer */
+	if ((st->pcb != NULL) && (st->pos < st->total))
+		st->pcb(st->userdata, st->pos, st->total, 0);
+}
+
+static int smarti_driver_do_transfer(dev_handle_t abstract, void ** buffer, uint32_t * size, device_callback_fn_t dcb, transfer_callback_fn_t pcb, divedata_callback_fn_t cb, void * userdata)
 {
 	int rc;
 
@@ -395,6 +445,7 @@ int smarti_driver_transfer(dev_handle_t abstract, void ** buffer, uint32_t * siz
 	int free_token = 0;
 	uint32_t token = 0;
 	size_t bsize;
+	smarti_stream_t st;
 
 	/* Check Magic Number */
 	if (! CHECK_DEV(dev) || ! buffer || ! size)
@@ -429,16 +480,8 @@ int smarti_driver_transfer(dev_handle_t abstract, void ** buffer, uint32_t * siz
 		}
 	}
 
-	/* Set the Transfer Token */
-	rc = smarti_client_set_token(dev->client, token);
-	if (rc != 0)
-	{
-		smart_device_set_error(dev->base, DRIVER_ERR_INTERNAL, smarti_client_errmsg(dev->client), 1);
-		return DRIVER_ERR_INTERNAL;
-	}
-
-	/* Get the Transfer Size */
-	rc = smarti_client_size(dev->client, size);
+	/* Set the Transfer Token and Get the Transfer Size */
+	rc = smarti_client_token_size(dev->client, token, size);
 	if (rc != 0)
 	{
 		smart_device_set_error(dev->base, DRIVER_ERR_INTERNAL, smarti_client_errmsg(dev->client), 1);
@@ -446,19 +489,34 @@ int smarti_driver_transfer(dev_handle_t abstract, void ** buffer, uint32_t * siz
 	}
 
 	/* Check for No Data */
+	* buffer = 0;
 	if ((* size) == 0)
-	{
-		* buffer = 0;
 		return DRIVER_ERR_SUCCESS;
+
+	/* Stream Dives out of the Buffer as it Fills */
+	memset(& st, 0, sizeof(smarti_stream_t));
+	st.dev = dev;
+	st.pcb = pcb;
+	st.userdata = userdata;
+	st.total = (* size);
+
+	if ((cb != NULL) && (smart_extractor_create(& st.ex, cb, userdata, SMART_EXTRACT_CONTIGUOUS) != 0))
+	{
+		smart_device_set_error(dev->base, ENOMEM, "Unable to allocate dive extractor", 0);
+		return DRIVER_ERR_INTERNAL;
 	}
 
 	/* Transfer Data */
+	dev->rate = 0;
 	if (pcb != NULL)
 		pcb(userdata, 0, (* size), 0);
 
-	rc = smarti_client_xfer(dev->client, buffer, & bsize);
+	clock_gettime(CLOCK_MONOTONIC, & st.t0);
+	rc = smarti_client_xfer_stream(dev->client, buffer, & bsize, smarti_driver_data_cb, & st);
 	if (rc != 0)
 	{
+		smart_extractor_close(st.ex);
+
 		if (smarti_client_errcode(dev->client) == SMARTI_ERROR_TIMEOUT)
 		{
 			smart_device_set_error(dev->base, DRIVER_ERR_TIMEOUT, "Timed Out", 0);
@@ -474,17 +532,58 @@ int smarti_driver_transfer(dev_handle_t abstract, void ** buffer, uint32_t * siz
 	/* Check Data Size */
 	if (bsize != (* size))
 	{
+		smart_extractor_close(st.ex);
 		smart_device_set_error(dev->base, DRIVER_ERR_INTERNAL, "Data length mismatch", 1);
 		return DRIVER_ERR_INTERNAL;
 	}
 
+	/* Check for a Corrupt or Partial Dive in the Stream */
+	rc = (st.ex != NULL) ? smart_extractor_finish(st.ex) : EXTRACT_SUCCESS;
+	smart_extractor_close(st.ex);
+
+	if (st.failed || (rc != EXTRACT_SUCCESS))
+	{
+		smart_device_set_error(dev->base, DRIVER_ERR_READ, "Invalid or Corrupt Data", 0);
+		return DRIVER_ERR_READ;
+	}
+
 	/* Data Transfer Complete */
+	smarti_driver_update_rate(dev, & st.t0, bsize);
+
 	if (pcb != NULL)
 		pcb(userdata, bsize, (* size), 0);
 
 	return DRIVER_ERR_SUCCESS;
 }
 
+int smarti_driver_transfer(dev_handle_t abstract, void ** buffer, uint32_t * size, device_callback_fn_t dcb, transfer_callback_fn_t pcb, void * userdata)
+{
+	return smarti_driver_do_transfer(abstract, buffer, size, dcb, pcb, NULL, userdata);
+}
+
+int smarti_driver_transfer_stream(dev_handle_t abstract, void ** buffer, uint32_t * size, device_callback_fn_t dcb, transfer_callback_fn_t pcb, divedata_callback_fn_t cb, void * userdata)
+{
+	return smarti_driver_do_transfer(abstract, buffer, size, dcb, pcb, cb, userdata);
+}
+
+int smarti_driver_transfer_rate(dev_handle_t abstract, uint32_t * rate, uint32_t * chunk)
+{
+	smarti_device_t dev = (smarti_device_t)(abstract);
+
+	/* Check Magic Number */
+	if (! CHECK_DEV(dev) || ! rate || ! chunk)
+	{
+		errno = EINVAL;
+		return DRIVER_ERR_INVALID;
+	}
+
+	/* The Server Chooses the Read Size */
+	* rate = dev->rate;
+	* chunk = 0;
+
+	return DRIVER_ERR_SUCCESS;
+}
+
 int smarti_driver_extract(dev_handle_t abstract, void * buffer, uint32_t size, divedata_callback_fn_t cb, void * userdata)
 {
 	int rc;
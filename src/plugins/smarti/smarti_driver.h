@@ -53,6 +53,7 @@ extern "C" {
  */
 int smarti_driver_create(dev_handle_t * dev);
 int smarti_driver_open(dev_handle_t dev, const char *, const char * args);
+int smarti_driver_open_offline(dev_handle_t dev, uint8_t model, uint32_t serial, uint32_t ticks, time_t xfer_time);
 void smarti_driver_close(dev_handle_t dev);
 void smarti_driver_shutdown(dev_handle_t dev);
 const char * smarti_driver_name(dev_handle_t dev);
@@ -63,7 +64,9 @@ int smarti_driver_get_model(dev_handle_t dev, uint8_t * outval);
 int smarti_driver_get_serial(dev_handle_t dev, uint32_t * outval);
 
 int smarti_driver_transfer(dev_handle_t dev, void ** buffer, uint32_t * size, device_callback_fn_t dcb, transfer_callback_fn_t pcb, void * userdata);
+int smarti_driver_transfer_stream(dev_handle_t dev, void ** buffer, uint32_t * size, device_callback_fn_t dcb, transfer_callback_fn_t pcb, divedata_callback_fn_t cb, void * userdata);
 int smarti_driver_extract(dev_handle_t dev, void * buffer, uint32_t size, divedata_callback_fn_t cb, void * userdata);
+int smarti_driver_transfer_rate(dev_handle_t dev, uint32_t * rate, uint32_t * chunk);
 /*@}*/
 
 #ifdef __cplusplus
@@ -28,10 +28,9 @@
  * WITH THE SOFTWARE.
  */
 
-#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
-#include <strings.h>						// strncasecmp
+#include <strings.h>						// strcasecmp, strncasecmp
 
 #include <event2/buffer.h>
 #include <event2/bufferevent.h>
@@ -42,7 +41,16 @@
 
 #include "smartid_conn.h"
 #include "smartid_cmd.h"
+#include "smartid_devmgr.h"
 #include "smartid_logging.h"
+#include "smartid_worker.h"
+
+/**@{
+ * @name Command Flags
+ */
+#define SMARTID_CMD_DEVICE		1		///< Command does Device I/O and runs on a Worker
+#define SMARTID_CMD_ADAPTER		2		///< Command waits for the IrDA Adapter before Running
+/*@}*/
 
 //! Smart-I Command Structure
 struct smarti_cmd_t
@@ -57,6 +65,18 @@ struct smarti_cmd_t
 	 * @param[in] Command Parameters
 	 */
 	void (* func)(smarti_conn_t, struct smarti_cmd_t *, const char *);
+
+	int					flags;				///< Command Flags
+};
+
+//! Command Queued for a Worker Thread, held in the Connection Arena
+struct smarti_cmd_job_t
+{
+	smartid_job_t			job;			///< Worker Job
+	smartid_lease_t			lease;			///< IrDA Adapter Request
+	smarti_conn_t			conn;			///< Smart-I Connection
+	struct smarti_cmd_t *	cmd;			///< Smart-I Command
+	char *					params;			///< Command Parameters
 };
 
 /**@{
@@ -67,6 +87,7 @@ static void smartid_cmd_enum(smarti_conn_t, struct smarti_cmd_t *, const char *)
 static void smartid_cmd_help(smarti_conn_t, struct smarti_cmd_t *, const char *);
 static void smartid_cmd_model(smarti_conn_t, struct smarti_cmd_t *, const char *);
 static void smartid_cmd_open(smarti_conn_t, struct smarti_cmd_t *, const char *);
+static void smartid_cmd_option(smarti_conn_t, struct smarti_cmd_t *, const char *);
 static void smartid_cmd_serial(smarti_conn_t, struct smarti_cmd_t *, const char *);
 static void smartid_cmd_size(smarti_conn_t, struct smarti_cmd_t *, const char *);
 static void smartid_cmd_tcorr(smarti_conn_t, struct smarti_cmd_t *, const char *);
@@ -75,75 +96,191 @@ static void smartid_cmd_token(smarti_conn_t, struct smarti_cmd_t *, const char *
 static void smartid_cmd_xfer(smarti_conn_t, struct smarti_cmd_t *, const char *);
 /*@}*/
 
+/**@{
+ * @name Command Table Indices
+ *
+ * These must follow the order of smarti_cmd_table, and smartid_cmd_lookup()
+ * must be updated whenever a command is added.
+ */
+enum
+{
+	SMARTID_CMD_CLOSE = 0,
+	SMARTID_CMD_ENUM,
+	SMARTID_CMD_HELP,
+	SMARTID_CMD_MODEL,
+	SMARTID_CMD_OPEN,
+	SMARTID_CMD_OPTION,
+	SMARTID_CMD_SERIAL,
+	SMARTID_CMD_SIZE,
+	SMARTID_CMD_TCORR,
+	SMARTID_CMD_TICKS,
+	SMARTID_CMD_TOKEN,
+	SMARTID_CMD_XFER,
+};
+/*@}*/
+
 //! Smart-I Command Table
 static struct smarti_cmd_t smarti_cmd_table[] =
 {
-	{"close",	"Close the current IrDA connection",					smartid_cmd_close},
-	{"enum",	"Print the list of IrDA devices found on the bus",		smartid_cmd_enum},
-	{"help",	"Print the list of commands and their descriptions",	smartid_cmd_help},
-	{"model",	"Print the model name of the open device",				smartid_cmd_model},
-	{"open",	"Open a connection to an IrDA device",					smartid_cmd_open},
-	{"serial",	"Print the serial number of the open device",			smartid_cmd_serial},
-	{"size",	"Print the size of the next transfer in bytes",			smartid_cmd_size},
-	{"tcorr",	"Print the time correction value of the open device",	smartid_cmd_tcorr},
-	{"ticks",	"Print the time tick value of the open device",			smartid_cmd_ticks},
-	{"token",	"Set the token for the next transfer operation",		smartid_cmd_token},
-	{"xfer",	"Transfer data from the device",						smartid_cmd_xfer},
-	{0,			0,														0}
+	{"close",	"Close the current IrDA connection",					smartid_cmd_close,	0},
+	{"enum",	"Print the list of IrDA devices found on the bus",		smartid_cmd_enum,	SMARTID_CMD_DEVICE},
+	{"help",	"Print the list of commands and their descriptions",	smartid_cmd_help,	0},
+	{"model",	"Print the model name of the open device",				smartid_cmd_model,	SMARTID_CMD_DEVICE},
+	{"open",	"Open a connection to an IrDA device",					smartid_cmd_open,	SMARTID_CMD_DEVICE | SMARTID_CMD_ADAPTER},
+	{"option",	"Set the transfer encoding (BASE64, BINARY [DEFLATE])",	smartid_cmd_option,	0},
+	{"serial",	"Print the serial number of the open device",			smartid_cmd_serial,	SMARTID_CMD_DEVICE},
+	{"size",	"Print the size of the next transfer in bytes",			smartid_cmd_size,	SMARTID_CMD_DEVICE},
+	{"tcorr",	"Print the time correction value of the open device",	smartid_cmd_tcorr,	0},
+	{"ticks",	"Print the time tick value of the open device",			smartid_cmd_ticks,	0},
+	{"token",	"Set the token for the next transfer operation",		smartid_cmd_token,	0},
+	{"xfer",	"Transfer data from the device (XFER CHUNKED for lines)",	smartid_cmd_xfer,	SMARTID_CMD_DEVICE},
+	{0,			0,														0,					0}
 };
 
-//! IrDA Device Info List Entry
-struct irda_dev_info_t
+/*
+ * Look up a Command by Name.  The switch on the name length and then on one
+ * distinguishing character selects the only candidate in the table, so that
+ * a single case-insensitive comparison accepts or rejects the name.  Only
+ * exact matches are accepted.
+ */
+static struct smarti_cmd_t * smartid_cmd_lookup(const char * name, size_t len)
 {
-	unsigned int				addr;
-	unsigned int				charset;
-	unsigned int				hints;
-	char *						name;
+	int idx = -1;
 
-	struct irda_dev_info_t *	next;
-};
+	switch (len)
+	{
+	case 4:
+		switch (name[0] | 0x20)
+		{
+		case 'e': idx = SMARTID_CMD_ENUM; break;
+		case 'h': idx = SMARTID_CMD_HELP; break;
+		case 'o': idx = SMARTID_CMD_OPEN; break;
+		case 's': idx = SMARTID_CMD_SIZE; break;
+		case 'x': idx = SMARTID_CMD_XFER; break;
+		}
+		break;
 
-// IrDA Enumeration Callback
+	case 5:
+		switch (name[0] | 0x20)
+		{
+		case 'c': idx = SMARTID_CMD_CLOSE; break;
+		case 'm': idx = SMARTID_CMD_MODEL; break;
+		case 't':
+			switch (name[1] | 0x20)
+			{
+			case 'c': idx = SMARTID_CMD_TCORR; break;
+			case 'i': idx = SMARTID_CMD_TICKS; break;
+			case 'o': idx = SMARTID_CMD_TOKEN; break;
+			}
+			break;
+		}
+		break;
+
+	case 6:
+		switch (name[0] | 0x20)
+		{
+		case 'o': idx = SMARTID_CMD_OPTION; break;
+		case 's': idx = SMARTID_CMD_SERIAL; break;
+		}
+		break;
+	}
+
+	if ((idx < 0) || (strncasecmp(name, smarti_cmd_table[idx].name, len) != 0))
+		return 0;
+
+	return & smarti_cmd_table[idx];
+}
+
+// IrDA Enumeration Callback, which Reports each Device as it is Found
 void irda_enum_cb(unsigned int addr, const char * name, unsigned int charset, unsigned int hints, void * arg)
 {
-	struct irda_dev_info_t * dev;
-	struct irda_dev_info_t ** plist = (struct irda_dev_info_t **)arg;
+	smarti_conn_t c = (smarti_conn_t)arg;
 
 	if (! arg)
 		return;
 
-	/* Fill in Device Info */
-	dev = (struct irda_dev_info_t *)malloc(sizeof(struct irda_dev_info_t));
-	if (! dev)
+	smartid_log_debug("Found device '%s' at %lu", name, addr);
+	smartid_conn_send_responsef(c, SMARTI_STATUS_INFO, "Device: %lu %s", addr, name);
+}
+
+/* Run a Queued Command on a Worker Thread */
+static void smartid_cmd_job_run(void * arg)
+{
+	struct smarti_cmd_job_t * job = (struct smarti_cmd_job_t *)arg;
+
+	/* Pass the Adapter on if the Client left while Waiting for it */
+	if ((job->cmd->flags & SMARTID_CMD_ADAPTER) && smartid_conn_aborted(job->conn))
 	{
-		smartid_log_error("Failed to allocate struct irda_dev_info_t");
+		if (! smartid_conn_device(job->conn))
+			smartid_devmgr_release(job->conn);
 		return;
 	}
 
-	smartid_log_debug("Found device '%s' at %lu", name, addr);
+	job->cmd->func(job->conn, job->cmd, job->params);
+	smartid_conn_flush(job->conn);
+}
+
+/* Return the Connection to the Event Loop once a Queued Command is Done */
+static void smartid_cmd_job_done(void * arg)
+{
+	struct smarti_cmd_job_t * job = (struct smarti_cmd_job_t *)arg;
+
+	/* Resuming may Read the next Command, which Resets the Arena */
+	smartid_conn_resume(job->conn);
+}
 
-	dev->addr = addr;
-	dev->name = strdup(name);
-	dev->charset = charset;
-	dev->hints = hints;
+/* Queue a Device Command, falling back to running it Directly */
+static void smartid_cmd_queue(smarti_conn_t c, struct smarti_cmd_t * cmd, const char * params)
+{
+	struct smarti_cmd_job_t * job;
 
-	/* Insert as List Head */
-	dev->next = (* plist);
-	(* plist) = dev;
+	/* The Command Line is Drained on Return, so the Parameters are Copied */
+	job = (struct smarti_cmd_job_t *)smartid_conn_arena_alloc(c, sizeof(struct smarti_cmd_job_t));
+	if (job)
+	{
+		job->job.work = smartid_cmd_job_run;
+		job->job.done = smartid_cmd_job_done;
+		job->job.arg = job;
+		job->conn = c;
+		job->cmd = cmd;
+		job->params = smartid_conn_arena_strdup(c, params);
+
+		if (! params || job->params)
+		{
+			smartid_conn_suspend(c);
+
+			if (cmd->flags & SMARTID_CMD_ADAPTER)
+			{
+				job->lease.conn = c;
+				job->lease.addr = params ? (unsigned int)strtoul(params, 0, 10) : 0;
+				job->lease.job = & job->job;
+
+				if (smartid_devmgr_acquire(& job->lease) == 0)
+					return;
+			}
+			else if (smartid_worker_queue(& job->job) == 0)
+			{
+				return;
+			}
+
+			smartid_conn_resume(c);
+		}
+	}
+
+	smartid_log_warning("Failed to queue command '%s', running it in the event loop", cmd->name);
+	cmd->func(c, cmd, params);
 }
 
-void smartid_cmd_process(smarti_conn_t c, const char * cmd_line, size_t cmd_len)
+void smartid_cmd_process(smarti_conn_t c, char * cmd_line, size_t cmd_len)
 {
 	size_t name_len;
-	int i;
-	struct smarti_cmd_t * cmd = 0;
-	char * p;
+	struct smarti_cmd_t * cmd;
 	char * name;
 	char * params;
 
-	/* Separate Command Name from Parameters */
-	cmd_line += strspn(cmd_line, " \t");
-	name_len  = strcspn(cmd_line, " \t");
+	/* Separate Command Name from Parameters, Terminating the Name in Place */
+	name = cmd_line + strspn(cmd_line, " \t");
+	name_len = strcspn(name, " \t");
 
 	if (name_len == 0)
 	{
@@ -151,42 +288,36 @@ void smartid_cmd_process(smarti_conn_t c, const char * cmd_line, size_t cmd_len)
 		smartid_conn_send_ready(c);
 		return;
 	}
-	else if (name_len == strlen(cmd_line))
+
+	params = name + name_len;
+	if (* params)
 	{
-		/* No Parameters Received */
-		name = strndup(cmd_line, name_len);
-		params = 0;
+		* params++ = 0;
+		params += strspn(params, " \t");
 	}
-	else
+
+	if (! * params)
 	{
-		/* Split Command and Parameters */
-		name = strndup(cmd_line, name_len);
-		params = strdup(cmd_line + name_len + 1);
+		/* No Parameters Received */
+		params = 0;
 	}
 
-	/* Lower-Case the Command */
-	for (p = name ; *p; ++p) *p = tolower(*p);
-
 	/* Process Command */
 	smartid_log_debug("Received command '%s'", name);
 
-	for (i = 0; smarti_cmd_table[i].name; i++)
-	{
-		cmd = & smarti_cmd_table[i];
-
-		if (strncasecmp(name, cmd->name, name_len) == 0)
-		{
-			smartid_log_debug("Running command '%s'", name);
-			cmd->func(c, cmd, params);
-			break;
-		}
-	}
-
-	if (! cmd || ! cmd->name)
+	cmd = smartid_cmd_lookup(name, name_len);
+	if (! cmd)
 	{
 		smartid_log_warning("Received unknown command '%s' from %s", name, smartid_conn_client(c));
-		smartid_conn_send_responsef(c, SMARTI_ERROR_UNKNOWN_COMMAND, "Unknown Command '%s'", cmd);
+		smartid_conn_send_responsef(c, SMARTI_ERROR_UNKNOWN_COMMAND, "Unknown Command '%s'", name);
+		return;
 	}
+
+	smartid_log_debug("Running command '%s'", cmd->name);
+	if (cmd->flags & SMARTID_CMD_DEVICE)
+		smartid_cmd_queue(c, cmd, params);
+	else
+		cmd->func(c, cmd, params);
 }
 
 #define CHECK_CMD \
@@ -237,27 +368,16 @@ static void smartid_cmd_close(smarti_conn_t c, struct smarti_cmd_t * cmd, const
 static void smartid_cmd_enum(smarti_conn_t c, struct smarti_cmd_t * cmd, const char * params)
 {
 	int nd;
-	irda_t s;
-	struct irda_dev_info_t * list = 0;
-	struct irda_dev_info_t * it = 0;
 
 	CHECK_CMD
 	CHECK_NO_PARAMS
 
-	s = smartid_conn_irda(c);
-	if (! s)
-	{
-		smartid_conn_send_response(c, SMARTI_ERROR_IRDA, "IrDA subsystem error");
-		smartid_log_warning("No IrDA socket open in smartid_cmd_enum()");
-		return;
-	}
-
-	/* Enumerate Devices */
-	nd = irda_socket_discover(s, irda_enum_cb, & list);
+	/* Enumerate Devices, which are Reported by the Callback */
+	nd = smartid_devmgr_discover(irda_enum_cb, c);
 	if (nd < 0)
 	{
 		smartid_conn_send_response(c, SMARTI_ERROR_IRDA, "IrDA subsystem error");
-		smartid_log_warning("No IrDA socket open in smartid_cmd_enum()");
+		smartid_log_warning("IrDA discovery failed in smartid_cmd_enum()");
 		return;
 	}
 
@@ -268,22 +388,6 @@ static void smartid_cmd_enum(smarti_conn_t c, struct smarti_cmd_t * cmd, const c
 		smartid_log_debug("No IrDA devices found for ENUM command");
 		return;
 	}
-
-	/* Generate Return Information */
-	for (it = list; it; it = it->next)
-	{
-		smartid_conn_send_responsef(c, SMARTI_STATUS_INFO, "Device: %lu %s", it->addr, it->name);
-	}
-
-	/* Free Connection List */
-	while (list)
-	{
-		it = list->next;
-		if (list->name)
-			free(list->name);
-		free(list);
-		list = it;
-	}
 }
 
 static void smartid_cmd_help(smarti_conn_t c, struct smarti_cmd_t * cmd, const char * params)
@@ -295,9 +399,7 @@ static void smartid_cmd_help(smarti_conn_t c, struct smarti_cmd_t * cmd, const c
 
 	for (i = 0; smarti_cmd_table[i].name; i++)
 	{
-		char buf[251];
-		snprintf(buf, 250, "%s\t%s", smarti_cmd_table[i].name, smarti_cmd_table[i].desc);
-		smartid_conn_send_response(c, SMARTI_STATUS_INFO, buf);
+		smartid_conn_send_responsef(c, SMARTI_STATUS_INFO, "%s\t%s", smarti_cmd_table[i].name, smarti_cmd_table[i].desc);
 	}
 
 }
@@ -344,6 +446,7 @@ static void smartid_cmd_open(smarti_conn_t c, struct smarti_cmd_t * cmd, const c
 	unsigned int lsap = 1;
 	size_t chunk_size = 8;
 	smart_device_t dev = 0;
+	irda_t s;
 
 	CHECK_CMD
 	CHECK_PARAMS
@@ -361,14 +464,26 @@ static void smartid_cmd_open(smarti_conn_t c, struct smarti_cmd_t * cmd, const c
 	if (sscanf(params, "%u %u %u", & addr, & lsap, & chunk_size) < 1)
 #endif
 	{
+		smartid_devmgr_release(c);
 		smartid_conn_send_responsef(c, SMARTI_ERROR_INVALID_COMMAND, "Invalid device address '%s'", params);
 		smartid_log_warning("Syntax error in command '%s': invalid parameter", cmd->name);
 		return;
 	}
 
-	dev = smartid_dev_alloc(smartid_conn_irda(c));
+	/* The Connection now holds the IrDA Adapter, which Opens its Socket */
+	s = smartid_devmgr_socket(c);
+	if (! s)
+	{
+		smartid_devmgr_release(c);
+		smartid_conn_send_response(c, SMARTI_ERROR_IRDA, "IrDA subsystem error");
+		smartid_log_warning("No IrDA socket leased in smartid_cmd_open()");
+		return;
+	}
+
+	dev = smartid_dev_alloc(s);
 	if (! dev)
 	{
+		smartid_devmgr_release(c);
 		smartid_conn_send_response(c, SMARTI_ERROR_INTERNAL, "Failed to allocate storage");
 		return;
 	}
@@ -400,6 +515,7 @@ static void smartid_cmd_open(smarti_conn_t c, struct smarti_cmd_t * cmd, const c
 		}
 
 		smartid_dev_dispose(dev);
+		smartid_devmgr_release(c);
 		return;
 	}
 
@@ -408,6 +524,49 @@ static void smartid_cmd_open(smarti_conn_t c, struct smarti_cmd_t * cmd, const c
 	smartid_log_info("Connected to %lu [lsap: %lu, chunk_size: %lu, client: %s]", addr, lsap, chunk_size, smartid_conn_client(c));
 }
 
+static void smartid_cmd_option(smarti_conn_t c, struct smarti_cmd_t * cmd, const char * params)
+{
+	int n;
+	char enc[16];
+	char comp[16];
+	char extra[2];
+
+	CHECK_CMD
+	CHECK_PARAMS
+
+	/* Parameters are the Transfer Encoding and an optional Compression */
+	n = sscanf(params, "%15s %15s %1s", enc, comp, extra);
+
+	if ((n == 1) && (strcasecmp(enc, "base64") == 0))
+	{
+		smartid_conn_set_binary(c, 0);
+		smartid_conn_set_compress(c, 0);
+		smartid_conn_send_response(c, SMARTI_STATUS_SUCCESS, "Base 64 Transfers Enabled");
+	}
+	else if ((n == 1) && (strcasecmp(enc, "binary") == 0))
+	{
+		smartid_conn_set_binary(c, 1);
+		smartid_conn_set_compress(c, 0);
+		smartid_conn_send_response(c, SMARTI_STATUS_SUCCESS, "Binary Transfers Enabled");
+	}
+#ifdef HAVE_ZLIB
+	else if ((n == 2) && (strcasecmp(enc, "binary") == 0) && (strcasecmp(comp, SMARTI_CAP_DEFLATE) == 0))
+	{
+		smartid_conn_set_binary(c, 1);
+		smartid_conn_set_compress(c, 1);
+		smartid_conn_send_response(c, SMARTI_STATUS_SUCCESS, "Compressed Binary Transfers Enabled");
+	}
+#endif
+	else
+	{
+		smartid_conn_send_responsef(c, SMARTI_ERROR_INVALID_COMMAND, "Unknown option '%s'", params);
+		smartid_log_warning("Syntax error in command '%s': unknown option '%s'", cmd->name, params);
+		return;
+	}
+
+	smartid_log_debug("Set option %s for %s", params, smartid_conn_client(c));
+}
+
 static void smartid_cmd_serial(smarti_conn_t c, struct smarti_cmd_t * cmd, const char * params)
 {
 	int rv;
@@ -545,47 +704,137 @@ static void smartid_cmd_token(smarti_conn_t c, struct smarti_cmd_t * cmd, const
 	smartid_conn_send_response(c, SMARTI_STATUS_SUCCESS, "Token Set");
 }
 
+/* Report a Transfer Error, returning Non-Zero if the Device should be Closed */
+static int smartid_xfer_error(smarti_conn_t c, int rv)
+{
+	switch (rv)
+	{
+	case SMARTI_STATUS_NO_DATA:
+		smartid_conn_send_response(c, rv, "No Data");
+		return 0;
+
+	case SMARTI_ERROR_TIMEOUT:
+		smartid_conn_send_response(c, rv, "Timeout on Smart Device");
+		return 1;
+
+	case SMARTI_ERROR_IO:
+		smartid_conn_send_response(c, rv, "Device I/O error");
+		return 1;
+
+	case SMARTI_ERROR_DEVICE:
+		smartid_conn_send_response(c, rv, "Device Error");
+		return 0;
+
+	default:
+		smartid_conn_send_responsef(c, SMARTI_ERROR_INTERNAL, "Internal Error (code %d)", rv);
+		return 1;
+	}
+}
+
 static void smartid_cmd_xfer(smarti_conn_t c, struct smarti_cmd_t * cmd, const char * params)
 {
-	int rv;
-	uint8_t * buffer;
+	int rv = 0;
+	int mode = SMARTID_XFER_BASE64;
+	uint8_t chunk[256];
+	uint8_t * buf = 0;
+	uint8_t * p;
 	uint32_t size;
+	uint32_t n;
 
 	CHECK_CMD
-	CHECK_NO_PARAMS
+
+	if (params)
+	{
+		if (strcasecmp(params, "chunked") != 0)
+		{
+			smartid_conn_send_responsef(c, SMARTI_ERROR_INVALID_COMMAND, "Syntax error in %s", cmd->name);
+			smartid_log_warning("Syntax error in command '%s': unknown parameter '%s'", cmd->name, params);
+			return;
+		}
+
+		mode = SMARTID_XFER_CHUNKED;
+	}
+
+	/* Binary Frames replace either Base 64 Encoding once Negotiated */
+	if (smartid_conn_binary(c))
+		mode = smartid_conn_compress(c) ? SMARTID_XFER_DEFLATE : SMARTID_XFER_BINARY;
+
 	CHECK_DEVICE
 
-	rv = smartid_dev_xfer_data(smartid_conn_device(c), & buffer, & size);
+	rv = smartid_dev_xfer_begin(smartid_conn_device(c), & size);
 	if (rv != 0)
 	{
-		switch (rv)
+		if (smartid_xfer_error(c, rv))
 		{
-		case SMARTI_STATUS_NO_DATA:
-			smartid_conn_send_response(c, rv, "No Data");
+			smartid_dev_dispose(smartid_conn_device(c));
+			smartid_conn_set_device(c, 0);
+		}
+
+		return;
+	}
+
+	/*
+	 * A plain Base 64 transfer is a single line of the promised length with
+	 * no status after it, so device errors must be reported before the 301.
+	 * It is read whole first; the other modes end with a status line and are
+	 * streamed to the client as the data is read.
+	 */
+	if (mode == SMARTID_XFER_BASE64)
+	{
+		buf = (uint8_t *)malloc(size);
+		if (! buf)
+		{
+			smartid_log_warning("Failed to allocate %lu bytes for transfer buffer", size);
+			smartid_conn_send_response(c, SMARTI_ERROR_INTERNAL, "Failed to allocate storage");
+			smartid_dev_dispose(smartid_conn_device(c));
+			smartid_conn_set_device(c, 0);
 			return;
+		}
+	}
+	else
+	{
+		smartid_conn_xfer_begin(c, size, mode);
+	}
 
-		case SMARTI_ERROR_TIMEOUT:
-			smartid_conn_send_response(c, rv, "Timeout on Smart Device");
+	p = buf;
+	while ((smartid_dev_xfer_left(smartid_conn_device(c)) > 0) && ! smartid_conn_aborted(c))
+	{
+		n = buf ? smartid_dev_xfer_left(smartid_conn_device(c)) : sizeof(chunk);
+		rv = smartid_dev_xfer_read(smartid_conn_device(c), buf ? p : chunk, & n);
+		if (rv != 0)
 			break;
 
-		case SMARTI_ERROR_IO:
-			smartid_conn_send_response(c, rv, "Device I/O error");
-			break;
+		if (buf)
+			p += n;
+		else
+			smartid_conn_xfer_data(c, chunk, n);
+	}
 
-		case SMARTI_ERROR_DEVICE:
-			smartid_conn_send_response(c, rv, "Device Error");
-			return;
+	if (! buf)
+		smartid_conn_xfer_end(c);
+	else if ((rv == 0) && (smartid_dev_xfer_left(smartid_conn_device(c)) == 0))
+		smartid_conn_send_buffer(c, buf, size);
 
-		default:
-			smartid_conn_send_responsef(c, SMARTI_ERROR_INTERNAL, "Internal Error (code %d)", rv);
+	free(buf);
 
+	if (rv != 0)
+	{
+		if (smartid_xfer_error(c, rv))
+		{
+			smartid_dev_dispose(smartid_conn_device(c));
+			smartid_conn_set_device(c, 0);
 		}
 
-		smartid_dev_dispose(smartid_conn_device(c));
-		smartid_conn_set_device(c, 0);
 		return;
 	}
 
-	smartid_conn_send_buffer(c, buffer, size);
-	free(buffer);
+	/* The Client has Gone or the Server is Stopping */
+	if (smartid_dev_xfer_left(smartid_conn_device(c)) > 0)
+	{
+		smartid_log_warning("Abandoned transfer for %s", smartid_conn_client(c));
+		return;
+	}
+
+	if (mode != SMARTID_XFER_BASE64)
+		smartid_conn_send_response(c, SMARTI_STATUS_SUCCESS, "Transfer Complete");
 }
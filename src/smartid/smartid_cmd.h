@@ -48,8 +48,9 @@
  * @param[in] Command Length
  *
  * Process a command line from the client, including parsing the command line,
- * dispatching to a handler function, and sending a reply to the client.
+ * dispatching to a handler function, and sending a reply to the client.  The
+ * line is tokenized in place and must not be used again once this returns.
  */
-void smartid_cmd_process(smarti_conn_t conn, const char * cmd_line, size_t cmd_len);
+void smartid_cmd_process(smarti_conn_t conn, char * cmd_line, size_t cmd_len);
 
 #endif /* SMARTI_CMD_H_ */
@@ -34,29 +34,69 @@
  * @author Jonathan Krauss <jkrauss@asymworks.com>
  */
 
+#include <errno.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 
 #include <netinet/in.h>				// INET6_ADDRSTRLEN
+#include <poll.h>
 
 #include <event2/buffer.h>
 #include <event2/bufferevent.h>
 #include <event2/event.h>
 #include <event2/util.h>
 
-#include <common-irda/irda.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 #include <benthos/divecomputer/base64.h>
 #include <benthos/smarti/smarti_codes.h>
 
 #include "smartid_cmd.h"
 #include "smartid_conn.h"
+#include "smartid_devmgr.h"
 #include "smartid_device.h"
 #include "smartid_logging.h"
 #include "smartid_version.h"
+#include "smartid_worker.h"
+
+//! Input Block Size for Base 64 Encoding (encodes to 4 KiB)
+#define SMARTID_B64_BLOCK		3072
+
+//! Pending Output which is Written to the Socket during a Transfer
+#define SMARTID_XFER_PUSH		4096
+
+//! Queued Output above which a Transfer Waits for the Client to Read
+#define SMARTID_XFER_HIGH		65536
+
+//! Seconds a Transfer Waits for a Client which has Stopped Reading
+#define SMARTID_XFER_STALL		60
+
+//! Largest Frame in a Binary Transfer
+#define SMARTID_BIN_FRAME		4096
+
+//! Compression Level for Deflate Transfers
+#define SMARTID_DEFLATE_LEVEL	6
+
+//! Client Read Timeout in Seconds
+#define SMARTID_READ_TIMEOUT	300
+
+//! Longest Command Line accepted from a Client
+#define SMARTID_MAX_LINE		256
+
+//! Per-Connection Command Arena Size
+#define SMARTID_ARENA_SIZE		2048
+
+//! Command Arena Allocation Alignment
+#define SMARTID_ARENA_ALIGN		sizeof(void *)
+
+//! Disposed Connections kept for Reuse
+#define SMARTID_CONN_POOL		8
 
 /**
  * Connection State Structure
@@ -66,7 +106,8 @@
  * list for multiple connections.
  *
  * Allocate this structure with smarti_conn_alloc() and free by calling
- * smarti_conn_dispose().
+ * smarti_conn_dispose().  Disposed connections are kept on a free list and
+ * reused, together with their compressor state.
  */
 struct smarti_conn_t_
 {
@@ -74,13 +115,33 @@ struct smarti_conn_t_
 	int			shutdown;					///< Whether the socket has shut down
 	char 		addr[INET6_ADDRSTRLEN];		///< Client IP Address
 
-	irda_t					irda;			///< IrDA Socket Handle
 	smart_device_t			dev;			///< Smart Device Handle
 
 	struct event_base *		ev_loop;		///< Server Event Loop
 	struct evbuffer *		ev_buffer;		///< Connection Event Buffer
 	struct bufferevent *	ev_evt;			///< Connection Buffer Event
 
+	int						busy;			///< A Command is Running on a Worker Thread
+	int						in_read;		///< Commands are being Read from the Client
+	int						closing;		///< Client has Gone while a Command was Running
+	int						discard;		///< Dropping the Rest of an Overlong Line
+
+	int						binary;			///< Client has Enabled Binary Transfers
+	int						compress;		///< Client has Enabled Compressed Transfers
+
+	base64_encoder_t		xfer_enc;		///< Transfer Data Encoder
+	int						xfer_mode;		///< Transfer Data Encoding
+	size_t					xfer_line;		///< Bytes in the Current Line or Frame
+	uint8_t					xfer_frame[SMARTID_BIN_FRAME];	///< Pending Binary Frame
+
+#ifdef HAVE_ZLIB
+	z_stream				xfer_zs;		///< Transfer Data Compressor
+	int						xfer_zinit;		///< Compressor has been Initialized
+#endif
+
+	size_t					arena_used;		///< Bytes Allocated from the Command Arena
+	char					arena[SMARTID_ARENA_SIZE];		///< Command Arena
+
 	struct smarti_conn_t_ *	prev;			///< Previous Connection in List
 	struct smarti_conn_t_ *	next;			///< Next Connection in List
 };
@@ -89,6 +150,37 @@ struct smarti_conn_t_
 static struct smarti_conn_t_	g_conn_head = { .next = 0 };
 static smarti_conn_t 			g_conn_list = & g_conn_head;
 
+//! Disposed Connections kept for Reuse (linked through next)
+static smarti_conn_t			g_conn_pool = 0;
+static int						g_conn_npool = 0;
+
+// Reset a new or Reused Connection, keeping its Output Buffer and Compressor
+static void conn_reset(smarti_conn_t c)
+{
+	struct evbuffer * out = c->ev_buffer;
+
+	/* Fields from the Frame Buffer on are Reset below or Kept */
+	memset(c, 0, offsetof(struct smarti_conn_t_, xfer_frame));
+	c->ev_buffer = out;
+	c->arena_used = 0;
+	c->prev = 0;
+	c->next = 0;
+}
+
+// Free a Connection Instance
+static void conn_free(smarti_conn_t c)
+{
+	if (c->ev_buffer)
+		evbuffer_free(c->ev_buffer);
+
+#ifdef HAVE_ZLIB
+	if (c->xfer_zinit)
+		deflateEnd(& c->xfer_zs);
+#endif
+
+	free(c);
+}
+
 // Add a Connection to the Connection List
 void conn_add(smarti_conn_t c)
 {
@@ -130,8 +222,10 @@ void conn_shutdown(smarti_conn_t c)
 static void conn_read(struct bufferevent * e, void * arg)
 {
 	smarti_conn_t conn = (smarti_conn_t)(arg);
+	struct evbuffer * in;
+	struct evbuffer_ptr eol;
+	size_t eol_len;
 	char * cmd_line;
-	size_t cmd_len;
 
 	if (! conn)
 	{
@@ -139,18 +233,72 @@ static void conn_read(struct bufferevent * e, void * arg)
 		return;
 	}
 
-	if (! conn->shutdown)
+	/*
+	 * While a command is running on a worker thread the connection belongs to
+	 * that thread, and further commands are left in the input buffer until
+	 * smartid_conn_resume() is called.
+	 */
+	in = bufferevent_get_input(e);
+	conn->in_read = 1;
+
+	while (! conn->shutdown && ! conn->busy)
 	{
-		cmd_line = evbuffer_readln(bufferevent_get_input(e), & cmd_len, EVBUFFER_EOL_ANY);
-		if (cmd_line)
+		eol = evbuffer_search_eol(in, NULL, & eol_len, EVBUFFER_EOL_ANY);
+
+		/* Drop the Rest of an Overlong Line, which was Answered Already */
+		if (conn->discard)
 		{
-			smartid_log_debug("Received '%s' from %s", cmd_line, conn->addr);
-			smartid_cmd_process(conn, cmd_line, cmd_len);
-			free(cmd_line);
+			if (eol.pos < 0)
+			{
+				evbuffer_drain(in, evbuffer_get_length(in));
+				break;
+			}
+
+			evbuffer_drain(in, (size_t)eol.pos + eol_len);
+			conn->discard = 0;
+			continue;
 		}
 
-		smartid_conn_flush(conn);
+		if ((eol.pos < 0) && (evbuffer_get_length(in) <= SMARTID_MAX_LINE))
+			break;
+
+		/*
+		 * Discard Lines too long to be a Command with a single error.  When
+		 * the end of the line has not arrived yet, the remainder is dropped
+		 * as it comes in so it is not answered as another command.
+		 */
+		if ((eol.pos < 0) || (eol.pos > SMARTID_MAX_LINE))
+		{
+			smartid_log_warning("Discarding overlong command line from %s", conn->addr);
+			smartid_conn_send_response(conn, SMARTI_ERROR_INVALID_COMMAND, "Command Line Too Long");
+
+			if (eol.pos < 0)
+			{
+				evbuffer_drain(in, evbuffer_get_length(in));
+				conn->discard = 1;
+				break;
+			}
+
+			evbuffer_drain(in, (size_t)eol.pos + eol_len);
+			continue;
+		}
+
+		/* Tokenize the Line in Place, terminating it over the End of Line */
+		cmd_line = (char *)evbuffer_pullup(in, eol.pos + eol_len);
+		cmd_line[eol.pos] = 0;
+
+		smartid_log_debug("Received '%s' from %s", cmd_line, conn->addr);
+
+		conn->arena_used = 0;
+		smartid_cmd_process(conn, cmd_line, eol.pos);
+
+		evbuffer_drain(in, eol.pos + eol_len);
 	}
+
+	conn->in_read = 0;
+
+	if (! conn->busy)
+		smartid_conn_flush(conn);
 }
 
 // Connection Socket Event Callback
@@ -183,55 +331,53 @@ static void conn_event(struct bufferevent * e, short err, void * arg)
 		return;
 	}
 
-	// Close the Connection
+	// Close the Connection once any Running Command has Finished
+	if (conn->busy)
+	{
+		bufferevent_disable(e, EV_READ | EV_WRITE);
+		conn->closing = 1;
+		return;
+	}
+
 	smartid_conn_dispose(conn);
 }
 
 smarti_conn_t smartid_conn_alloc(int sockfd, const char * client_addr, struct event_base * evloop)
 {
-	int rv;
 	smarti_conn_t ret;
-	struct timeval	tv_read = { .tv_sec = 300, .tv_usec = 0 };
+	struct timeval	tv_read = { .tv_sec = SMARTID_READ_TIMEOUT, .tv_usec = 0 };
 
-	/* Allocate a new Connection Instance */
-	ret = (smarti_conn_t)malloc(sizeof(struct smarti_conn_t_));
-	if (! ret)
+	/* Reuse a Disposed Connection Instance, or Allocate a new one */
+	if (g_conn_pool)
 	{
-		smartid_log_error("Failed to allocate memory for smarti_conn_t");
-		return 0;
+		ret = g_conn_pool;
+		g_conn_pool = ret->next;
+		g_conn_npool--;
+	}
+	else
+	{
+		ret = (smarti_conn_t)malloc(sizeof(struct smarti_conn_t_));
+		if (! ret)
+		{
+			smartid_log_error("Failed to allocate memory for smarti_conn_t");
+			return 0;
+		}
+
+		memset(ret, 0, sizeof(struct smarti_conn_t_));
 	}
 
 	/* Setup the New Instance */
-	memset(ret, 0, sizeof(struct smarti_conn_t_));
+	conn_reset(ret);
 	ret->net_fd = sockfd;
-	ret->irda = 0;
 	ret->dev = 0;
 	ret->ev_loop = evloop;
 	strncpy(ret->addr, client_addr, INET6_ADDRSTRLEN);
 
-	/* Create the IrDA Socket */
-	rv = irda_socket_open(& ret->irda);
-	if (rv != 0)
-	{
-		smartid_log_error("Failed to open IrDA handle (code %d: %s)", irda_errcode(), irda_errmsg());
-		smartid_conn_dispose(ret);
-		return 0;
-	}
-
-	/* Set IrDA Socket Timeout */
-	rv = irda_socket_set_timeout(ret->irda, 2000);
-	if (rv != 0)
-	{
-		smartid_log_error("Failed to set IrDA socket timeout (code %d: %s)", irda_errcode(), irda_errmsg());
-		smartid_conn_dispose(ret);
-		return 0;
-	}
-
 	/* Add to the Global Connection List */
 	conn_add(ret);
 
 	/* Setup the Input Buffer Event */
-	ret->ev_evt = bufferevent_socket_new(evloop, sockfd, 0);
+	ret->ev_evt = bufferevent_socket_new(evloop, sockfd, BEV_OPT_THREADSAFE);
 	if (! ret->ev_evt)
 	{
 		smartid_log_error("Failed to allocate bufferevent for %s", client_addr);
@@ -251,7 +397,8 @@ smarti_conn_t smartid_conn_alloc(int sockfd, const char * client_addr, struct ev
 	}
 
 	/* Setup the Output Buffer */
-	ret->ev_buffer = evbuffer_new();
+	if (! ret->ev_buffer)
+		ret->ev_buffer = evbuffer_new();
 	if (! ret->ev_buffer)
 	{
 		smartid_log_error("Failed to enable buffered I/O for %s", client_addr);
@@ -274,25 +421,28 @@ void smartid_conn_dispose(smarti_conn_t c)
 		return;
 	}
 
-	/* Remove the Connection from the List */
-	if (c->prev->next == c)
-	{
-		c->prev->next = c->next;
-	}
-	else
-	{
-		smartid_log_warning("Bug: Socket list is inconsistent (c->prev->next != c)");
-	}
-
-	if (c->next)
+	/* Remove the Connection from the List, unless Setup Failed before it was Added */
+	if (c->prev)
 	{
-		if (c->next->prev == c)
+		if (c->prev->next == c)
 		{
-			c->next->prev = c->prev;
+			c->prev->next = c->next;
 		}
 		else
 		{
-			smartid_log_warning("Bug: Socket list is inconsistent (c->next->prev != c)");
+			smartid_log_warning("Bug: Socket list is inconsistent (c->prev->next != c)");
+		}
+
+		if (c->next)
+		{
+			if (c->next->prev == c)
+			{
+				c->next->prev = c->prev;
+			}
+			else
+			{
+				smartid_log_warning("Bug: Socket list is inconsistent (c->next->prev != c)");
+			}
 		}
 	}
 
@@ -300,28 +450,47 @@ void smartid_conn_dispose(smarti_conn_t c)
 	if (c->dev)
 		smartid_dev_dispose(c->dev);
 
+	smartid_devmgr_cancel(c);
+	smartid_devmgr_release(c);
+
 	if (c->ev_buffer)
-		evbuffer_free(c->ev_buffer);
+		evbuffer_drain(c->ev_buffer, evbuffer_get_length(c->ev_buffer));
 	if (c->ev_evt)
 		bufferevent_free(c->ev_evt);
 
-	if (c->irda)
-		irda_socket_close(c->irda);
-
 	if (c->net_fd != -1)
 	{
 		conn_shutdown(c);
 		close(c->net_fd);
 	}
 
-	/* Free Connection */
-	free(c);
+	/* Keep the Connection for Reuse */
+	if (g_conn_npool < SMARTID_CONN_POOL)
+	{
+		c->next = g_conn_pool;
+		g_conn_pool = c;
+		g_conn_npool++;
+		return;
+	}
+
+	conn_free(c);
 }
 
 void smartid_conn_cleanup(void)
 {
+	smarti_conn_t c;
+
 	while (g_conn_list->next)
 		smartid_conn_dispose(g_conn_list->next);
+
+	while (g_conn_pool)
+	{
+		c = g_conn_pool;
+		g_conn_pool = c->next;
+		conn_free(c);
+	}
+
+	g_conn_npool = 0;
 }
 
 void smartid_conn_send_response(smarti_conn_t conn, uint16_t code, const char * msg)
@@ -341,7 +510,7 @@ void smartid_conn_send_response(smarti_conn_t conn, uint16_t code, const char *
 void smartid_conn_send_responsef(smarti_conn_t conn, uint16_t code, const char * msg, ...)
 {
 	va_list args;
-	char buf[2048];
+	int rv;
 
 	if (! conn)
 	{
@@ -349,47 +518,334 @@ void smartid_conn_send_responsef(smarti_conn_t conn, uint16_t code, const char *
 		return;
 	}
 
+	/* Format straight into the Output Buffer */
 	va_start(args, msg);
-	vsnprintf(buf, 2047, msg, args);
+	rv = evbuffer_add_printf(conn->ev_buffer, "%d ", code);
+	if (rv >= 0)
+		rv = evbuffer_add_vprintf(conn->ev_buffer, msg, args);
+	if (rv >= 0)
+		rv = evbuffer_add(conn->ev_buffer, "\n", 1);
 	va_end(args);
 
-	smartid_conn_send_response(conn, code, buf);
+	if (rv < 0)
+	{
+		smartid_log_error("Failed to send data to %s", conn->addr);
+	}
 }
 
-void smartid_conn_send_buffer(smarti_conn_t conn, void * data, size_t len)
+/*
+ * Write pending output straight to the socket.  Without worker threads the
+ * transfer runs inside the read callback, so the event loop cannot drain the
+ * output buffer until it is complete; with workers, pushing from the worker
+ * saves waking the event loop for every block.  Either way the client is kept
+ * busy while the device is read.
+ *
+ * A client slower than the IrDA link would otherwise have the whole encoded
+ * transfer queued for it, so once more than SMARTID_XFER_HIGH bytes are left
+ * the transfer waits for the socket to take more.  A client which reads
+ * nothing for SMARTID_XFER_STALL seconds is treated as gone.
+ */
+static void conn_push(smarti_conn_t conn)
+{
+	struct evbuffer * out;
+	struct pollfd pfd;
+	size_t left;
+	int rv;
+
+	smartid_conn_flush(conn);
+
+	for (;;)
+	{
+		bufferevent_lock(conn->ev_evt);
+
+		out = bufferevent_get_output(conn->ev_evt);
+		while (evbuffer_get_length(out) > 0)
+		{
+			if (evbuffer_write(out, conn->net_fd) <= 0)
+				break;
+		}
+
+		left = evbuffer_get_length(out);
+		bufferevent_unlock(conn->ev_evt);
+
+		if ((left < SMARTID_XFER_HIGH) || smartid_conn_aborted(conn))
+			return;
+
+		/* Wait for the Client to Read, without the Buffer Event Locked */
+		pfd.fd = conn->net_fd;
+		pfd.events = POLLOUT;
+		pfd.revents = 0;
+
+		rv = poll(& pfd, 1, SMARTID_XFER_STALL * 1000);
+		if ((rv < 0) && (errno == EINTR))
+			continue;
+
+		if ((rv <= 0) || (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)))
+		{
+			smartid_log_warning("Remote host at %s stopped reading the transfer", conn->addr);
+
+			/* Close the Connection once the Command Returns */
+			bufferevent_lock(conn->ev_evt);
+			if (conn->busy)
+			{
+				bufferevent_disable(conn->ev_evt, EV_READ | EV_WRITE);
+				conn->closing = 1;
+			}
+			bufferevent_unlock(conn->ev_evt);
+
+			return;
+		}
+	}
+}
+
+/* Queue a Binary Transfer Frame with its Length Prefix */
+static void conn_send_frame(smarti_conn_t conn, const void * data, size_t len)
+{
+	uint8_t hdr[4];
+
+	hdr[0] = (len >> 24) & 0xff;
+	hdr[1] = (len >> 16) & 0xff;
+	hdr[2] = (len >> 8) & 0xff;
+	hdr[3] = len & 0xff;
+
+	evbuffer_add(conn->ev_buffer, hdr, 4);
+	if (len)
+		evbuffer_add(conn->ev_buffer, data, len);
+}
+
+#ifdef HAVE_ZLIB
+/* Prepare the Compressor, which is kept for the Connection and Reset per Transfer */
+static int conn_deflate_begin(smarti_conn_t conn)
+{
+	if (conn->xfer_zinit)
+		return (deflateReset(& conn->xfer_zs) == Z_OK) ? 0 : -1;
+
+	memset(& conn->xfer_zs, 0, sizeof(z_stream));
+	if (deflateInit(& conn->xfer_zs, SMARTID_DEFLATE_LEVEL) != Z_OK)
+		return -1;
+
+	conn->xfer_zinit = 1;
+	return 0;
+}
+
+/* Compress Transfer Data into the Pending Frame, sending each Frame as it fills */
+static void conn_deflate(smarti_conn_t conn, const unsigned char * data, size_t len, int flush)
 {
-	char * b64data;
-	char * b64line;
-	size_t b64len;
+	int rv;
+
+	conn->xfer_zs.next_in = (Bytef *)data;
+	conn->xfer_zs.avail_in = len;
 
+	do
+	{
+		conn->xfer_zs.next_out = conn->xfer_frame + conn->xfer_line;
+		conn->xfer_zs.avail_out = SMARTID_BIN_FRAME - conn->xfer_line;
+
+		rv = deflate(& conn->xfer_zs, flush);
+		if (rv == Z_STREAM_ERROR)
+		{
+			smartid_log_error("Failed to compress transfer data for %s", conn->addr);
+			return;
+		}
+
+		conn->xfer_line = SMARTID_BIN_FRAME - conn->xfer_zs.avail_out;
+		if (conn->xfer_line == SMARTID_BIN_FRAME)
+		{
+			conn_send_frame(conn, conn->xfer_frame, SMARTID_BIN_FRAME);
+			conn->xfer_line = 0;
+		}
+	}
+	while ((conn->xfer_zs.avail_in > 0) || ((flush == Z_FINISH) && (rv != Z_STREAM_END)));
+}
+#endif
+
+void smartid_conn_xfer_begin(smarti_conn_t conn, uint32_t len, int mode)
+{
 	if (! conn)
 	{
-		smartid_log_error("Invalid smarti_conn_t passed to smartid_conn_send_buffer()");
+		smartid_log_error("Invalid smarti_conn_t passed to smartid_conn_xfer_begin()");
 		return;
 	}
 
-	if (! data || ! len)
+	/* Fall back to Uncompressed Frames if the Compressor is Unavailable */
+	if (mode == SMARTID_XFER_DEFLATE)
 	{
-		smartid_log_warning("Null buffer passed to smartid_conn_send_buffer()");
+#ifdef HAVE_ZLIB
+		if (conn_deflate_begin(conn) != 0)
+		{
+			smartid_log_error("Failed to initialize compressor for %s", conn->addr);
+			mode = SMARTID_XFER_BINARY;
+		}
+#else
+		mode = SMARTID_XFER_BINARY;
+#endif
+	}
+
+	base64_encoder_init(& conn->xfer_enc);
+	conn->xfer_mode = mode;
+	conn->xfer_line = 0;
+
+	switch (mode)
+	{
+	case SMARTID_XFER_DEFLATE:
+		smartid_conn_send_responsef(conn, SMARTI_DATA_FOLLOWS, "Deflate Data Follows: %u", len);
+		break;
+
+	case SMARTID_XFER_BINARY:
+		smartid_conn_send_responsef(conn, SMARTI_DATA_FOLLOWS, "Binary Data Follows: %u", len);
+		break;
+
+	case SMARTID_XFER_CHUNKED:
+		smartid_conn_send_responsef(conn, SMARTI_DATA_CHUNKED, "Data Follows: %u", len);
+		break;
+
+	default:
+		smartid_conn_send_responsef(conn, SMARTI_DATA_FOLLOWS, "Data Follows: %u", (unsigned int)BASE64_ENCODE_BOUND(len));
+	}
+}
+
+void smartid_conn_xfer_data(smarti_conn_t conn, const void * data, size_t len)
+{
+	const unsigned char * p = (const unsigned char *)data;
+	struct evbuffer_iovec v;
+	size_t n;
+
+	if (! conn)
+	{
+		smartid_log_error("Invalid smarti_conn_t passed to smartid_conn_xfer_data()");
 		return;
 	}
 
-	b64data = base64_encode((const unsigned char *)data, len, & b64len);
-	if (! b64data)
+	if (conn->xfer_mode == SMARTID_XFER_DEFLATE)
+	{
+#ifdef HAVE_ZLIB
+		conn_deflate(conn, p, len, Z_NO_FLUSH);
+#endif
+	}
+	else if (conn->xfer_mode == SMARTID_XFER_BINARY)
+	{
+		/* Device reads are small, so Binary Data is gathered into whole Frames */
+		while (len > 0)
+		{
+			n = SMARTID_BIN_FRAME - conn->xfer_line;
+			if (n > len)
+				n = len;
+
+			memcpy(conn->xfer_frame + conn->xfer_line, p, n);
+			conn->xfer_line += n;
+			p += n;
+			len -= n;
+
+			if (conn->xfer_line == SMARTID_BIN_FRAME)
+			{
+				conn_send_frame(conn, conn->xfer_frame, SMARTID_BIN_FRAME);
+				conn->xfer_line = 0;
+			}
+		}
+	}
+	else
+	{
+		while (len > 0)
+		{
+			n = SMARTID_B64_BLOCK - conn->xfer_line;
+			if (n > len)
+				n = len;
+
+			/* Encode directly into the Output Buffer */
+			if (evbuffer_reserve_space(conn->ev_buffer, BASE64_ENCODE_BOUND(n), & v, 1) < 1)
+			{
+				smartid_log_error("Failed to allocate output buffer for %s", conn->addr);
+				return;
+			}
+
+			v.iov_len = base64_encode_update(& conn->xfer_enc, p, n, (char *)v.iov_base);
+			evbuffer_commit_space(conn->ev_buffer, & v, 1);
+
+			p += n;
+			len -= n;
+
+			/* Lines end on a Group Boundary, so each is Decodable by itself */
+			conn->xfer_line += n;
+			if (conn->xfer_line == SMARTID_B64_BLOCK)
+			{
+				if (conn->xfer_mode == SMARTID_XFER_CHUNKED)
+					evbuffer_add(conn->ev_buffer, "\n", 1);
+				conn->xfer_line = 0;
+			}
+		}
+	}
+
+	if (evbuffer_get_length(conn->ev_buffer) >= SMARTID_XFER_PUSH)
+		conn_push(conn);
+}
+
+void smartid_conn_xfer_end(smarti_conn_t conn)
+{
+	char tail[4];
+	size_t n;
+
+	if (! conn)
 	{
-		smartid_log_error("Failed to encode data to base64");
+		smartid_log_error("Invalid smarti_conn_t passed to smartid_conn_xfer_end()");
 		return;
 	}
 
-	smartid_conn_send_responsef(conn, SMARTI_DATA_FOLLOWS, "Data Follows: %u", b64len);
+	switch (conn->xfer_mode)
+	{
+	case SMARTID_XFER_DEFLATE:
+#ifdef HAVE_ZLIB
+		conn_deflate(conn, 0, 0, Z_FINISH);
+#endif
+		/* Fall Through */
+
+	case SMARTID_XFER_BINARY:
+		/* Binary Data ends with a Zero-Length Frame */
+		if (conn->xfer_line)
+			conn_send_frame(conn, conn->xfer_frame, conn->xfer_line);
+		conn_send_frame(conn, 0, 0);
+		break;
+
+	case SMARTID_XFER_CHUNKED:
+		/* Chunked Data ends with a Blank Line */
+		n = base64_encode_final(& conn->xfer_enc, tail);
+		evbuffer_add(conn->ev_buffer, tail, n);
+
+		if (conn->xfer_line)
+			evbuffer_add(conn->ev_buffer, "\n", 1);
+		evbuffer_add(conn->ev_buffer, "\n", 1);
+		break;
+
+	default:
+		n = base64_encode_final(& conn->xfer_enc, tail);
+		evbuffer_add(conn->ev_buffer, tail, n);
+		evbuffer_add(conn->ev_buffer, "\n", 1);
+	}
+
+	conn->xfer_line = 0;
+	conn_push(conn);
+}
 
-	b64line = (char *)malloc(b64len + 1);
-	b64line = strncpy(b64line, b64data, b64len);
-	b64line[b64len] = 0;
+void smartid_conn_send_buffer(smarti_conn_t conn, void * data, size_t len)
+{
+	if (! conn)
+	{
+		smartid_log_error("Invalid smarti_conn_t passed to smartid_conn_send_buffer()");
+		return;
+	}
+
+	if (! data || ! len)
+	{
+		smartid_log_warning("Null buffer passed to smartid_conn_send_buffer()");
+		return;
+	}
 
-	evbuffer_add_printf(conn->ev_buffer, "%s\n", b64line);
+	if (! conn->binary)
+		smartid_conn_xfer_begin(conn, len, SMARTID_XFER_BASE64);
+	else
+		smartid_conn_xfer_begin(conn, len, conn->compress ? SMARTID_XFER_DEFLATE : SMARTID_XFER_BINARY);
 
-	free(b64line);
+	smartid_conn_xfer_data(conn, data, len);
+	smartid_conn_xfer_end(conn);
 }
 
 void smartid_conn_flush(smarti_conn_t conn)
@@ -406,26 +862,105 @@ void smartid_conn_flush(smarti_conn_t conn)
 	}
 }
 
-const char * smartid_conn_client(smarti_conn_t conn)
+void smartid_conn_suspend(smarti_conn_t conn)
 {
 	if (! conn)
 	{
-		smartid_log_error("Invalid smarti_conn_t passed to smartid_conn_client()");
+		smartid_log_error("Invalid smarti_conn_t passed to smartid_conn_suspend()");
+		return;
+	}
+
+	/* Transfers may outlast the Read Timeout */
+	bufferevent_set_timeouts(conn->ev_evt, 0, 0);
+	conn->busy = 1;
+}
+
+void smartid_conn_resume(smarti_conn_t conn)
+{
+	struct timeval tv_read = { .tv_sec = SMARTID_READ_TIMEOUT, .tv_usec = 0 };
+
+	if (! conn)
+	{
+		smartid_log_error("Invalid smarti_conn_t passed to smartid_conn_resume()");
+		return;
+	}
+
+	conn->busy = 0;
+
+	if (conn->closing)
+	{
+		smartid_conn_dispose(conn);
+		return;
+	}
+
+	bufferevent_set_timeouts(conn->ev_evt, & tv_read, 0);
+
+	/* Run Commands which Arrived while Busy, unless conn_read is Active */
+	if (! conn->in_read && ! smartid_worker_stopping())
+		conn_read(conn->ev_evt, conn);
+}
+
+int smartid_conn_aborted(smarti_conn_t conn)
+{
+	int rv;
+
+	if (! conn)
+		return 1;
+
+	/* Set by conn_event(), which runs with the Buffer Event Locked */
+	bufferevent_lock(conn->ev_evt);
+	rv = conn->closing;
+	bufferevent_unlock(conn->ev_evt);
+
+	return rv || smartid_worker_stopping();
+}
+
+void * smartid_conn_arena_alloc(smarti_conn_t conn, size_t size)
+{
+	size_t used;
+
+	if (! conn)
+	{
+		smartid_log_error("Invalid smarti_conn_t passed to smartid_conn_arena_alloc()");
 		return 0;
 	}
 
-	return conn->addr;
+	used = (conn->arena_used + SMARTID_ARENA_ALIGN - 1) & ~(size_t)(SMARTID_ARENA_ALIGN - 1);
+	if ((used > SMARTID_ARENA_SIZE) || (size > SMARTID_ARENA_SIZE - used))
+	{
+		smartid_log_warning("Command arena exhausted for %s", conn->addr);
+		return 0;
+	}
+
+	conn->arena_used = used + size;
+	return conn->arena + used;
 }
 
-irda_t smartid_conn_irda(smarti_conn_t conn)
+char * smartid_conn_arena_strdup(smarti_conn_t conn, const char * s)
+{
+	size_t n;
+	char * p;
+
+	if (! s)
+		return 0;
+
+	n = strlen(s) + 1;
+	p = (char *)smartid_conn_arena_alloc(conn, n);
+	if (p)
+		memcpy(p, s, n);
+
+	return p;
+}
+
+const char * smartid_conn_client(smarti_conn_t conn)
 {
 	if (! conn)
 	{
-		smartid_log_error("Invalid smarti_conn_t passed to smartid_conn_irda()");
+		smartid_log_error("Invalid smarti_conn_t passed to smartid_conn_client()");
 		return 0;
 	}
 
-	return conn->irda;
+	return conn->addr;
 }
 
 smart_device_t smartid_conn_device(smarti_conn_t conn)
@@ -447,5 +982,53 @@ void smartid_conn_set_device(smarti_conn_t conn, smart_device_t dev)
 		return;
 	}
 
+	/* Closing the Device ends the Lease on the IrDA Adapter */
+	if (! dev)
+		smartid_devmgr_release(conn);
+
 	conn->dev = dev;
 }
+
+int smartid_conn_binary(smarti_conn_t conn)
+{
+	if (! conn)
+	{
+		smartid_log_error("Invalid smarti_conn_t passed to smartid_conn_binary()");
+		return 0;
+	}
+
+	return conn->binary;
+}
+
+void smartid_conn_set_binary(smarti_conn_t conn, int binary)
+{
+	if (! conn)
+	{
+		smartid_log_error("Invalid smarti_conn_t passed to smartid_conn_set_binary()");
+		return;
+	}
+
+	conn->binary = binary;
+}
+
+int smartid_conn_compress(smarti_conn_t conn)
+{
+	if (! conn)
+	{
+		smartid_log_error("Invalid smarti_conn_t passed to smartid_conn_compress()");
+		return 0;
+	}
+
+	return conn->compress;
+}
+
+void smartid_conn_set_compress(smarti_conn_t conn, int compress)
+{
+	if (! conn)
+	{
+		smartid_log_error("Invalid smarti_conn_t passed to smartid_conn_set_compress()");
+		return;
+	}
+
+	conn->compress = compress;
+}
@@ -49,6 +49,22 @@
 //! Smart-I Connection Handle
 typedef struct smarti_conn_t_ *		smarti_conn_t;
 
+/**@{
+ * @name Transfer Data Encodings
+ */
+#define SMARTID_XFER_BASE64		0		///< Single Base 64 Line (301)
+#define SMARTID_XFER_CHUNKED	1		///< Separately Decodable Base 64 Lines (302)
+#define SMARTID_XFER_BINARY		2		///< Length-Prefixed Binary Frames (301)
+#define SMARTID_XFER_DEFLATE	3		///< Binary Frames of a Deflate Stream (301)
+/*@}*/
+
+//! Capabilities Advertised in the Greeting
+#ifdef HAVE_ZLIB
+#define SMARTID_CAPS	"[" SMARTI_CAP_BINARY " " SMARTI_CAP_DEFLATE "]"
+#else
+#define SMARTID_CAPS	"[" SMARTI_CAP_BINARY "]"
+#endif
+
 /**
  * @brief Create a new Smart-I Connection
  * @param[in] Client Socket File Descriptor
@@ -103,32 +119,131 @@ void smartid_conn_send_responsef(smarti_conn_t conn, uint16_t code, const char *
  *
  * Sends the contents of a data buffer to the connection, which first sends
  * the status reply "301 Data Follows" followed by the base64-encoded data.
- * The end of the data is signified by a blank line.
+ * The end of the data is signified by a blank line.  If the client has enabled
+ * binary transfers the data is sent as binary frames instead, and the caller
+ * must then send a status reply.
  */
 void smartid_conn_send_buffer(smarti_conn_t conn, void * data, size_t len);
 
+/**
+ * @brief Begin Streaming Transfer Data to the Connection
+ * @param[in] Connection Handle
+ * @param[in] Data Length
+ * @param[in] Transfer Data Encoding (SMARTID_XFER_*)
+ *
+ * Sends the "301 Data Follows" reply for a single base64 line, or for chunked
+ * transfers the "302 Data Follows" reply with the data length in bytes.
+ * Chunked data is sent as base64 lines which each encode up to 3072 bytes and
+ * can be decoded separately, followed by a blank line.
+ *
+ * Binary transfers send "301 Binary Data Follows" with the data length in
+ * bytes, followed by frames of raw data each prefixed with a 4-byte length in
+ * network byte order.  A zero-length frame ends the data.  Deflate transfers
+ * send "301 Deflate Data Follows" with the uncompressed length and frame a
+ * zlib stream in the same way.
+ *
+ * For chunked and binary transfers the caller then sends a status reply for
+ * the whole transfer.
+ */
+void smartid_conn_xfer_begin(smarti_conn_t conn, uint32_t len, int mode);
+
+/**
+ * @brief Stream the next Block of Transfer Data to the Connection
+ * @param[in] Connection Handle
+ * @param[in] Data Buffer Pointer
+ * @param[in] Data Buffer Length
+ *
+ * The data is encoded directly into the connection's output buffer, which is
+ * written to the socket whenever enough has accumulated.
+ */
+void smartid_conn_xfer_data(smarti_conn_t conn, const void * data, size_t len);
+
+/**
+ * @brief Finish Streaming Transfer Data to the Connection
+ * @param[in] Connection Handle
+ *
+ * Terminates the data, including when the transfer was cut short.
+ */
+void smartid_conn_xfer_end(smarti_conn_t conn);
+
 /**
  * @brief Flush the Connection Output Buffer
  * @param[in] Connection Handle
  */
 void smartid_conn_flush(smarti_conn_t conn);
 
+/**
+ * @brief Hand the Connection to a Worker Thread
+ * @param[in] Connection Handle
+ *
+ * Marks the connection busy while a command runs on a worker thread.  No
+ * further commands are read from the client and the connection is not closed
+ * until smartid_conn_resume() is called from the event loop; in the meantime
+ * only the worker may use the connection.
+ */
+void smartid_conn_suspend(smarti_conn_t conn);
+
+/**
+ * @brief Return the Connection to the Event Loop
+ * @param[in] Connection Handle
+ *
+ * Called from the event loop when the command has finished.  If the client
+ * disconnected in the meantime the connection is disposed; otherwise any
+ * commands which arrived while it was busy are run.
+ */
+void smartid_conn_resume(smarti_conn_t conn);
+
+//! @return Non-Zero if a Running Command should Stop Early
+int smartid_conn_aborted(smarti_conn_t conn);
+
+/**
+ * @brief Allocate Memory for the Current Command
+ * @param[in] Connection Handle
+ * @param[in] Allocation Size
+ * @return Pointer to the Memory, or NULL if the Arena is Exhausted
+ *
+ * Each connection has a small arena for data which must outlive parsing of
+ * the command line, such as the parameters of a command queued for a worker.
+ * The arena is reset when the next command line is read, so the memory need
+ * not be freed.
+ */
+void * smartid_conn_arena_alloc(smarti_conn_t conn, size_t size);
+
+//! Copy a String into the Connection Command Arena
+char * smartid_conn_arena_strdup(smarti_conn_t conn, const char * s);
+
 //! @return Connection Client Address
 const char * smartid_conn_client(smarti_conn_t conn);
 
-//! @return Connection IrDA Handle
-irda_t smartid_conn_irda(smarti_conn_t conn);
-
 //! @return Connection Device Handle
 smart_device_t smartid_conn_device(smarti_conn_t conn);
 
-//! Set Connection Device Handle
+/**
+ * @brief Set Connection Device Handle
+ * @param[in] Connection Handle
+ * @param[in] Device Handle, or NULL once the Device has been Disposed
+ *
+ * Clearing the device releases the IrDA adapter held by the connection.
+ */
 void smartid_conn_set_device(smarti_conn_t conn, smart_device_t dev);
 
+//! @return Non-Zero if the Client has Enabled Binary Transfers
+int smartid_conn_binary(smarti_conn_t conn);
+
+//! Enable or Disable Binary Transfers for the Connection
+void smartid_conn_set_binary(smarti_conn_t conn, int binary);
+
+//! @return Non-Zero if the Client has Enabled Compressed Transfers
+int smartid_conn_compress(smarti_conn_t conn);
+
+//! Enable or Disable Compressed (Binary) Transfers for the Connection
+void smartid_conn_set_compress(smarti_conn_t conn, int compress);
+
 //! Send Ready Response
 #define smartid_conn_send_ready(c) \
-	smartid_conn_send_responsef(c, SMARTI_STATUS_READY, "%s %s Ready", \
+	smartid_conn_send_responsef(c, SMARTI_STATUS_READY, "%s %s Ready %s", \
 		SMARTID_APP_TITLE, \
-		SMARTID_VERSION_STRING)
+		SMARTID_VERSION_STRING, \
+		SMARTID_CAPS)
 
 #endif /* SMARTI_CONN_H_ */
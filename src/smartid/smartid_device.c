@@ -42,12 +42,19 @@
 #include <unistd.h>
 
 #include <common-irda/irda.h>
+#include <common-irda/irda_chunk.h>
 
 #include <benthos/smarti/smarti_codes.h>
 
 #include "smartid_device.h"
 #include "smartid_logging.h"
 
+/*
+ * Largest read size the adaptive read size may grow to from the chunk size
+ * given to OPEN, which matches the buffer XFER reads into.
+ */
+#define SMARTID_CHUNK_MAX			256
+
 struct smart_device_t_
 {
 	irda_t			s;			///< IrDA Socket
@@ -55,6 +62,7 @@ struct smart_device_t_
 
 	int				lsap;		///< IrDA LSAP Identifier
 	size_t			csize;		///< IrDA Chunk Size
+	irda_chunk_t	chunk;		///< Adaptive IrDA Read Size
 
 	time_t			epoch;		///< Epoch in Half-Seconds
 	int32_t			tcorr;		///< Time Correction Value
@@ -64,6 +72,7 @@ struct smart_device_t_
 	uint32_t		ticks;		///< Tick Count
 
 	uint32_t		token;		///< Device Token
+	uint32_t		xfer_left;	///< Bytes Remaining in the Current Transfer
 };
 
 int smart_driver_cmd(smart_device_t dev, unsigned char * cmd, ssize_t cmdlen, unsigned char * ans, ssize_t anslen)
@@ -138,33 +147,16 @@ int smart_read_slong(smart_device_t dev, const char * cmd, int32_t * ans)
 	return smart_driver_cmd(dev, (unsigned char *)cmd, strlen(cmd), (unsigned char *)ans, 4);
 }
 
+/*
+ * Smart devices count from 2000-01-01 00:00:00 UTC.  The offset is given
+ * directly rather than found with mktime(), which would mean switching the
+ * process time zone while worker threads may be logging.
+ */
+#define SMART_EPOCH_UNIX		946684800
+
 time_t smart_driver_epoch()
 {
-	struct tm t;
-	memset(& t, 0, sizeof(t));
-	t.tm_year = 100;
-	t.tm_mday = 1;
-
-	char * tz_orig = getenv("TZ");
-	if (tz_orig)
-		tz_orig = strdup(tz_orig);
-
-	setenv("TZ", "UTC", 1);
-	tzset();
-
-	time_t epoch = mktime(& t) * 2;
-
-	if (tz_orig)
-	{
-		setenv("TZ", tz_orig, 1);
-		free(tz_orig);
-	}
-	else
-		unsetenv("TZ");
-
-	tzset();
-
-	return epoch;
+	return (time_t)SMART_EPOCH_UNIX * 2;
 }
 
 int smart_driver_handshake(smart_device_t dev)
@@ -363,21 +355,45 @@ int smartid_dev_xfer_size(smart_device_t dev, uint32_t * size)
 	return smart_driver_cmd(dev, cmd, 9, (unsigned char *)(size), 4);
 }
 
-int smartid_dev_xfer_data(smart_device_t dev, uint8_t ** buf, uint32_t * size)
+/* Bound the Whole Transfer as well as each Read */
+static void smartid_dev_xfer_limit(smart_device_t dev, uint32_t size)
+{
+	irda_socket_reset_stats(dev->s);
+	irda_socket_set_budget(dev->s, size);
+
+	irda_chunk_init(& dev->chunk, 2, SMARTID_CHUNK_MAX, dev->csize);
+}
+
+/* Lift the Transfer Deadline and Log the Read Wait Times */
+static void smartid_dev_xfer_end(smart_device_t dev)
+{
+	irda_stats_t st;
+
+	irda_socket_set_deadline(dev->s, 0);
+
+	if ((irda_socket_stats(dev->s, & st) != 0) || (st.reads == 0))
+		return;
+
+	smartid_log_debug("Read %lu bytes in %lu reads (%lu timed out), wait mean %.2f ms, max %.2f ms",
+		st.bytes, st.reads, st.timeouts, st.wait_us / 1000.0 / st.reads, st.max_wait_us / 1000.0);
+	smartid_log_debug("Transfer rate %lu bytes/s, final read size %u bytes",
+		(unsigned long)dev->chunk.rate, dev->chunk.size);
+}
+
+int smartid_dev_xfer_begin(smart_device_t dev, uint32_t * size)
 {
 	int rv;
 	uint32_t nb;
-	uint32_t pos;
-	uint32_t len;
 	unsigned char cmd[] = { 0xc4, 0, 0, 0, 0, 0x10, 0x27, 0, 0 };
 
-	if (! dev || ! buf)
+	if (! dev || ! size)
 	{
-		smartid_log_error("Null pointer passed to smartid_dev_xfer_data()");
+		smartid_log_error("Null pointer passed to smartid_dev_xfer_begin()");
 		return SMARTI_ERROR_INTERNAL;
 	}
 
 	* (uint32_t *)(& cmd[1]) = dev->token;
+	dev->xfer_left = 0;
 
 	rv = smart_driver_cmd(dev, cmd, 9, (unsigned char *)(& nb), 4);
 	if (rv != 0)
@@ -386,7 +402,6 @@ int smartid_dev_xfer_data(smart_device_t dev, uint8_t ** buf, uint32_t * size)
 	if (nb == 4)
 	{
 		smartid_log_debug("No bytes to transfer from device");
-		* buf = 0;
 		* size = 0;
 		return SMARTI_STATUS_NO_DATA;
 	}
@@ -397,60 +412,64 @@ int smartid_dev_xfer_data(smart_device_t dev, uint8_t ** buf, uint32_t * size)
 		return SMARTI_ERROR_DEVICE;
 	}
 
-	(* size) = nb - 4;
-	(* buf) = malloc(* size);
+	dev->xfer_left = nb - 4;
+	* size = dev->xfer_left;
 
-	if (! (* buf))
+	smartid_dev_xfer_limit(dev, dev->xfer_left);
+
+	return 0;
+}
+
+int smartid_dev_xfer_read(smart_device_t dev, uint8_t * buf, uint32_t * len)
+{
+	int rv;
+	int timeout = 0;
+	size_t nc;
+
+	if (! dev || ! buf || ! len)
 	{
-		smartid_log_warning("Failed to allocate %lu bytes for transfer buffer", * size);
+		smartid_log_error("Null pointer passed to smartid_dev_xfer_read()");
 		return SMARTI_ERROR_INTERNAL;
 	}
 
-	smartid_log_debug("Allocated transfer buffer for %lu bytes", * size);
+	nc = * len;
+	if (nc > dev->xfer_left)
+		nc = dev->xfer_left;
+
+	* len = 0;
+	if (nc == 0)
+		return 0;
+
+	rv = irda_chunk_read(& dev->chunk, dev->s, buf, & nc, & timeout);
+	if (rv != 0)
+	{
+		smartid_log_error("Failed to read from the Uwatec Smart Device (code %d: %s)", errno, strerror(errno));
+		dev->xfer_left = 0;
+		smartid_dev_xfer_end(dev);
+		return SMARTI_ERROR_IO;
+	}
 
-	pos = 0;
-	len = (* size);
-	while (len > 0)
+	if (timeout)
 	{
-		int timeout = 0;
-		size_t nc;
-
-		if (len > dev->csize)
-		{
-			nc = dev->csize;
-		}
-		else
-		{
-			nc = len;
-		}
-
-		rv = irda_socket_read(dev->s, & (* buf)[pos], & nc, & timeout);
-		if (rv != 0)
-		{
-			smartid_log_error("Failed to read from the Uwatec Smart Device (code %d: %s)", errno, strerror(errno));
-			free(buf);
-			* buf = 0;
-			* size = 0;
-			return SMARTI_ERROR_IO;
-		}
-
-		if (timeout)
-		{
-			smartid_log_error("Timed out reading from the Uwatec Smart Device");
-			free(buf);
-			* buf = 0;
-			* size = 0;
-			return SMARTI_ERROR_TIMEOUT;
-		}
-
-		len -= nc;
-		pos += nc;
-
-		/* smartid_log_debug("Transferred chunk: %lu, cum: %lu, tot: %lu, rem: %lu", nc, pos, * size, len); */
+		smartid_log_error("Timed out reading from the Uwatec Smart Device");
+		dev->xfer_left = 0;
+		smartid_dev_xfer_end(dev);
+		return SMARTI_ERROR_TIMEOUT;
 	}
 
-	smartid_log_debug("Transferred %lu bytes", * size);
+	dev->xfer_left -= nc;
+	* len = nc;
+
+	if (dev->xfer_left == 0)
+		smartid_dev_xfer_end(dev);
 
 	return 0;
 }
 
+uint32_t smartid_dev_xfer_left(smart_device_t dev)
+{
+	if (! dev)
+		return 0;
+
+	return dev->xfer_left;
+}
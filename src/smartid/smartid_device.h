@@ -118,12 +118,29 @@ int smartid_dev_set_token(smart_device_t, uint32_t);
 int smartid_dev_xfer_size(smart_device_t, uint32_t *);
 
 /**
- * @brief Get the Dive Data from the Smart Device
+ * @brief Start a Dive Data Transfer from the Smart Device
  * @param[in] Smart Device Handle
- * @param[out] Data Buffer
  * @param[out] Data Size
+ * @return Zero on Success, SMARTI_STATUS_NO_DATA if there are no new dives,
+ * or an error code
+ *
+ * After a successful call the data must be read with smartid_dev_xfer_read()
+ * until smartid_dev_xfer_left() returns zero.
+ */
+int smartid_dev_xfer_begin(smart_device_t, uint32_t *);
+
+/**
+ * @brief Read the next Chunk of a Dive Data Transfer
+ * @param[in] Smart Device Handle
+ * @param[out] Chunk Buffer
+ * @param[in,out] Chunk Buffer Size on entry, Bytes Read on exit
  * @return Zero on Success, Non-Zero on Failure
+ *
+ * Reads at most one IrDA chunk.  On failure the transfer is abandoned.
  */
-int smartid_dev_xfer_data(smart_device_t, uint8_t **, uint32_t *);
+int smartid_dev_xfer_read(smart_device_t, uint8_t *, uint32_t *);
+
+//! @return Bytes Remaining in the Current Transfer
+uint32_t smartid_dev_xfer_left(smart_device_t);
 
 #endif /* SMARTID_DEVICE_H_ */
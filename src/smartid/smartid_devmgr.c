@@ -0,0 +1,413 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+/**
+ * @file smartid_devmgr.c
+ * @brief Smart-I Daemon IrDA Device Manager
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <event2/event.h>
+
+#include <common-irda/irda.h>
+
+#include "smartid_conn.h"
+#include "smartid_devmgr.h"
+#include "smartid_logging.h"
+#include "smartid_worker.h"
+
+//! Most Devices kept from one Discovery
+#define SMARTID_DEVMGR_MAX_DEVICES	16
+
+//! IrDA Socket Timeout (ms)
+#define SMARTID_IRDA_TIMEOUT		2000
+
+//! Discovered Device
+struct smartid_devinfo_t_
+{
+	unsigned int				addr;		///< IrDA Device Address
+	char						name[32];	///< IrDA Device Name
+	unsigned int				charset;	///< IrDA Character Set
+	unsigned int				hints;		///< IrDA Hints
+};
+
+//! Discovery Results
+struct smartid_devlist_t_
+{
+	struct smartid_devinfo_t_	dev[SMARTID_DEVMGR_MAX_DEVICES];	///< Devices Found
+	int							ndev;		///< Number of Devices Found
+};
+
+//! IrDA Adapter State, protected by g_lock
+struct smartid_adapter_t_
+{
+	irda_t						disc;		///< Unconnected Socket used for Discovery
+	irda_t						sock;		///< Socket Leased to the Holder
+	smarti_conn_t				holder;		///< Connection Holding the Adapter
+	int							discovering;	///< A Discovery is Running
+
+	smartid_lease_t *			head;		///< First Request in Line
+	smartid_lease_t *			tail;		///< Last Request in Line
+
+	struct smartid_devlist_t_	found;		///< Last Discovery Results
+	struct timespec				found_at;	///< Time of the Last Discovery
+	int							found_ok;	///< Discovery Results are Valid
+};
+
+/*
+ * The IrDA socket API neither lists the adapters on a host nor lets a socket
+ * be bound to one, so every device is reached through the stack's default
+ * adapter and one adapter structure serves them all.
+ */
+static pthread_mutex_t			g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t			g_cond = PTHREAD_COND_INITIALIZER;
+static struct smartid_adapter_t_	g_adapter;
+
+/* Find the Adapter which reaches a Device */
+static struct smartid_adapter_t_ * devmgr_adapter(unsigned int addr)
+{
+	return & g_adapter;
+}
+
+/* Find the Adapter held by a Connection */
+static struct smartid_adapter_t_ * devmgr_holding(smarti_conn_t conn)
+{
+	return (conn && (g_adapter.holder == conn)) ? & g_adapter : 0;
+}
+
+/* Open an IrDA Socket with the Daemon Timeout */
+static irda_t devmgr_socket_open(void)
+{
+	irda_t s;
+
+	if (irda_socket_open(& s) != 0)
+	{
+		smartid_log_error("Failed to open IrDA handle (code %d: %s)", irda_errcode(), irda_errmsg());
+		return 0;
+	}
+
+	if (irda_socket_set_timeout(s, SMARTID_IRDA_TIMEOUT) != 0)
+	{
+		smartid_log_error("Failed to set IrDA socket timeout (code %d: %s)", irda_errcode(), irda_errmsg());
+		irda_socket_close(s);
+		return 0;
+	}
+
+	return s;
+}
+
+/* Take the next Request in Line if the Adapter is Idle, with g_lock held */
+static smartid_lease_t * devmgr_next(struct smartid_adapter_t_ * a)
+{
+	smartid_lease_t * l;
+
+	if (a->holder || a->discovering || ! a->head)
+		return 0;
+
+	l = a->head;
+	a->head = l->next;
+	if (! a->head)
+		a->tail = 0;
+
+	a->holder = l->conn;
+	return l;
+}
+
+/*
+ * Start the Job of a Granted Request.  Called without g_lock held, since
+ * without worker threads the job runs here and uses the device manager.
+ */
+static void devmgr_start(smartid_lease_t * l)
+{
+	struct smartid_adapter_t_ * a;
+
+	while (l)
+	{
+		smartid_log_debug("Granted IrDA adapter to %s", smartid_conn_client(l->conn));
+		if (smartid_worker_queue(l->job) == 0)
+			return;
+
+		smartid_log_warning("Dropped IrDA adapter request from %s", smartid_conn_client(l->conn));
+
+		pthread_mutex_lock(& g_lock);
+		a = devmgr_holding(l->conn);
+		if (a)
+			a->holder = 0;
+		l = a ? devmgr_next(a) : 0;
+		pthread_mutex_unlock(& g_lock);
+	}
+}
+
+/* Collect Discovered Devices */
+static void devmgr_discover_cb(unsigned int addr, const char * name, unsigned int charset, unsigned int hints, void * arg)
+{
+	struct smartid_devlist_t_ * list = (struct smartid_devlist_t_ *)arg;
+	struct smartid_devinfo_t_ * d;
+
+	if (list->ndev >= SMARTID_DEVMGR_MAX_DEVICES)
+		return;
+
+	d = & list->dev[list->ndev++];
+	d->addr = addr;
+	d->charset = charset;
+	d->hints = hints;
+
+	strncpy(d->name, name ? name : "", sizeof(d->name) - 1);
+	d->name[sizeof(d->name) - 1] = 0;
+}
+
+/* Check whether Discovery Results are Recent Enough to Reuse */
+static int devmgr_fresh(struct smartid_adapter_t_ * a)
+{
+	struct timespec now;
+
+	if (! a->found_ok)
+		return 0;
+
+	clock_gettime(CLOCK_MONOTONIC, & now);
+	return (now.tv_sec - a->found_at.tv_sec) < SMARTID_DISCOVERY_TTL;
+}
+
+int smartid_devmgr_init(void)
+{
+	memset(& g_adapter, 0, sizeof(g_adapter));
+
+	g_adapter.disc = devmgr_socket_open();
+	if (! g_adapter.disc)
+		return -1;
+
+	return 0;
+}
+
+void smartid_devmgr_cleanup(void)
+{
+	pthread_mutex_lock(& g_lock);
+
+	if (g_adapter.holder)
+		smartid_log_warning("IrDA adapter still held by %s", smartid_conn_client(g_adapter.holder));
+
+	if (g_adapter.sock)
+		irda_socket_close(g_adapter.sock);
+	if (g_adapter.disc)
+		irda_socket_close(g_adapter.disc);
+
+	memset(& g_adapter, 0, sizeof(g_adapter));
+
+	pthread_mutex_unlock(& g_lock);
+}
+
+int smartid_devmgr_discover(irda_callback_t cb, void * userdata)
+{
+	struct smartid_adapter_t_ * a = & g_adapter;
+	struct smartid_devlist_t_ list;
+	smartid_lease_t * next = 0;
+	int rv;
+	int i;
+
+	pthread_mutex_lock(& g_lock);
+
+	for (;;)
+	{
+		/* Join a Discovery which is already Running */
+		if (a->discovering)
+		{
+			pthread_cond_wait(& g_cond, & g_lock);
+			continue;
+		}
+
+		/* Reuse Recent Results, or any Results while the Adapter is Leased */
+		if (devmgr_fresh(a) || a->holder)
+		{
+			if (a->holder)
+				smartid_log_debug("IrDA adapter is in use, reusing discovery results");
+			break;
+		}
+
+		/* Run the Discovery without the Lock, holding off Lease Requests */
+		a->discovering = 1;
+		pthread_mutex_unlock(& g_lock);
+
+		list.ndev = 0;
+		rv = irda_socket_discover(a->disc, devmgr_discover_cb, & list);
+
+		pthread_mutex_lock(& g_lock);
+		a->discovering = 0;
+
+		if (rv >= 0)
+		{
+			a->found = list;
+			a->found_ok = 1;
+			clock_gettime(CLOCK_MONOTONIC, & a->found_at);
+		}
+
+		pthread_cond_broadcast(& g_cond);
+		next = devmgr_next(a);
+
+		if (rv < 0)
+		{
+			pthread_mutex_unlock(& g_lock);
+			devmgr_start(next);
+			return -1;
+		}
+
+		break;
+	}
+
+	/* Report from a Copy, so the Callback runs Unlocked */
+	list = a->found;
+	pthread_mutex_unlock(& g_lock);
+
+	devmgr_start(next);
+
+	if (cb)
+	{
+		for (i = 0; i < list.ndev; ++i)
+			cb(list.dev[i].addr, list.dev[i].name, list.dev[i].charset, list.dev[i].hints, userdata);
+	}
+
+	return list.ndev;
+}
+
+int smartid_devmgr_acquire(smartid_lease_t * lease)
+{
+	struct smartid_adapter_t_ * a;
+	smartid_lease_t * next;
+
+	if (! lease || ! lease->conn || ! lease->job)
+	{
+		smartid_log_error("Invalid lease request passed to smartid_devmgr_acquire()");
+		return -1;
+	}
+
+	pthread_mutex_lock(& g_lock);
+
+	/* The Connection already holds the Adapter */
+	if (devmgr_holding(lease->conn))
+	{
+		pthread_mutex_unlock(& g_lock);
+		return smartid_worker_queue(lease->job);
+	}
+
+	/* Join the Line, which is Granted at once if the Adapter is Idle */
+	a = devmgr_adapter(lease->addr);
+
+	lease->next = 0;
+	if (a->tail)
+		a->tail->next = lease;
+	else
+		a->head = lease;
+	a->tail = lease;
+
+	if (a->holder || a->discovering)
+		smartid_log_info("%s is waiting for the IrDA adapter", smartid_conn_client(lease->conn));
+
+	next = devmgr_next(a);
+	pthread_mutex_unlock(& g_lock);
+
+	devmgr_start(next);
+	return 0;
+}
+
+irda_t smartid_devmgr_socket(smarti_conn_t conn)
+{
+	struct smartid_adapter_t_ * a;
+	irda_t s = 0;
+
+	pthread_mutex_lock(& g_lock);
+
+	a = devmgr_holding(conn);
+	if (a)
+	{
+		if (! a->sock)
+			a->sock = devmgr_socket_open();
+		s = a->sock;
+	}
+
+	pthread_mutex_unlock(& g_lock);
+
+	return s;
+}
+
+void smartid_devmgr_release(smarti_conn_t conn)
+{
+	struct smartid_adapter_t_ * a;
+	smartid_lease_t * next = 0;
+
+	pthread_mutex_lock(& g_lock);
+
+	a = devmgr_holding(conn);
+	if (a)
+	{
+		/* A Connected Socket cannot be Reused for another Device */
+		if (a->sock)
+			irda_socket_close(a->sock);
+
+		a->sock = 0;
+		a->holder = 0;
+
+		smartid_log_debug("Released IrDA adapter from %s", smartid_conn_client(conn));
+		next = devmgr_next(a);
+	}
+
+	pthread_mutex_unlock(& g_lock);
+
+	devmgr_start(next);
+}
+
+void smartid_devmgr_cancel(smarti_conn_t conn)
+{
+	struct smartid_adapter_t_ * a = & g_adapter;
+	smartid_lease_t ** pl;
+	smartid_lease_t * prev = 0;
+
+	pthread_mutex_lock(& g_lock);
+
+	pl = & a->head;
+	while (* pl)
+	{
+		if ((* pl)->conn == conn)
+		{
+			smartid_log_debug("Withdrew IrDA adapter request from %s", smartid_conn_client(conn));
+			* pl = (* pl)->next;
+			continue;
+		}
+
+		prev = * pl;
+		pl = & (* pl)->next;
+	}
+
+	a->tail = prev;
+
+	pthread_mutex_unlock(& g_lock);
+}
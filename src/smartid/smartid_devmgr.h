@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+#ifndef SMARTID_DEVMGR_H_
+#define SMARTID_DEVMGR_H_
+
+/**
+ * @file smartid_devmgr.h
+ * @brief Smart-I Daemon IrDA Device Manager
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ *
+ * An IrDA adapter can hold only one link at a time, so clients which talk to
+ * devices through the same adapter must take turns.  The device manager owns
+ * the IrDA sockets and leases each adapter to one connection at a time, from
+ * OPEN until the device is closed or the client goes away.  Connections which
+ * want an adapter that is in use wait in line and are granted it in the order
+ * they asked.
+ *
+ * Discovery results are shared between clients.  A discovery which is already
+ * running is joined rather than repeated, and recent results are reused for
+ * SMARTID_DISCOVERY_TTL seconds, or for as long as the adapter is leased,
+ * since no new discovery can run until then.
+ */
+
+#include <common-irda/irda.h>
+
+#include "smartid_conn.h"
+#include "smartid_worker.h"
+
+//! Seconds for which Discovery Results are Reused
+#define SMARTID_DISCOVERY_TTL		5
+
+/**
+ * Adapter Lease Request
+ *
+ * Embedded in the caller's own state, like a worker job, and must stay valid
+ * until the job's completion function runs.
+ */
+typedef struct smartid_lease_t_
+{
+	smarti_conn_t				conn;		///< Connection which will Hold the Adapter
+	unsigned int				addr;		///< IrDA Address of the Device
+	smartid_job_t *				job;		///< Job Queued once the Adapter is Granted
+
+	struct smartid_lease_t_ *	next;		///< Next Request in Line (private)
+
+} smartid_lease_t;
+
+/**
+ * @brief Initialize the Device Manager
+ * @return Zero on Success, Non-Zero on Failure
+ *
+ * Must be called after irda_init().
+ */
+int smartid_devmgr_init(void);
+
+/**
+ * @brief Shut down the Device Manager
+ *
+ * Requests still waiting in line are dropped; their connections are cleaned
+ * up by smartid_conn_cleanup(), which must be called first.
+ */
+void smartid_devmgr_cleanup(void);
+
+/**
+ * @brief Discover Devices
+ * @param[in] Discovery Callback Function
+ * @param[in] User Data passed to the Callback Function
+ * @return Number of devices found or -1 on failure
+ *
+ * Blocks while a discovery is run or joined, so call this from a worker.  The
+ * callback is not called with the device manager locked.
+ */
+int smartid_devmgr_discover(irda_callback_t cb, void * userdata);
+
+/**
+ * @brief Request the Adapter for a Device
+ * @param[in] Lease Request
+ * @return Zero on Success, Non-Zero on Failure
+ *
+ * Queues the request's job on the worker threads once its connection holds
+ * the adapter which reaches the device.  If the connection already holds it,
+ * the job is queued straight away.  A connection whose client has gone while
+ * it waited is still granted the adapter in turn, and is expected to release
+ * it at once.
+ */
+int smartid_devmgr_acquire(smartid_lease_t * lease);
+
+/**
+ * @brief Get the IrDA Socket Leased to a Connection
+ * @param[in] Connection Handle
+ * @return IrDA Socket, or NULL if the Connection holds no Adapter
+ *
+ * The socket is opened on first use and closed when the lease ends.
+ */
+irda_t smartid_devmgr_socket(smarti_conn_t conn);
+
+/**
+ * @brief Release the Adapter held by a Connection
+ * @param[in] Connection Handle
+ *
+ * Closes the leased socket and grants the adapter to the next connection in
+ * line.  Does nothing if the connection holds no adapter.
+ */
+void smartid_devmgr_release(smarti_conn_t conn);
+
+/**
+ * @brief Withdraw the Requests a Connection has Waiting in Line
+ * @param[in] Connection Handle
+ *
+ * Leases live in the connection's command arena, so they are withdrawn
+ * before the connection is disposed.  A granted lease is not affected; use
+ * smartid_devmgr_release() for that.
+ */
+void smartid_devmgr_cancel(smarti_conn_t conn);
+
+#endif /* SMARTID_DEVMGR_H_ */
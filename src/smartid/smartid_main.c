@@ -58,6 +58,7 @@
 #include "smartid_logging.h"
 #include "smartid_server.h"
 #include "smartid_version.h"
+#include "smartid_worker.h"
 
 /**@{
  * @name Global Variables
@@ -68,40 +69,19 @@ int		g_ipv6;			///< Bind to IPv6 Addresses Only
 int		g_fork;			///< Fork and become a daemon
 char *	g_pidfile;		///< PID File for daemon
 int		g_port;			///< TCP Port for Smart-I (default in smartid_version.h)
+int		g_workers;		///< Worker Threads for Device Commands
 /*@}*/
 
-void sigterm_handler(int sig)
-{
-	smartid_stop(sig);
-}
-
 void sigchld_handler(int sig)
 {
 	while (waitpid(-1, NULL, WNOHANG) > 0);
 }
 
+/* SIGTERM and SIGINT are handled by the Event Loop (see smartid_start()) */
 int smartid_setup_signals()
 {
-	struct sigaction act_exit;
 	struct sigaction act_chld;
 
-	memset(& act_exit, 0, sizeof(struct sigaction));
-	act_exit.sa_handler = sigterm_handler;
-	act_exit.sa_flags = 0;
-	sigemptyset(& act_exit.sa_mask);
-
-	if (sigaction(SIGTERM, & act_exit, NULL) == -1)
-	{
-		smartid_log_syserror("Failed to initialize handler for SIGTERM");
-		return 1;
-	}
-
-	if (sigaction(SIGINT, & act_exit, NULL) == -1)
-	{
-		smartid_log_syserror("Failed to initialize handler for SIGINT");
-		return 1;
-	}
-
 	memset(& act_chld, 0, sizeof(struct sigaction));
 	act_chld.sa_handler = sigchld_handler;
 	act_chld.sa_flags = SA_RESTART;
@@ -118,7 +98,7 @@ int smartid_setup_signals()
 
 void smartid_usage()
 {
-	fprintf(stderr, "Usage: %s [-46Ddhv] [-p PORT] [--pidfile PIDFILE]\n", SMARTID_APP_NAME);
+	fprintf(stderr, "Usage: %s [-46Ddhv] [-p PORT] [-w WORKERS] [--pidfile PIDFILE]\n", SMARTID_APP_NAME);
 	fprintf(stderr, "\n");
 	fprintf(stderr, "Options:\n");
 	fprintf(stderr, "  -4                : only bind to IPv4 addresses (default)\n");
@@ -128,6 +108,7 @@ void smartid_usage()
 	fprintf(stderr, "  -h|--help         : show program options (this screen)\n");
 	fprintf(stderr, "  -p|--port PORT    : define the TCP port on which to listen (default: %d)\n", SMARTID_PORT);
 	fprintf(stderr, "  -v|--version      : show version number\n");
+	fprintf(stderr, "  -w|--workers N    : run device commands on N worker threads, or 0 for none (default: %d)\n", SMARTID_DEFAULT_WORKERS);
 	fprintf(stderr, "  --pidfile PIDFILE : write the daemon PID to the specified file (default: %s)\n", SMARTID_PIDFILE);
 }
 
@@ -144,6 +125,7 @@ static struct option g_options[] =
 	{ "version",	no_argument,		0,	'v' },
 	{ "pidfile",	required_argument,	0,	1	},
 	{ "port",		required_argument,	0,	'p' },
+	{ "workers",	required_argument,	0,	'w' },
 	{ 0,			0,					0,	0 }
 };
 
@@ -161,9 +143,10 @@ int smartid_parse_args(int argc, char ** argv, int * exit)
 	g_ipv6 = 0;
 	g_pidfile = strdup(SMARTID_PIDFILE);
 	g_port = SMARTID_PORT;
+	g_workers = SMARTID_DEFAULT_WORKERS;
 
 	/* Parse Arguments */
-	while ((ch = getopt_long(argc, argv, "46Ddp:hv", g_options, 0)) != -1)
+	while ((ch = getopt_long(argc, argv, "46Ddp:hvw:", g_options, 0)) != -1)
 	{
 		switch (ch)
 		{
@@ -197,6 +180,16 @@ int smartid_parse_args(int argc, char ** argv, int * exit)
 			}
 			break;
 
+		case 'w':
+			if ((sscanf(optarg, "%d", & g_workers) != 1) || (g_workers < 0))
+			{
+				fprintf(stderr, "Invalid number of workers specified: %s\n", optarg);
+				smartid_usage();
+				if (exit) * exit = 1;
+				return 1;
+			}
+			break;
+
 		case 'h':
 			smartid_usage();
 			if (exit) * exit = 1;
@@ -301,7 +294,7 @@ int smartid_run()
 	smartid_log_debug("Using libevent version %s", event_get_version());
 
 	/* Initialize the Daemon */
-	rv = smartid_init();
+	rv = smartid_init(g_workers);
 	if (rv != 0)
 	{
 		smartid_log_error("smartid_init() failed with code %d", rv);
@@ -35,6 +35,7 @@
  */
 
 #include <errno.h>
+#include <signal.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -42,12 +43,17 @@
 
 #include <event2/event.h>
 #include <event2/event_struct.h>
+#include <event2/thread.h>
 #include <event2/util.h>
 
+#include <benthos/divecomputer/base64.h>
+
 #include "smartid_conn.h"
+#include "smartid_devmgr.h"
 #include "smartid_logging.h"
 #include "smartid_server.h"
 #include "smartid_version.h"
+#include "smartid_worker.h"
 
 /* Global Event Loop Pointer */
 static struct event_base * g_evloop = 0;
@@ -55,6 +61,21 @@ static struct event_base * g_evloop = 0;
 /* Global Connection Event Pointer */
 struct event * g_evt_connect = 0;
 
+/* Global Signal Event Pointers */
+static struct event * g_evt_sigterm = 0;
+static struct event * g_evt_sigint = 0;
+
+/*
+ * Server Signal Callback
+ *
+ * SIGTERM and SIGINT are delivered through the event loop, as the loop is
+ * locked for the worker threads and may not be stopped from a signal handler.
+ */
+static void serv_signal(evutil_socket_t sig, short event, void * arg)
+{
+	smartid_stop(sig);
+}
+
 /* Server Connection Callback */
 static void serv_connect(int listener, short event, void * arg)
 {
@@ -112,10 +133,17 @@ static void serv_connect(int listener, short event, void * arg)
 	}
 }
 
-int smartid_init(void)
+int smartid_init(int nworkers)
 {
 	struct event_base * evloop;
 
+	/* Worker Threads share Connections with the Event Loop */
+	if (evthread_use_pthreads() != 0)
+	{
+		smartid_log_error("evthread_use_pthreads() failed");
+		return -1;
+	}
+
 	/* Setup LibEvent */
 	evloop = event_base_new();
 	if (! evloop)
@@ -127,13 +155,52 @@ int smartid_init(void)
 	g_evloop = evloop;
 	smartid_log_debug("Using libevent backend %s", event_base_get_method(evloop));
 
+	/* Choose the Transfer Encoder before Workers can use it */
+	base64_select_impl(BASE64_IMPL_AUTO);
+
+	/* Start the Worker Threads */
+	if (smartid_worker_init(evloop, nworkers) != 0)
+	{
+		smartid_log_error("Failed to start worker threads");
+		event_base_free(evloop);
+		g_evloop = 0;
+		return -1;
+	}
+
+	/* Take Ownership of the IrDA Adapter */
+	if (smartid_devmgr_init() != 0)
+	{
+		smartid_log_error("Failed to start the IrDA device manager");
+		smartid_worker_cleanup();
+		event_base_free(evloop);
+		g_evloop = 0;
+		return -1;
+	}
+
 	return 0;
 }
 
 void smartid_cleanup(void)
 {
+	/* Finish Running Commands */
+	smartid_worker_cleanup();
+
 	/* Cleanup Connection Resources */
 	smartid_conn_cleanup();
+	smartid_devmgr_cleanup();
+
+	/* Close Signal Events */
+	if (g_evt_sigterm)
+	{
+		event_free(g_evt_sigterm);
+		g_evt_sigterm = 0;
+	}
+
+	if (g_evt_sigint)
+	{
+		event_free(g_evt_sigint);
+		g_evt_sigint = 0;
+	}
 
 	/* Close Connection Event */
 	if (g_evt_connect)
@@ -195,6 +262,15 @@ int smartid_start(int listenfd, const char * saddr, int sport)
 		return -1;
 	}
 
+	/* Setup the Signal Events */
+	g_evt_sigterm = evsignal_new(g_evloop, SIGTERM, serv_signal, 0);
+	g_evt_sigint = evsignal_new(g_evloop, SIGINT, serv_signal, 0);
+	if (! g_evt_sigterm || ! g_evt_sigint || (event_add(g_evt_sigterm, NULL) != 0) || (event_add(g_evt_sigint, NULL) != 0))
+	{
+		smartid_log_error("Failed to create events for SIGTERM and SIGINT");
+		return -1;
+	}
+
 	smartid_log_info("%s is active", SMARTID_APP_TITLE);
 
 	/* Run the Event Loop */
@@ -213,7 +289,7 @@ int smartid_stop(int sig)
 {
 	int rv;
 
-	smartid_log_debug("sigterm_handler(%d)", sig);
+	smartid_log_debug("smartid_stop(%d)", sig);
 
 	rv = event_base_loopexit(g_evloop, 0);
 	if (rv != 0)
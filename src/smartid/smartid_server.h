@@ -41,12 +41,13 @@
 
 /**
  * @brief Initialize the Smart-I Daemon
+ * @param[in] Number of Worker Threads for Device Commands
  * @return Zero On Success, Non-Zero on Failure
  *
  * Initailizes the Daemon State.  Must be called before any other daemon
  * calls are made.
  */
-int smartid_init(void);
+int smartid_init(int);
 
 /**
  * @brief Clean Up the Smart-I Daemon
@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+/**
+ * @file smartid_worker.c
+ * @brief Smart-I Daemon Worker Threads
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <event2/event.h>
+
+#include "smartid_logging.h"
+#include "smartid_worker.h"
+
+//! Job Queue
+struct smartid_jobq_t_
+{
+	smartid_job_t *				head;		///< First Job in Queue
+	smartid_job_t *				tail;		///< Last Job in Queue
+};
+
+/* Worker Pool State, protected by g_lock */
+static pthread_mutex_t			g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t			g_cond = PTHREAD_COND_INITIALIZER;
+static struct smartid_jobq_t_	g_pending = { 0, 0 };
+static struct smartid_jobq_t_	g_finished = { 0, 0 };
+static int						g_stopping = 0;
+
+/* Worker Threads and Completion Event, owned by the Event Loop Thread */
+static pthread_t *				g_threads = 0;
+static int						g_nthreads = 0;
+static struct event *			g_evt_done = 0;
+
+static void jobq_push(struct smartid_jobq_t_ * q, smartid_job_t * j)
+{
+	j->next = 0;
+	if (q->tail)
+		q->tail->next = j;
+	else
+		q->head = j;
+	q->tail = j;
+}
+
+static smartid_job_t * jobq_pop(struct smartid_jobq_t_ * q)
+{
+	smartid_job_t * j = q->head;
+
+	if (j)
+	{
+		q->head = j->next;
+		if (! q->head)
+			q->tail = 0;
+	}
+
+	return j;
+}
+
+/* Run the Completion Functions of all Finished Jobs */
+static void worker_drain(void)
+{
+	smartid_job_t * list;
+	smartid_job_t * j;
+
+	/* Take the whole List so Completions can Queue new Jobs */
+	pthread_mutex_lock(& g_lock);
+	list = g_finished.head;
+	g_finished.head = g_finished.tail = 0;
+	pthread_mutex_unlock(& g_lock);
+
+	while (list)
+	{
+		j = list;
+		list = j->next;
+
+		if (j->done)
+			j->done(j->arg);
+	}
+}
+
+/* Completion Event Callback */
+static void worker_done(evutil_socket_t fd, short event, void * arg)
+{
+	worker_drain();
+}
+
+/* Worker Thread Entry Point */
+static void * worker_main(void * arg)
+{
+	smartid_job_t * j;
+
+	pthread_mutex_lock(& g_lock);
+	for (;;)
+	{
+		while (! g_pending.head && ! g_stopping)
+			pthread_cond_wait(& g_cond, & g_lock);
+
+		if (g_stopping)
+			break;
+
+		j = jobq_pop(& g_pending);
+		pthread_mutex_unlock(& g_lock);
+
+		j->work(j->arg);
+
+		pthread_mutex_lock(& g_lock);
+		jobq_push(& g_finished, j);
+
+		/* Wake the Event Loop to run the Completion */
+		event_active(g_evt_done, EV_READ, 0);
+	}
+	pthread_mutex_unlock(& g_lock);
+
+	return 0;
+}
+
+int smartid_worker_init(struct event_base * evloop, int nthreads)
+{
+	sigset_t mask;
+	sigset_t omask;
+	int rv;
+	int i;
+
+	g_nthreads = 0;
+
+	if (nthreads <= 0)
+	{
+		smartid_log_info("Running device commands in the event loop");
+		return 0;
+	}
+
+	g_evt_done = event_new(evloop, -1, 0, worker_done, 0);
+	if (! g_evt_done)
+	{
+		smartid_log_error("Failed to create worker completion event");
+		return -1;
+	}
+
+	g_threads = (pthread_t *)malloc(nthreads * sizeof(pthread_t));
+	if (! g_threads)
+	{
+		smartid_log_error("Failed to allocate memory for worker threads");
+		event_free(g_evt_done);
+		g_evt_done = 0;
+		return -1;
+	}
+
+	/* Signals are handled by the Event Loop Thread */
+	sigfillset(& mask);
+	pthread_sigmask(SIG_SETMASK, & mask, & omask);
+
+	for (i = 0; i < nthreads; ++i)
+	{
+		rv = pthread_create(& g_threads[i], 0, worker_main, 0);
+		if (rv != 0)
+		{
+			smartid_log_error("Failed to start worker thread (code %d: %s)", rv, strerror(rv));
+			break;
+		}
+
+		g_nthreads++;
+	}
+
+	pthread_sigmask(SIG_SETMASK, & omask, 0);
+
+	if (g_nthreads == 0)
+	{
+		smartid_worker_cleanup();
+		return -1;
+	}
+
+	smartid_log_debug("Started %d worker threads", g_nthreads);
+	return 0;
+}
+
+void smartid_worker_cleanup(void)
+{
+	smartid_job_t * j;
+	int i;
+
+	/* Stop the Worker Threads */
+	pthread_mutex_lock(& g_lock);
+	g_stopping = 1;
+	pthread_cond_broadcast(& g_cond);
+	pthread_mutex_unlock(& g_lock);
+
+	for (i = 0; i < g_nthreads; ++i)
+		pthread_join(g_threads[i], 0);
+
+	/* Complete Jobs which were never Started */
+	pthread_mutex_lock(& g_lock);
+	while ((j = jobq_pop(& g_pending)) != 0)
+		jobq_push(& g_finished, j);
+	pthread_mutex_unlock(& g_lock);
+
+	worker_drain();
+
+	if (g_evt_done)
+	{
+		event_free(g_evt_done);
+		g_evt_done = 0;
+	}
+
+	free(g_threads);
+	g_threads = 0;
+	g_nthreads = 0;
+}
+
+int smartid_worker_queue(smartid_job_t * job)
+{
+	if (! job || ! job->work)
+	{
+		smartid_log_error("Invalid job passed to smartid_worker_queue()");
+		return -1;
+	}
+
+	if (smartid_worker_stopping())
+		return -1;
+
+	/* Without Worker Threads the Job runs to Completion Here */
+	if (g_nthreads == 0)
+	{
+		job->work(job->arg);
+		if (job->done)
+			job->done(job->arg);
+		return 0;
+	}
+
+	pthread_mutex_lock(& g_lock);
+	jobq_push(& g_pending, job);
+	pthread_cond_signal(& g_cond);
+	pthread_mutex_unlock(& g_lock);
+
+	return 0;
+}
+
+int smartid_worker_stopping(void)
+{
+	int rv;
+
+	pthread_mutex_lock(& g_lock);
+	rv = g_stopping;
+	pthread_mutex_unlock(& g_lock);
+
+	return rv;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef SMARTID_WORKER_H_
+#define SMARTID_WORKER_H_
+
+/**
+ * @file smartid_worker.h
+ * @brief Smart-I Daemon Worker Threads
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ *
+ * Device I/O blocks for up to the IrDA timeout on every read, so commands
+ * which talk to a device are run on a pool of worker threads rather than in
+ * the event loop.  Each job has a work function, which runs on a worker, and
+ * a completion function, which is posted back to the event loop once the
+ * work function returns.
+ */
+
+#include <event2/event.h>
+
+//! Default Number of Worker Threads
+#define SMARTID_DEFAULT_WORKERS		4
+
+/**
+ * Worker Job Function
+ * @param[in] Job Argument
+ */
+typedef void (* smartid_job_fn_t)(void *);
+
+/**
+ * Worker Job
+ *
+ * Jobs are embedded in the caller's own state, so that queueing a job does
+ * not allocate; the job must stay valid until its completion function runs.
+ */
+typedef struct smartid_job_t_
+{
+	smartid_job_fn_t			work;		///< Work Function, run on a Worker Thread
+	smartid_job_fn_t			done;		///< Completion Function, run on the Event Loop
+	void *						arg;		///< Job Argument
+
+	struct smartid_job_t_ *		next;		///< Next Job in Queue (private)
+
+} smartid_job_t;
+
+/**
+ * @brief Start the Worker Threads
+ * @param[in] Server Event Loop
+ * @param[in] Number of Worker Threads
+ * @return Zero on Success, Non-Zero on Failure
+ *
+ * The event loop must have been created after evthread_use_pthreads() was
+ * called.  If the number of threads is zero, jobs are run immediately in the
+ * calling thread.
+ */
+int smartid_worker_init(struct event_base * evloop, int nthreads);
+
+/**
+ * @brief Stop the Worker Threads
+ *
+ * Jobs which have not been started are abandoned, and running jobs are
+ * waited for; they should check smartid_worker_stopping() to finish early.
+ * The completion function of every queued job is then called from the
+ * calling thread.
+ */
+void smartid_worker_cleanup(void);
+
+/**
+ * @brief Queue a Job for the Worker Threads
+ * @param[in] Job, with the Work and Completion Functions and Argument set
+ * @return Zero on Success, Non-Zero on Failure
+ *
+ * Jobs are started in the order they are queued.
+ */
+int smartid_worker_queue(smartid_job_t * job);
+
+//! @return Non-Zero if the Worker Threads are Shutting Down
+int smartid_worker_stopping(void);
+
+#endif /* SMARTID_WORKER_H_ */
@@ -0,0 +1,381 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+
+/**
+ * @file src/tests/test_smartid_devmgr.c
+ * @brief Smart-I Daemon Device Manager Tests
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ *
+ * Runs the Smart-I daemon in-process on a loopback port, with its IrDA
+ * adapter routed to the simulated Smart device, and downloads from it with
+ * several Smart-I clients at once.  The simulated transport is wrapped to
+ * count connected sockets, so a second device connection while the adapter
+ * is leased is caught where it happens.  One client leaves while it is still
+ * waiting for the adapter, and the clients queued behind it must still be
+ * served.
+ *
+ * Usage: test_smartid_devmgr [-v]
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <common-irda/irda.h>
+#include <common-irda/irda_sim.h>
+#include <common-irda/irda_transport.h>
+
+#include "smarti_client.h"
+#include "smartid_logging.h"
+#include "smartid_server.h"
+
+//! Number of Clients Downloading at Once
+#define TEST_CLIENTS		5
+
+//! Connections Waiting in Line when the Daemon Stops (more than it Pools)
+#define TEST_WAITING		12
+
+//! Simulated Dive Memory Size
+#define TEST_MEMORY_SIZE	4096
+
+//! Simulated Link Rate (bytes per second)
+#define TEST_BYTE_RATE		32768
+
+#define CHECK(cond) \
+	if (! (cond)) \
+	{ \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		return 1; \
+	}
+
+//! Download Client State
+typedef struct
+{
+	pthread_t		thread;		///< Client Thread
+	int				id;			///< Client Number
+	int				ok;			///< Download Succeeded
+	char			err[128];	///< Failure Message
+} test_client_t;
+
+static uint8_t				g_memory[TEST_MEMORY_SIZE];
+static uint16_t				g_port;
+
+/* Device Connections seen through the Wrapped Transport, under g_lock */
+static pthread_mutex_t		g_lock = PTHREAD_MUTEX_INITIALIZER;
+static irda_t				g_connected;
+static int					g_connects;
+static int					g_overlaps;
+
+static irda_transport_t		g_ops;
+static const irda_transport_t *	g_sim;
+
+/* Count a Device Connection, flagging one made while another is Open */
+static int test_connected(irda_t s, int rv)
+{
+	if (rv != 0)
+		return rv;
+
+	pthread_mutex_lock(& g_lock);
+	if (g_connected)
+		++g_overlaps;
+	g_connected = s;
+	++g_connects;
+	pthread_mutex_unlock(& g_lock);
+
+	return 0;
+}
+
+static int test_connect_name(irda_t s, unsigned int address, const char * name, int * timeout)
+{
+	return test_connected(s, g_sim->connect_name(s, address, name, timeout));
+}
+
+static int test_connect_lsap(irda_t s, unsigned int address, unsigned int lsap, int * timeout)
+{
+	return test_connected(s, g_sim->connect_lsap(s, address, lsap, timeout));
+}
+
+static int test_close(irda_t s)
+{
+	pthread_mutex_lock(& g_lock);
+	if (g_connected == s)
+		g_connected = 0;
+	pthread_mutex_unlock(& g_lock);
+
+	return g_sim->close(s);
+}
+
+/* Run the Daemon Event Loop */
+static void * test_server(void * arg)
+{
+	int fd = * (int *)arg;
+
+	smartid_start(fd, "127.0.0.1", g_port);
+	return NULL;
+}
+
+/* Open the Device, Download the Whole Memory and Close it */
+static void * test_download(void * arg)
+{
+	test_client_t * t = (test_client_t *)arg;
+	smarti_client_t c;
+	uint8_t model;
+	uint32_t serial;
+	uint32_t ticks;
+	void * data = NULL;
+	size_t len = 0;
+
+	if (smarti_client_alloc(& c) != 0)
+	{
+		snprintf(t->err, sizeof(t->err), "smarti_client_alloc() failed");
+		return NULL;
+	}
+
+	if (smarti_client_connect(c, "127.0.0.1", g_port) != 0)
+		snprintf(t->err, sizeof(t->err), "connect: %s", smarti_client_errmsg(c));
+	else if (smarti_client_open_info(c, 1, 1, 8, & model, & serial, & ticks) != 0)
+		snprintf(t->err, sizeof(t->err), "open: %s", smarti_client_errmsg(c));
+	else if (smarti_client_xfer(c, & data, & len) != 0)
+		snprintf(t->err, sizeof(t->err), "xfer: %s", smarti_client_errmsg(c));
+	else if ((len != TEST_MEMORY_SIZE) || memcmp(data, g_memory, len))
+		snprintf(t->err, sizeof(t->err), "xfer: received %lu bytes which differ from the device", (unsigned long)len);
+	else if (smarti_client_close(c) != 0)
+		snprintf(t->err, sizeof(t->err), "close: %s", smarti_client_errmsg(c));
+	else
+		t->ok = 1;
+
+	free(data);
+	smarti_client_disconnect(c);
+	smarti_client_dispose(c);
+
+	return NULL;
+}
+
+/* Ask for the Device on a Raw Connection, returning its Socket */
+static int test_request(void)
+{
+	static const char cmd[] = "OPEN 1 1 8\n";
+
+	struct sockaddr_in sa;
+	int fd;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+
+	memset(& sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons(g_port);
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if ((connect(fd, (struct sockaddr *)& sa, sizeof(sa)) != 0)
+		|| (send(fd, cmd, sizeof(cmd) - 1, 0) != (ssize_t)(sizeof(cmd) - 1)))
+	{
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/* Ask for the Device and Hang Up before the Adapter is Granted */
+static int test_leave(void)
+{
+	struct timespec ts = { 0, 100000000 };
+	int fd;
+
+	fd = test_request();
+	if (fd < 0)
+		return -1;
+
+	/* Give the Daemon Time to put the Request in Line */
+	nanosleep(& ts, NULL);
+	close(fd);
+
+	return 0;
+}
+
+/*
+ * Open a Loopback Listener on a Free Port.  It listens before the daemon
+ * thread starts, so clients can connect as soon as this returns.
+ */
+static int test_listen(void)
+{
+	struct sockaddr_in sa;
+	socklen_t slen = sizeof(sa);
+	int fd;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+
+	memset(& sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if ((bind(fd, (struct sockaddr *)& sa, sizeof(sa)) != 0)
+		|| (getsockname(fd, (struct sockaddr *)& sa, & slen) != 0)
+		|| (listen(fd, 8) != 0))
+	{
+		close(fd);
+		return -1;
+	}
+
+	g_port = ntohs(sa.sin_port);
+	return fd;
+}
+
+int main(int argc, char ** argv)
+{
+	irda_sim_config_t cfg;
+	test_client_t clients[TEST_CLIENTS];
+	int waiting[TEST_WAITING];
+	smarti_client_t c;
+	pthread_t server;
+	struct timespec ts = { 0, 100000000 };
+	void * data = NULL;
+	size_t len = 0;
+	uint8_t model;
+	uint32_t serial;
+	uint32_t ticks;
+	int fd;
+	int i;
+
+	if ((argc > 1) && ! strcmp(argv[1], "-v"))
+	{
+		smartid_log_use_stderr(1);
+		smartid_log_debug_lvl(1);
+	}
+
+	/* Fill the Simulated Dive Memory */
+	for (i = 0; i < TEST_MEMORY_SIZE; ++i)
+		g_memory[i] = (uint8_t)(i * 7 + (i >> 8));
+
+	irda_sim_default_config(& cfg);
+	cfg.data = g_memory;
+	cfg.size = TEST_MEMORY_SIZE;
+	cfg.byte_rate = TEST_BYTE_RATE;
+	CHECK(irda_sim_configure(& cfg) == 0)
+
+	/* Route the Daemon to the Simulated Device through the Counting Transport */
+	g_sim = irda_sim_transport();
+	g_ops = * g_sim;
+	g_ops.close = test_close;
+	g_ops.connect_name = test_connect_name;
+	g_ops.connect_lsap = test_connect_lsap;
+
+	irda_set_transport(& g_ops);
+	CHECK(irda_init() == 0)
+
+	/* Start the Daemon */
+	fd = test_listen();
+	CHECK(fd >= 0)
+	CHECK(smartid_init(2) == 0)
+	CHECK(pthread_create(& server, NULL, test_server, & fd) == 0)
+
+	CHECK(smarti_client_init() == 0)
+
+	/* Hold the Adapter while the Others Line Up */
+	CHECK(smarti_client_alloc(& c) == 0)
+	CHECK(smarti_client_connect(c, "127.0.0.1", g_port) == 0)
+	CHECK(smarti_client_open_info(c, 1, 1, 8, & model, & serial, & ticks) == 0)
+	CHECK(model == cfg.model)
+
+	/* The First in Line Leaves before its Turn */
+	CHECK(test_leave() == 0)
+
+	memset(clients, 0, sizeof(clients));
+	for (i = 0; i < TEST_CLIENTS; ++i)
+	{
+		clients[i].id = i;
+		CHECK(pthread_create(& clients[i].thread, NULL, test_download, & clients[i]) == 0)
+	}
+
+	nanosleep(& ts, NULL);
+
+	/* Download and Hand the Adapter On */
+	CHECK(smarti_client_xfer(c, & data, & len) == 0)
+	CHECK((len == TEST_MEMORY_SIZE) && ! memcmp(data, g_memory, len))
+	CHECK(smarti_client_close(c) == 0)
+
+	free(data);
+
+	for (i = 0; i < TEST_CLIENTS; ++i)
+	{
+		pthread_join(clients[i].thread, NULL);
+		if (! clients[i].ok)
+			fprintf(stderr, "client %d: %s\n", clients[i].id, clients[i].err);
+	}
+
+	/*
+	 * Stop the Daemon with Connections still in Line behind the Holder.
+	 * Their requests are withdrawn as they are disposed, so disposing the
+	 * holder afterwards does not grant the adapter to a freed connection.
+	 */
+	CHECK(smarti_client_open(c, 1, 1, 8) == 0)
+
+	for (i = 0; i < TEST_WAITING; ++i)
+	{
+		waiting[i] = test_request();
+		CHECK(waiting[i] >= 0)
+	}
+
+	nanosleep(& ts, NULL);
+
+	smartid_stop(0);
+	pthread_join(server, NULL);
+	smartid_cleanup();
+	close(fd);
+	irda_cleanup();
+
+	for (i = 0; i < TEST_WAITING; ++i)
+		close(waiting[i]);
+
+	smarti_client_disconnect(c);
+	smarti_client_dispose(c);
+
+	for (i = 0; i < TEST_CLIENTS; ++i)
+		CHECK(clients[i].ok)
+
+	/* Every Download Connected Once, and Never Alongside Another */
+	CHECK(g_overlaps == 0)
+	CHECK(g_connects == TEST_CLIENTS + 2)
+
+	printf("test_smartid_devmgr: passed\n");
+	return 0;
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+
+/**
+ * @file src/tests/test_xfer_dump.cpp
+ * @brief Transfer Dump Container Tests
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ *
+ * Writes a dump file with xfer_dump_append and checks that it reads back,
+ * then that frames with inconsistent offsets are rejected rather than
+ * pointing the index outside of the frame.
+ *
+ * Usage: test_xfer_dump <scratch file>
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "xfer_dump.h"
+
+#define CHECK(cond) \
+	if (! (cond)) \
+	{ \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		return 1; \
+	}
+
+static void put_u32(uint8_t * p, uint32_t v)
+{
+	p[0] = (uint8_t)(v);
+	p[1] = (uint8_t)(v >> 8);
+	p[2] = (uint8_t)(v >> 16);
+	p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get_u32(const uint8_t * p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+int main(int argc, char ** argv)
+{
+	const char * path = (argc > 1) ? argv[1] : "test_xfer_dump.bin";
+	std::vector<uint8_t> file;
+	std::vector<dump_frame_t> frames;
+	std::vector<dump_dive_t> dives;
+	dump_info_t info;
+	dump_dive_t dive;
+	uint8_t data[64];
+	uint8_t * fp;
+
+	for (size_t i = 0; i < sizeof(data); ++i)
+		data[i] = (uint8_t)i;
+
+	info.driver = "smart";
+	info.model = 16;
+	info.serial = 4242;
+	info.ticks = 1000;
+	info.xfer_time = 1400000000;
+	info.token = "7";
+
+	dive.data = data;
+	dive.size = 40;
+	dive.token = "8";
+	dives.push_back(dive);
+
+	dive.data = data + 40;
+	dive.size = 24;
+	dive.token = "9";
+	dives.push_back(dive);
+
+	/* Write and Read Back a Valid Dump */
+	std::remove(path);
+	CHECK(xfer_dump_append(path, info, data, sizeof(data), dives) == 0);
+
+	std::ifstream f(path, std::ios::binary);
+	file.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+	f.close();
+	std::remove(path);
+
+	CHECK(xfer_dump_check(file.data(), file.size()));
+	CHECK(xfer_dump_frames(file.data(), file.size(), frames) == 0);
+	CHECK(frames.size() == 1);
+	CHECK(frames[0].ndives == 2);
+	CHECK(frames[0].info.token == "7");
+	CHECK(xfer_dump_dive(frames[0], 1, dive) == 0);
+	CHECK((dive.size == 24) && (dive.token == "9") && (memcmp(dive.data, data + 40, 24) == 0));
+
+	/* Swap the Index and Data Offsets of the Frame */
+	fp = file.data() + 16;
+	uint32_t index_off = get_u32(fp + 16);
+	uint32_t data_off = get_u32(fp + 20);
+	CHECK(index_off < data_off);
+
+	put_u32(fp + 16, data_off);
+	put_u32(fp + 20, index_off);
+	CHECK(xfer_dump_frames(file.data(), file.size(), frames) == EINVAL);
+
+	/* An Index Offset past the Data Offset is also Rejected with no Dives */
+	put_u32(fp + 8, 0);
+	CHECK(xfer_dump_frames(file.data(), file.size(), frames) == EINVAL);
+
+	/* Append after a Frame Torn by an Interrupted Write */
+	std::remove(path);
+	CHECK(xfer_dump_append(path, info, data, sizeof(data), dives) == 0);
+	CHECK(xfer_dump_append(path, info, data, sizeof(data), dives) == 0);
+
+	f.open(path, std::ios::binary);
+	file.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+	f.close();
+
+	std::ofstream torn(path, std::ios::binary | std::ios::trunc);
+	torn.write((const char *)file.data(), file.size() - 20);
+	torn.close();
+
+	info.token = "10";
+	CHECK(xfer_dump_append(path, info, data, sizeof(data), dives) == 0);
+
+	f.open(path, std::ios::binary);
+	file.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+	f.close();
+	std::remove(path);
+
+	CHECK(xfer_dump_frames(file.data(), file.size(), frames) == 0);
+	CHECK(frames.size() == 2);
+	CHECK((frames[0].info.token == "7") && (frames[1].info.token == "10"));
+
+	printf("test_xfer_dump: passed\n");
+	return 0;
+}
@@ -37,12 +37,18 @@
  * outputs transferred data in UDDF.
  */
 
+#include <cstdio>
 #include <cstdlib>
 
+#include <atomic>
+#include <condition_variable>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <benthos/divecomputer/config.h>
@@ -55,18 +61,82 @@
 
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 #include <boost/program_options.hpp>
 
 #include "output_fmt.h"
 #include "output_csv.h"
 #include "output_uddf.h"
+#include "xfer_dump.h"
 
 namespace fs = boost::filesystem;
+namespace io = boost::iostreams;
 namespace po = boost::program_options;
 
 typedef std::vector<uint8_t>					dive_buffer_t;
-typedef std::pair<dive_buffer_t, std::string>	dive_entry_t;
-typedef std::list<dive_entry_t>					dive_data_t;
+
+/*
+ * View of a single dive.  The dive data is not copied; the view refers to
+ * the transfer buffer returned by driver_transfer, which is kept alive until
+ * parsing has finished.
+ */
+typedef dump_dive_t								dive_view_t;
+
+typedef struct {
+	const uint8_t *				buffer;		///< Transfer Buffer
+	uint32_t					length;		///< Transfer Buffer Length
+	std::vector<dive_view_t>	dives;		///< Dive Views
+	std::list<dive_buffer_t>	copies;		///< Dives not in the Transfer Buffer
+
+} dive_data_t;
+
+/*
+ * Dives waiting to be parsed.  Normally the queue is filled by driver_extract
+ * and closed before parsing starts.  In pipelined mode the driver appends
+ * dives while the transfer is still running and the parser consumes them on
+ * a separate thread.
+ */
+typedef struct {
+	dive_data_t *				data;
+	size_t						next;
+	bool						closed;
+	std::mutex					mtx;
+	std::condition_variable		cv;
+
+} dive_queue_t;
+
+void dive_queue_push(dive_queue_t * q, const dive_view_t & view)
+{
+	std::lock_guard<std::mutex> lock(q->mtx);
+	q->data->dives.push_back(view);
+	q->cv.notify_all();
+}
+
+void dive_queue_close(dive_queue_t * q)
+{
+	std::lock_guard<std::mutex> lock(q->mtx);
+	q->closed = true;
+	q->cv.notify_all();
+}
+
+/* Wait for a Dive to be Available; returns false once the Queue is Drained */
+bool dive_queue_wait(dive_queue_t * q)
+{
+	std::unique_lock<std::mutex> lock(q->mtx);
+	q->cv.wait(lock, [q]() { return q->closed || (q->next < q->data->dives.size()); });
+	return q->next < q->data->dives.size();
+}
+
+bool dive_queue_pop(dive_queue_t * q, dive_view_t & view)
+{
+	std::unique_lock<std::mutex> lock(q->mtx);
+	q->cv.wait(lock, [q]() { return q->closed || (q->next < q->data->dives.size()); });
+	if (q->next >= q->data->dives.size())
+		return false;
+
+	view = q->data->dives[q->next++];
+	return true;
+}
 
 int list_drivers(void)
 {
@@ -286,8 +356,23 @@ typedef struct {
 	uint32_t					serial;
 	uint32_t					ticks;
 
+	std::string					xfer_token;
+	time_t						xfer_time;
+
+	bool						checkpoint;
+	std::string					checkpoint_file;
+	uint32_t					checkpointed;
+
+	dive_queue_t *				queue;
+
 } devcb_data;
 
+/* Use Pipelined Transfer and Parsing */
+bool use_pipeline(const po::variables_map & vm, const driver_interface_t * drv)
+{
+	return vm.count("pipeline") && (drv->driver_transfer_stream != 0);
+}
+
 const char * model_mfg(const driver_info_t * di, uint8_t model)
 {
 	int i;
@@ -310,6 +395,102 @@ const char * model_name(const driver_info_t * di, uint8_t model)
 	return "";
 }
 
+/*
+ * Checkpoint of a transfer in progress.  Each dive is appended to the
+ * checkpoint file as soon as it has been received, as a single-dive frame in
+ * the dump file format, so that a failed transfer can be resumed after the
+ * last complete dive.  The frames record the token the transfer started from,
+ * and the checkpoint is only used by a transfer starting from the same token.
+ */
+void checkpoint_dive(devcb_data * a, const dive_view_t & view)
+{
+	int rv;
+	dump_info_t info;
+
+	if (! a->checkpoint)
+		return;
+
+	info.driver = a->di->driver_name;
+	info.model = a->model;
+	info.serial = a->serial;
+	info.ticks = a->ticks;
+	info.xfer_time = a->xfer_time;
+	info.token = a->xfer_token;
+
+	rv = xfer_dump_append(a->checkpoint_file, info, view.data, view.size, std::vector<dump_dive_t>(1, view));
+	if (rv != 0)
+	{
+		std::cerr << "Failed to checkpoint dive to " << a->checkpoint_file << ": " << strerror(rv) << std::endl;
+		a->checkpoint = false;
+		return;
+	}
+
+	a->checkpointed++;
+}
+
+/*
+ * Queue the dives checkpointed by an earlier transfer which failed, and
+ * return the token to resume from.  A checkpoint left by a transfer from a
+ * different token or device is discarded.
+ */
+std::string resume_checkpoint(devcb_data * a, const std::string & token)
+{
+	std::vector<uint8_t> file;
+	std::vector<dump_frame_t> frames;
+	std::vector<dump_dive_t> dives;
+	boost::system::error_code ec;
+
+	std::ifstream f(a->checkpoint_file, std::ios::binary);
+	if (! f)
+		return token;
+
+	file.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+	f.close();
+
+	if (! xfer_dump_check(file.data(), file.size()) || (xfer_dump_frames(file.data(), file.size(), frames) != 0))
+		frames.clear();
+
+	std::vector<dump_frame_t>::const_iterator it;
+	for (it = frames.begin(); it != frames.end(); it++)
+	{
+		dump_dive_t dive;
+
+		if ((it->info.driver != a->di->driver_name) || (it->info.serial != a->serial) ||
+			(it->info.token != token) || (it->ndives != 1) || (xfer_dump_dive(* it, 0, dive) != 0))
+		{
+			dives.clear();
+			break;
+		}
+
+		dives.push_back(dive);
+	}
+
+	if (dives.empty())
+	{
+		if (! a->quiet)
+			std::cout << "Discarding checkpoint " << a->checkpoint_file << std::endl;
+
+		fs::remove(a->checkpoint_file, ec);
+		return token;
+	}
+
+	/* Copy the Dives out, as the File is Appended to during the Transfer */
+	std::vector<dump_dive_t>::iterator d;
+	for (d = dives.begin(); d != dives.end(); d++)
+	{
+		a->queue->data->copies.push_back(dive_buffer_t(d->data, d->data + d->size));
+		d->data = a->queue->data->copies.back().data();
+
+		dive_queue_push(a->queue, * d);
+	}
+
+	a->checkpointed = dives.size();
+	if (! a->quiet)
+		std::cout << "Resuming after " << dives.size() << " dives from " << a->checkpoint_file << std::endl;
+
+	return dives.back().token;
+}
+
 int device_cb(void * userdata, uint8_t model, uint32_t serial, uint32_t ticks, char ** token_, int * free_token)
 {
 	devcb_data * a = (devcb_data *)(userdata);
@@ -320,6 +501,7 @@ int device_cb(void * userdata, uint8_t model, uint32_t serial, uint32_t ticks, c
 	a->model = model;
 	a->serial = serial;
 	a->ticks = ticks;
+	a->xfer_time = time(NULL);
 
 	if (! a->quiet)
 	{
@@ -361,6 +543,24 @@ int device_cb(void * userdata, uint8_t model, uint32_t serial, uint32_t ticks, c
 			std::cout << "Loaded token " << token << " from " << a->token_file << std::endl;
 	}
 
+	/* Resume from the Checkpoint of a Failed Transfer */
+	a->xfer_token = token;
+	if (a->checkpoint)
+	{
+		a->checkpoint_file = a->token_file + ".partial";
+
+		try
+		{
+			fs::create_directories(fs::path(a->checkpoint_file).parent_path());
+			token = resume_checkpoint(a, token);
+		}
+		catch (std::exception & e)
+		{
+			std::cerr << "Failed to open checkpoint " << a->checkpoint_file << ": " << e.what() << std::endl;
+			a->checkpoint = false;
+		}
+	}
+
 	/* Set the Transfer Token */
 	if (! token.empty())
 	{
@@ -378,7 +578,7 @@ int device_cb(void * userdata, uint8_t model, uint32_t serial, uint32_t ticks, c
 
 #define PB_WIDTH	60
 
-void draw_progress_bar(double pct)
+void draw_progress_bar(double pct, uint32_t rate)
 {
 	int c = pct * PB_WIDTH;
 
@@ -394,10 +594,28 @@ void draw_progress_bar(double pct)
 	std::cout << "\x1B[2K";		// Erase Current Line
 	std::cout << "\x1B[0E";		// Carriage Return
 	std::cout << "[" << bar << "] " << (static_cast<int>(100 * pct)) << "%";
+	if (rate)
+	{
+		char srate[32];
+		snprintf(srate, sizeof(srate), "  %.1f kB/s", rate / 1000.0);
+		std::cout << srate;
+	}
 
 	std::flush(std::cout);
 }
 
+/* Data Rate Achieved by the Transfer, if the Driver Reports it */
+uint32_t transfer_rate(const devcb_data * a)
+{
+	uint32_t rate = 0;
+	uint32_t chunk = 0;
+
+	if (! a->drv->driver_transfer_rate || (a->drv->driver_transfer_rate(a->dev, & rate, & chunk) != 0))
+		return 0;
+
+	return rate;
+}
+
 void transfer_cb(void * userdata, uint32_t transferred, uint32_t total, int *)
 {
 	devcb_data * a = (devcb_data *)(userdata);
@@ -411,14 +629,14 @@ void transfer_cb(void * userdata, uint32_t transferred, uint32_t total, int *)
 	{
 		// Initialize the Progress Bar
 		filled = 0;
-		draw_progress_bar(0);
+		draw_progress_bar(0, 0);
 		return;
 	}
 
 	if (transferred == total)
 	{
 		// Finalize the Progress Bar
-		draw_progress_bar(1);
+		draw_progress_bar(1, transfer_rate(a));
 		std::cout << std::endl << "Transfer Finished" << std::endl;
 		return;
 	}
@@ -427,7 +645,7 @@ void transfer_cb(void * userdata, uint32_t transferred, uint32_t total, int *)
 	if (next_filled <= filled)
 		return;
 
-	draw_progress_bar(pct);
+	draw_progress_bar(pct, transfer_rate(a));
 	filled = next_filled;
 }
 
@@ -437,22 +655,283 @@ void extract_cb(void * userdata, void * buffer_ptr, uint32_t buffer_len, const c
 	if (! data)
 		return;
 
-	dive_buffer_t buffer((uint8_t *)buffer_ptr, (uint8_t *)buffer_ptr + buffer_len);
-	dive_entry_t entry(buffer, std::string(token));
+	dive_view_t view;
+	view.data = (const uint8_t *)buffer_ptr;
+	view.size = buffer_len;
+	view.token = token;
+
+	/* Copy Dives which a Driver Returns from Outside the Transfer Buffer */
+	if ((view.data < data->buffer) || (view.data + view.size > data->buffer + data->length))
+	{
+		data->copies.push_back(dive_buffer_t(view.data, view.data + view.size));
+		view.data = data->copies.back().data();
+	}
+
+	data->dives.push_back(view);
+}
+
+void stream_cb(void * userdata, void * buffer_ptr, uint32_t buffer_len, const char * token)
+{
+	devcb_data * a = (devcb_data *)(userdata);
+	if (! a || ! a->queue)
+		return;
+
+	dive_view_t view;
+	view.data = (const uint8_t *)buffer_ptr;
+	view.size = buffer_len;
+	view.token = token;
+
+	dive_queue_push(a->queue, view);
+	checkpoint_dive(a, view);
+}
+
+void checkpoint_cb(void * userdata, void * buffer_ptr, uint32_t buffer_len, const char * token)
+{
+	devcb_data * a = (devcb_data *)(userdata);
+	if (! a)
+		return;
+
+	dive_view_t view;
+	view.data = (const uint8_t *)buffer_ptr;
+	view.size = buffer_len;
+	view.token = token;
+
+	checkpoint_dive(a, view);
+}
+
+/*
+ * Parser tokens recorded by a worker thread, so that they can be replayed
+ * into the (single-threaded) output formatter in the original dive order.
+ */
+typedef struct {
+	bool						header;
+	uint8_t						token;
+	int32_t						value;
+	uint8_t						index;
+	bool						has_name;
+	std::string					name;
+
+} parsed_token_t;
+
+typedef struct {
+	int							rv;
+	std::string					stage;
+	std::vector<parsed_token_t>	tokens;
+
+} parsed_dive_t;
+
+void record_token(parsed_dive_t * dive, bool header, uint8_t token, int32_t value, uint8_t index, const char * name)
+{
+	parsed_token_t t;
+	t.header = header;
+	t.token = token;
+	t.value = value;
+	t.index = index;
+	t.has_name = (name != 0);
+	if (name)
+		t.name = name;
+
+	dive->tokens.push_back(t);
+}
+
+void record_header_cb(void * userdata, uint8_t token, int32_t value, uint8_t index, const char * name)
+{
+	record_token((parsed_dive_t *)(userdata), true, token, value, index, name);
+}
 
-	data->push_back(entry);
+void record_profile_cb(void * userdata, uint8_t token, int32_t value, uint8_t index, const char * name)
+{
+	record_token((parsed_dive_t *)(userdata), false, token, value, index, name);
+}
+
+int parse_dives_parallel(const driver_interface_t * drv, dev_handle_t dev,
+		struct output_fmt_data_t_ * fmt_data, const dive_data_t & dive_data,
+		unsigned int jobs)
+{
+	int rv = 0;
+	const std::vector<dive_view_t> & dives = dive_data.dives;
+
+	if (jobs > dives.size())
+		jobs = dives.size();
+
+	/* Create one Parser per Worker */
+	std::vector<parser_handle_t> parsers;
+	for (unsigned int i = 0; i < jobs; ++i)
+	{
+		parser_handle_t parser;
+		rv = drv->parser_create(& parser, dev);
+		if (rv != 0)
+		{
+			std::cerr << "Failed to create parser: '" + std::string(drv->driver_errmsg(dev)) << "'" << std::endl;
+			for (size_t j = 0; j < parsers.size(); ++j)
+				drv->parser_close(parsers[j]);
+			return rv;
+		}
+
+		parsers.push_back(parser);
+	}
+
+	std::vector<parsed_dive_t> results(dives.size());
+	std::vector<char> done(dives.size(), 0);
+	std::atomic<size_t> next(0);
+	std::atomic<bool> cancel(false);
+	std::mutex mtx;
+	std::condition_variable cv;
+	size_t replayed = 0;
+	const parsed_dive_t * failed = 0;
+
+	header_callback_fn_t hcb = fmt_data->header_cb ? record_header_cb : 0;
+	waypoint_callback_fn_t pcb = fmt_data->profile_cb ? record_profile_cb : 0;
+
+	/* Parse Dives on the Worker Threads */
+	std::vector<std::thread> workers;
+	for (unsigned int k = 0; k < jobs; ++k)
+	{
+		workers.push_back(std::thread([&, k]() {
+			parser_handle_t parser = parsers[k];
+			size_t i;
+
+			while (! cancel && ((i = next++) < dives.size()))
+			{
+				/*
+				 * Stay within a window of the replay to bound the buffered
+				 * tokens.  A claimed dive is always parsed, as the replay may
+				 * still be waiting for it.
+				 */
+				{
+					std::unique_lock<std::mutex> lock(mtx);
+					cv.wait(lock, [&]() { return cancel || (i < replayed + 2 * jobs); });
+				}
+
+				parsed_dive_t & r = results[i];
+				const dive_view_t & dive = dives[i];
+
+				r.rv = drv->parser_reset(parser);
+				if (r.rv != 0)
+					r.stage = "reset parser";
+
+				if (r.rv == 0)
+				{
+					r.rv = drv->parser_parse_header(parser, dive.data, dive.size, hcb, & r);
+					if (r.rv != 0)
+						r.stage = "parse header";
+				}
+
+				if (r.rv == 0)
+				{
+					r.rv = drv->parser_parse_profile(parser, dive.data, dive.size, pcb, & r);
+					if (r.rv != 0)
+						r.stage = "parse profile";
+				}
+
+				/*
+				 * The driver error message is shared by all parsers, so it is
+				 * only read once the workers have been joined
+				 */
+				std::lock_guard<std::mutex> lock(mtx);
+				if (r.rv != 0)
+					cancel = true;
+
+				done[i] = 1;
+				cv.notify_all();
+			}
+		}));
+	}
+
+	/* Replay Parsed Dives into the Formatter in Order */
+	for (size_t i = 0; i < dives.size(); ++i)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			cv.wait(lock, [&]() { return done[i] != 0; });
+		}
+
+		parsed_dive_t & r = results[i];
+
+		if (fmt_data->prolog_fn)
+		{
+			rv = fmt_data->prolog_fn(fmt_data);
+			if (rv != 0)
+			{
+				std::cerr << "Failed to run output formatter prolog: " << strerror(rv) << std::endl;
+				break;
+			}
+		}
+
+		if (r.rv != 0)
+		{
+			failed = & r;
+			rv = r.rv;
+			break;
+		}
+
+		std::vector<parsed_token_t>::const_iterator t;
+		for (t = r.tokens.begin(); t != r.tokens.end(); t++)
+		{
+			const char * name = t->has_name ? t->name.c_str() : 0;
+			if (t->header)
+				fmt_data->header_cb(fmt_data, t->token, t->value, t->index, name);
+			else
+				fmt_data->profile_cb(fmt_data, t->token, t->value, t->index, name);
+		}
+
+		std::vector<parsed_token_t>().swap(r.tokens);
+
+		if (fmt_data->epilog_fn)
+		{
+			rv = fmt_data->epilog_fn(fmt_data);
+			if (rv != 0)
+			{
+				std::cerr << "Failed to run output formatter epilog: " << strerror(rv) << std::endl;
+				break;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mtx);
+		++replayed;
+		cv.notify_all();
+	}
+
+	/* Stop and Join Workers */
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		cancel = true;
+		cv.notify_all();
+	}
+
+	for (size_t k = 0; k < workers.size(); ++k)
+		workers[k].join();
+
+	if (failed)
+		std::cerr << "Failed to " << failed->stage << ": '" << drv->driver_errmsg(dev) << "'" << std::endl;
+
+	for (size_t k = 0; k < parsers.size(); ++k)
+		drv->parser_close(parsers[k]);
+
+	return rv;
 }
 
 int run_parser(const po::variables_map & vm, const driver_interface_t * drv, dev_handle_t dev,
 		const driver_info_t * di, devcb_data * dev_data, const char * drv_args,
-		const char * dev_path, const dive_data_t & dive_data)
+		const char * dev_path, dive_queue_t & queue)
 {
 	int rv;
 	struct output_fmt_data_t_ * fmt_data;
 	std::string outfile;
 	std::string format("uddf");
 	parser_handle_t parser;
-	dive_data_t::const_iterator it;
+	dive_view_t dive;
+	unsigned int jobs = 1;
+
+	/* Number of Parser Threads */
+	if (vm.count("jobs"))
+		jobs = vm["jobs"].as<unsigned int>();
+	if (jobs == 0)
+		jobs = std::thread::hardware_concurrency();
+
+	/* Wait for the First Dive (and the Device Information) */
+	if (! dive_queue_wait(& queue))
+		return 0;
 
 	/* Allocate the Formatting Data */
 	fmt_data = (struct output_fmt_data_t_ *)malloc(sizeof(struct output_fmt_data_t_));
@@ -518,6 +997,24 @@ int run_parser(const po::variables_map & vm, const driver_interface_t * drv, dev
 		return EINVAL;
 	}
 
+	/* Parse Dives in Parallel */
+	if ((jobs > 1) && ! use_pipeline(vm, drv))
+	{
+		rv = parse_dives_parallel(drv, dev, fmt_data, * queue.data, jobs);
+		if (rv != 0)
+		{
+			fmt_data->dispose_fn(fmt_data);
+			free(fmt_data);
+			return rv;
+		}
+
+		fmt_data->close_fn(fmt_data);
+		fmt_data->dispose_fn(fmt_data);
+		free(fmt_data);
+
+		return 0;
+	}
+
 	/* Create the Parser */
 	rv = drv->parser_create(& parser, dev);
 	if (rv != 0)
@@ -529,7 +1026,7 @@ int run_parser(const po::variables_map & vm, const driver_interface_t * drv, dev
 	}
 
 	/* Parse Dives */
-	for (it = dive_data.begin(); it != dive_data.end(); it++)
+	while (dive_queue_pop(& queue, dive))
 	{
 		if (fmt_data->prolog_fn)
 		{
@@ -552,7 +1049,7 @@ int run_parser(const po::variables_map & vm, const driver_interface_t * drv, dev
 			return rv;
 		}
 
-		rv = drv->parser_parse_header(parser, it->first.data(), it->first.size(), fmt_data->header_cb, fmt_data);
+		rv = drv->parser_parse_header(parser, dive.data, dive.size, fmt_data->header_cb, fmt_data);
 		if (rv != 0)
 		{
 			std::cerr << "Failed to parse header: '" + std::string(drv->driver_errmsg(dev)) << "'" << std::endl;
@@ -561,7 +1058,7 @@ int run_parser(const po::variables_map & vm, const driver_interface_t * drv, dev
 			return rv;
 		}
 
-		rv = drv->parser_parse_profile(parser, it->first.data(), it->first.size(), fmt_data->profile_cb, fmt_data);
+		rv = drv->parser_parse_profile(parser, dive.data, dive.size, fmt_data->profile_cb, fmt_data);
 		if (rv != 0)
 		{
 			std::cerr << "Failed to parse profile: '" + std::string(drv->driver_errmsg(dev)) << "'" << std::endl;
@@ -594,6 +1091,40 @@ int run_parser(const po::variables_map & vm, const driver_interface_t * drv, dev
 	return 0;
 }
 
+/* Append the Raw Transfer to the Dump File */
+void save_dump(const po::variables_map & vm, const devcb_data * cb_data, const dive_data_t & dive_data)
+{
+	int rv;
+	dump_info_t info;
+	std::string path;
+
+	if (! vm.count("save-dump"))
+		return;
+
+	path = vm["save-dump"].as<std::string>();
+
+	info.driver = cb_data->di->driver_name;
+	info.model = cb_data->model;
+	info.serial = cb_data->serial;
+	info.ticks = cb_data->ticks;
+	info.xfer_time = cb_data->xfer_time;
+	info.token = cb_data->xfer_token;
+
+	rv = xfer_dump_append(path, info, dive_data.buffer, dive_data.length, dive_data.dives);
+	if (rv != 0)
+		std::cerr << "Failed to save transfer to " << path << ": " << strerror(rv) << std::endl;
+	else if (! cb_data->quiet)
+		std::cout << "Saved transfer to " << path << std::endl;
+}
+
+/* Point the User at the Checkpoint of a Failed Transfer */
+void report_checkpoint(const devcb_data * cb_data)
+{
+	if (cb_data->checkpointed > 0)
+		std::cerr << "Saved " << cb_data->checkpointed << " dives to " << cb_data->checkpoint_file
+			<< "; run again to resume the transfer" << std::endl;
+}
+
 int run_transfer(const po::variables_map & vm)
 {
 	int rv;
@@ -609,6 +1140,7 @@ int run_transfer(const po::variables_map & vm)
 	void * buffer_ptr;
 	uint32_t buffer_len;
 	dive_data_t dive_data;
+	dive_queue_t queue;
 
 	fs::path tokenpath;
 	fs::path tokendir;
@@ -679,9 +1211,16 @@ int run_transfer(const po::variables_map & vm)
 	cb_data.di = di;
 	cb_data.drv = drv;
 	cb_data.dev = dev;
+	cb_data.quiet = quiet;
+	cb_data.xfer_time = 0;
 
 	cb_data.device_path = drv_path;
 
+	// Checkpoint Dives as they Arrive if the Driver can Stream them
+	cb_data.checkpoint = (drv->driver_transfer_stream != 0) && ! vm.count("no-checkpoint");
+	cb_data.checkpoint_file = "";
+	cb_data.checkpointed = 0;
+
 	cb_data.token = "";
 	cb_data.token_file = "";
 	cb_data.token_path = "";
@@ -692,49 +1231,116 @@ int run_transfer(const po::variables_map & vm)
 	if (vm.count("token"))
 		cb_data.token = vm["token"].as<std::string>();
 
-	// Run Transfer
-	rv = drv->driver_transfer(dev, & buffer_ptr, & buffer_len, device_cb, transfer_cb, & cb_data);
-	if (rv != DRIVER_ERR_SUCCESS)
-	{
-		std::cerr << "Failed to transfer data from device at '" << drv_path << "': " << drv->driver_errmsg(dev) << std::endl;
-		drv->driver_close(dev);
-		drv->driver_shutdown(dev);
-		return 1;
-	}
+	queue.data = & dive_data;
+	queue.next = 0;
+	queue.closed = false;
+	cb_data.queue = & queue;
 
-	// Extract Dives
-	if (buffer_len > 0)
+	// Run Pipelined Transfer and Parse
+	if (use_pipeline(vm, drv))
 	{
-		rv = drv->driver_extract(dev, buffer_ptr, buffer_len, extract_cb, & dive_data);
+		int parse_rv = 0;
+		std::thread parse_thread([&]() {
+			parse_rv = run_parser(vm, drv, dev, di, & cb_data, drv_args.c_str(), drv_path.c_str(), queue);
+		});
+
+		buffer_ptr = 0;
+		buffer_len = 0;
+		rv = drv->driver_transfer_stream(dev, & buffer_ptr, & buffer_len, device_cb, transfer_cb, stream_cb, & cb_data);
+
+		dive_queue_close(& queue);
+		parse_thread.join();
+
 		if (rv != DRIVER_ERR_SUCCESS)
+			std::cerr << "Failed to transfer data from device at '" << drv_path << "': " << drv->driver_errmsg(dev) << std::endl;
+
+		if ((rv != DRIVER_ERR_SUCCESS) || (parse_rv != 0))
 		{
-			std::cerr << "Failed to extract dive data from transfer: " << drv->driver_errmsg(dev) << std::endl;
+			report_checkpoint(& cb_data);
+			free(buffer_ptr);
 			drv->driver_close(dev);
 			drv->driver_shutdown(dev);
 			return 1;
 		}
 
-		// Free Data Buffer
-		free(buffer_ptr);
-	}
+		dive_data.buffer = (const uint8_t *)buffer_ptr;
+		dive_data.length = buffer_len;
+		if ((buffer_len > 0) || (dive_data.dives.size() > 0))
+			save_dump(vm, & cb_data, dive_data);
 
-	// Dives Transferred
-	if (dive_data.size() > 0)
+		if (dive_data.dives.size() > 0)
+		{
+			if (! quiet)
+				std::cout << "Transferred " << dive_data.dives.size() << " new dives" << std::endl;
+		}
+		else
+			std::cout << "No new data to transfer" << std::endl;
+	}
+	else
 	{
-		if (! quiet)
-			std::cout << "Transferred " << dive_data.size() << " new dives" << std::endl;
+		// Run Transfer, Streaming Dives only to the Checkpoint
+		buffer_ptr = 0;
+		buffer_len = 0;
+		if (cb_data.checkpoint)
+			rv = drv->driver_transfer_stream(dev, & buffer_ptr, & buffer_len, device_cb, transfer_cb, checkpoint_cb, & cb_data);
+		else
+			rv = drv->driver_transfer(dev, & buffer_ptr, & buffer_len, device_cb, transfer_cb, & cb_data);
 
-		// Parse Dives
-		rv = run_parser(vm, drv, dev, di, & cb_data, drv_args.c_str(), drv_path.c_str(), dive_data);
-		if (rv != 0)
+		if (rv != DRIVER_ERR_SUCCESS)
 		{
+			std::cerr << "Failed to transfer data from device at '" << drv_path << "': " << drv->driver_errmsg(dev) << std::endl;
+			report_checkpoint(& cb_data);
+			free(buffer_ptr);
 			drv->driver_close(dev);
 			drv->driver_shutdown(dev);
 			return 1;
 		}
+
+		// Extract Dives
+		dive_data.buffer = (const uint8_t *)buffer_ptr;
+		dive_data.length = buffer_len;
+
+		if (buffer_len > 0)
+		{
+			rv = drv->driver_extract(dev, buffer_ptr, buffer_len, extract_cb, & dive_data);
+			if (rv != DRIVER_ERR_SUCCESS)
+			{
+				std::cerr << "Failed to extract dive data from transfer: " << drv->driver_errmsg(dev) << std::endl;
+				free(buffer_ptr);
+				drv->driver_close(dev);
+				drv->driver_shutdown(dev);
+				return 1;
+			}
+		}
+
+		if ((buffer_len > 0) || (dive_data.dives.size() > 0))
+			save_dump(vm, & cb_data, dive_data);
+
+		dive_queue_close(& queue);
+
+		// Dives Transferred
+		if (dive_data.dives.size() > 0)
+		{
+			if (! quiet)
+				std::cout << "Transferred " << dive_data.dives.size() << " new dives" << std::endl;
+
+			// Parse Dives
+			rv = run_parser(vm, drv, dev, di, & cb_data, drv_args.c_str(), drv_path.c_str(), queue);
+			if (rv != 0)
+			{
+				free(buffer_ptr);
+				drv->driver_close(dev);
+				drv->driver_shutdown(dev);
+				return 1;
+			}
+		}
+		else
+			std::cout << "No new data to transfer" << std::endl;
 	}
-	else
-		std::cout << "No new data to transfer" << std::endl;
+
+	// Free Data Buffer (the Dive Views refer to it)
+	if (buffer_len > 0)
+		free(buffer_ptr);
 
 	// Write Transfer Token
 	tokenpath = cb_data.token_file;
@@ -747,9 +1353,9 @@ int run_transfer(const po::variables_map & vm)
 			if (! fs::exists(tokendir))
 				fs::create_directories(tokendir);
 
-			if (dive_data.size() > 0)
+			if (dive_data.dives.size() > 0)
 			{
-				token = dive_data.rbegin()->second;
+				token = dive_data.dives.back().token;
 
 				std::ofstream f(tokenpath.native());
 				f << token << std::endl;
@@ -766,6 +1372,13 @@ int run_transfer(const po::variables_map & vm)
 		}
 	}
 
+	// The Transfer is Complete, so its Checkpoint is no longer Needed
+	if (! cb_data.checkpoint_file.empty())
+	{
+		boost::system::error_code ec;
+		fs::remove(cb_data.checkpoint_file, ec);
+	}
+
 	// Close Device
 	drv->driver_close(dev);
 	drv->driver_shutdown(dev);
@@ -774,6 +1387,217 @@ int run_transfer(const po::variables_map & vm)
 	return 0;
 }
 
+int run_dump(const po::variables_map & vm)
+{
+	int rv;
+	int quiet;
+	const driver_interface_t * drv;
+	const driver_info_t * di;
+	dev_handle_t dev;
+	std::string drv_name;
+	std::string dump_path;
+	devcb_data cb_data;
+
+	io::mapped_file_source dump;
+	uintmax_t dump_len;
+	std::vector<dump_frame_t> frames;
+	const dump_frame_t * frame = 0;
+	time_t xfer_time;
+	dive_data_t dive_data;
+	dive_queue_t queue;
+
+	// Set Quiet Mode
+	quiet = vm.count("quiet");
+
+	dump_path = vm["input-dump"].as<std::string>();
+
+	// Map the Dump File (the Dives are Parsed in Place)
+	try
+	{
+		dump_len = fs::file_size(dump_path);
+		xfer_time = fs::last_write_time(dump_path);
+
+		if (dump_len > 0)
+			dump.open(dump_path);
+	}
+	catch (std::exception & e)
+	{
+		std::cerr << "Failed to open transfer dump '" << dump_path << "': " << e.what() << std::endl;
+		return 1;
+	}
+
+	// Read the Transfer Frames from a Dump Container
+	if (xfer_dump_check((const uint8_t *)dump.data(), dump_len))
+	{
+		rv = xfer_dump_frames((const uint8_t *)dump.data(), dump_len, frames);
+		if (rv != 0)
+		{
+			std::cerr << "Failed to read transfer dump '" << dump_path << "': " << strerror(rv) << std::endl;
+			return 1;
+		}
+
+		if (frames.empty())
+		{
+			std::cout << "No transfers in " << dump_path << std::endl;
+			return 0;
+		}
+
+		unsigned int n = frames.size() - 1;
+		if (vm.count("dump-frame"))
+			n = vm["dump-frame"].as<unsigned int>();
+
+		if (n >= frames.size())
+		{
+			std::cerr << "Transfer dump '" << dump_path << "' has only " << frames.size() << " transfers" << std::endl;
+			return 1;
+		}
+
+		frame = & frames[n];
+		xfer_time = frame->info.xfer_time;
+	}
+	else if (dump_len > 0xFFFFFFFFu)
+	{
+		std::cerr << "Transfer dump '" << dump_path << "' is too large" << std::endl;
+		return 1;
+	}
+
+	// Driver and Model must be specified to Parse a Raw Dump
+	if (vm.count("driver"))
+		drv_name = vm["driver"].as<std::string>();
+	else if (frame)
+		drv_name = frame->info.driver;
+	else
+	{
+		std::cerr << "No device driver specified" << std::endl;
+		return 1;
+	}
+
+	if (! vm.count("model") && ! frame)
+	{
+		std::cerr << "No device model specified for the transfer dump" << std::endl;
+		return 1;
+	}
+
+	if (vm.count("transfer-time"))
+		xfer_time = vm["transfer-time"].as<long>();
+
+	// Load the Driver Information and Interface
+	rv = benthos_dc_registry_driver_info(drv_name.c_str(), & di);
+	if (rv == 0)
+		rv = benthos_dc_registry_load(drv_name.c_str(), & drv);
+	if (rv != 0)
+	{
+		std::cerr << "Failed to load driver '" << drv_name << "': " << benthos_dc_registry_strerror(rv) << std::endl;
+		return 1;
+	}
+
+	if (drv->driver_open_offline == 0)
+	{
+		std::cerr << "Driver '" << drv_name << "' does not support parsing transfer dumps" << std::endl;
+		return 1;
+	}
+
+	// Open an Offline Device Handle
+	rv = drv->driver_create(& dev);
+	if (rv != DRIVER_ERR_SUCCESS)
+	{
+		std::cerr << "Failed to open '" << di->driver_name << "' device: " << strerror(errno) << std::endl;
+		return 1;
+	}
+
+	cb_data.di = di;
+	cb_data.drv = drv;
+	cb_data.dev = dev;
+	cb_data.quiet = quiet;
+	cb_data.device_path = dump_path;
+
+	cb_data.model = frame ? frame->info.model : 0;
+	cb_data.serial = frame ? frame->info.serial : 0;
+	cb_data.ticks = frame ? frame->info.ticks : 0;
+
+	if (vm.count("model"))
+		cb_data.model = vm["model"].as<unsigned int>();
+	if (vm.count("serial"))
+		cb_data.serial = vm["serial"].as<unsigned int>();
+	if (vm.count("ticks"))
+		cb_data.ticks = vm["ticks"].as<unsigned int>();
+
+	rv = drv->driver_open_offline(dev, cb_data.model, cb_data.serial, cb_data.ticks, xfer_time);
+	if (rv != DRIVER_ERR_SUCCESS)
+	{
+		std::cerr << "Failed to set up device for '" << dump_path << "': " << drv->driver_errmsg(dev) << std::endl;
+		drv->driver_shutdown(dev);
+		return 1;
+	}
+
+	queue.data = & dive_data;
+	queue.next = 0;
+	queue.closed = false;
+	cb_data.queue = & queue;
+
+	// Load Dives from the Dump Index, or Extract them from a Raw Dump
+	if (frame)
+	{
+		dive_data.buffer = frame->data;
+		dive_data.length = frame->length;
+
+		dive_data.dives.resize(frame->ndives);
+		for (uint32_t i = 0; i < frame->ndives; ++i)
+		{
+			rv = xfer_dump_dive(* frame, i, dive_data.dives[i]);
+			if (rv != 0)
+			{
+				std::cerr << "Invalid dive index in '" << dump_path << "': " << strerror(rv) << std::endl;
+				drv->driver_close(dev);
+				drv->driver_shutdown(dev);
+				return 1;
+			}
+		}
+	}
+	else
+	{
+		dive_data.buffer = (const uint8_t *)dump.data();
+		dive_data.length = (uint32_t)dump_len;
+
+		if (dump_len > 0)
+		{
+			rv = drv->driver_extract(dev, const_cast<char *>(dump.data()), dive_data.length, extract_cb, & dive_data);
+			if (rv != DRIVER_ERR_SUCCESS)
+			{
+				std::cerr << "Failed to extract dive data from '" << dump_path << "': " << drv->driver_errmsg(dev) << std::endl;
+				drv->driver_close(dev);
+				drv->driver_shutdown(dev);
+				return 1;
+			}
+		}
+	}
+
+	dive_queue_close(& queue);
+
+	// Parse Dives
+	if (dive_data.dives.size() > 0)
+	{
+		if (! quiet)
+			std::cout << "Loaded " << dive_data.dives.size() << " dives from " << dump_path << std::endl;
+
+		rv = run_parser(vm, drv, dev, di, & cb_data, "", dump_path.c_str(), queue);
+		if (rv != 0)
+		{
+			drv->driver_close(dev);
+			drv->driver_shutdown(dev);
+			return 1;
+		}
+	}
+	else
+		std::cout << "No dives in " << dump_path << std::endl;
+
+	// Close Device
+	drv->driver_close(dev);
+	drv->driver_shutdown(dev);
+
+	return 0;
+}
+
 int main(int argc, char ** argv)
 {
 	int rv;
@@ -796,6 +1620,9 @@ int main(int argc, char ** argv)
 		("token,t", po::value<std::string>(), "Transfer token")
 		("token-path", po::value<std::string>(), "Transfer token storage path")
 		("no-store-token,U", "Don't update the stored Transfer Token")
+		("no-checkpoint", "Don't checkpoint dives for resuming a failed transfer")
+		("pipeline,P", "Parse dives while the transfer is running")
+		("save-dump,D", po::value<std::string>(), "Append the raw transfer to a dump file")
 	;
 
 	po::options_description output("Output Options");
@@ -803,6 +1630,17 @@ int main(int argc, char ** argv)
 		("header-only,h", "Save header only, not profile data")
 		("output-file,o", po::value<std::string>(), "Output file")
 		("output-format,f", po::value<std::string>(), "Output format")
+		("jobs,j", po::value<unsigned int>(), "Number of parser threads (0 for one per CPU)")
+	;
+
+	po::options_description offline("Offline Options");
+	offline.add_options()
+		("input-dump,i", po::value<std::string>(), "Parse a saved raw transfer instead of a device")
+		("dump-frame", po::value<unsigned int>(), "Transfer to parse from a dump file (default is the last)")
+		("model", po::value<unsigned int>(), "Device model number of the saved transfer")
+		("serial", po::value<unsigned int>(), "Device serial number of the saved transfer")
+		("ticks", po::value<unsigned int>(), "Device tick count at the saved transfer")
+		("transfer-time", po::value<long>(), "Time of the saved transfer (seconds since 1970, default is the file time)")
 	;
 
 	po::options_description registry("Registry Options");
@@ -814,7 +1652,7 @@ int main(int argc, char ** argv)
 	;
 
 	po::options_description desc;
-	desc.add(generic).add(transfer).add(output).add(registry);
+	desc.add(generic).add(transfer).add(output).add(offline).add(registry);
 
 	po::positional_options_description p;
 	p.add("device", 1);
@@ -872,8 +1710,11 @@ int main(int argc, char ** argv)
 		return rv;
 	}
 
-	// Run the Transfer
-	rv = run_transfer(vm);
+	// Run the Transfer, or Parse a Saved Transfer
+	if (vm.count("input-dump"))
+		rv = run_dump(vm);
+	else
+		rv = run_transfer(vm);
 
 	// Cleanup
 	benthos_dc_registry_cleanup();
@@ -35,6 +35,8 @@
  */
 
 #include <cerrno>
+#include <cstdio>
+#include <cstring>
 #include <map>
 #include <string>
 #include <utility>
@@ -49,14 +51,26 @@
 typedef std::pair<uint16_t, uint16_t>	mix_t;		///< Gas Mix Data
 typedef std::map<std::string, mix_t>	mix_list_t;	///< Gas Mix List
 
-//! UDDF Formatter Data
+/*
+ * UDDF Formatter Data
+ *
+ * Dives are streamed: each <dive> element is built as a small subtree while
+ * it is parsed and is serialized to a spool file in the epilog, after which
+ * the subtree is freed.  Gas definitions are only known once every dive has
+ * been seen and must precede <profiledata>, so the close function writes the
+ * document head and <gasdefinitions> first and then copies the spooled
+ * profile data into the output file.
+ */
 typedef struct
 {
 	xmlDoc *						doc;			///< XML Document
 	xmlNode *						root;			///< XML Root Node
-	xmlNode *						profiles;		///< UDDF Profiles Node
+	xmlNode *						generator;		///< UDDF Generator Node
 	xmlNode *						gasdef;			///< UDDF Gas Definitions Node
-	xmlNode *						repgrp;			///< UDDF Repetition Group Node
+	FILE *							spool;			///< Spooled Profile Data
+
+	std::string						repgrp;			///< Pending Repetition Group Id
+	bool							repgrp_open;	///< Repetition Group Open in Spool
 
 	mix_list_t						mixes;			///< List of Gas Mixes
 	std::map<uint8_t, xmlNode *>	tanks;			///< List of Tank Nodes
@@ -87,19 +101,43 @@ void uddf_dispose_formatter(output_fmt_data_t s)
 	fmt_data = static_cast<uddf_fmt_data *>(s->fmt_data);
 
 	/* Cleanup XML Data */
+	if (fmt_data->cur_profile)
+		xmlFreeNode(fmt_data->cur_profile);
+
 	xmlFreeDoc(fmt_data->doc);
 	xmlCleanupParser();
 
+	/* Remove the Spool File */
+	if (fmt_data->spool)
+		fclose(fmt_data->spool);
+
 	/* Delete Formatter Data */
 	delete fmt_data;
 }
 
+/* Write an Indented Node to a File */
+static int uddf_write_node(FILE * f, xmlDoc * doc, xmlNode * node, int level)
+{
+	xmlBuffer * buf = xmlBufferCreate();
+	if (! buf)
+		return ENOMEM;
+
+	xmlNodeDump(buf, doc, node, level, 1);
+	fprintf(f, "%*s%s\n", level * 2, "", (const char *)xmlBufferContent(buf));
+	xmlBufferFree(buf);
+
+	return ferror(f) ? EIO : 0;
+}
+
 /* Close the Data Formatter File */
 int uddf_close_formatter(output_fmt_data_t s)
 {
 	uddf_fmt_data * fmt_data;
 	mix_list_t::const_iterator it;
 	std::string outfile(s->output_file);
+	FILE * f;
+	char buf[4096];
+	size_t n;
 
 	if (! s || (s->magic != UDDF_FMT_MAGIC))
 		return EINVAL;
@@ -126,11 +164,50 @@ int uddf_close_formatter(output_fmt_data_t s)
 		xmlNewChild(mixnode, NULL, BAD_CAST "h2", BAD_CAST("0.000"));
 	}
 
+	/* Close the Last Repetition Group */
+	if (fmt_data->repgrp_open)
+	{
+		fprintf(fmt_data->spool, "    </repetitiongroup>\n");
+		fmt_data->repgrp_open = false;
+	}
+
+	/* Open the XML File */
+	if (outfile.empty() || (outfile == "-"))
+	{
+		f = stdout;
+	}
+	else
+	{
+		f = fopen(outfile.c_str(), "w");
+		if (! f)
+			return errno;
+	}
+
+	/* Write the Document Head and Gas Definitions */
+	fprintf(f, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+	fprintf(f, "<uddf version=\"3.0.0\">\n");
+	uddf_write_node(f, fmt_data->doc, fmt_data->generator, 1);
+	uddf_write_node(f, fmt_data->doc, fmt_data->gasdef, 1);
+
+	/* Copy the Spooled Profile Data */
+	fprintf(f, "  <profiledata>\n");
+
+	fflush(fmt_data->spool);
+	rewind(fmt_data->spool);
+	while ((n = fread(buf, 1, sizeof(buf), fmt_data->spool)) > 0)
+		fwrite(buf, 1, n, f);
+
+	fprintf(f, "  </profiledata>\n");
+	fprintf(f, "</uddf>\n");
+
 	/* Close the XML File */
-	xmlSaveFormatFileEnc(outfile.empty() ? "-" : outfile.c_str(), fmt_data->doc, "UTF-8", 1);
+	int rv = ferror(f) || ferror(fmt_data->spool) ? EIO : 0;
+	if (f == stdout)
+		fflush(f);
+	else if (fclose(f) != 0)
+		rv = errno;
 
-	/* Success */
-	return 0;
+	return rv;
 }
 
 /* Prolog Function */
@@ -155,7 +232,7 @@ int uddf_prolog(output_fmt_data_t s)
 
 	/* Create new Profile Entry */
 	snprintf(buf, 255, "benthos_dive_%s_%03d", fmt_data->ts.c_str(), fmt_data->did++);
-	fmt_data->cur_profile = xmlNewNode(0, BAD_CAST("dive"));
+	fmt_data->cur_profile = xmlNewDocNode(fmt_data->doc, 0, BAD_CAST("dive"), 0);
 	xmlNewProp(fmt_data->cur_profile, BAD_CAST("id"), BAD_CAST(buf));
 
 	xmlNode * appdata = xmlNewChild(fmt_data->cur_profile, 0, BAD_CAST("applicationdata"), 0);
@@ -182,8 +259,23 @@ int uddf_epilog(output_fmt_data_t s)
 
 	fmt_data = static_cast<uddf_fmt_data *>(cb_data->fmt_data);
 
-	/* Link the Profile to the Repetition Group */
-	xmlAddChild(fmt_data->repgrp, fmt_data->cur_profile);
+	/* Start a Repetition Group if the Dive Opened One (or None is Open) */
+	if (! fmt_data->repgrp.empty() || ! fmt_data->repgrp_open)
+	{
+		if (fmt_data->repgrp.empty())
+		{
+			char buf[256];
+			snprintf(buf, 255, "benthos_repgroup_%s_%03d", fmt_data->ts.c_str(), fmt_data->rgid++);
+			fmt_data->repgrp = buf;
+		}
+
+		if (fmt_data->repgrp_open)
+			fprintf(fmt_data->spool, "    </repetitiongroup>\n");
+
+		fprintf(fmt_data->spool, "    <repetitiongroup id=\"%s\">\n", fmt_data->repgrp.c_str());
+		fmt_data->repgrp_open = true;
+		fmt_data->repgrp.clear();
+	}
 
 	/* Process Tanks and Mixes */
 	for (idx = fmt_data->tanks.begin(); idx != fmt_data->tanks.end(); idx++)
@@ -225,7 +317,15 @@ int uddf_epilog(output_fmt_data_t s)
 		}
 	}
 
-	return 0;
+	/* Stream the Dive to the Spool File and Release it */
+	int rv = uddf_write_node(fmt_data->spool, fmt_data->doc, fmt_data->cur_profile, 3);
+
+	xmlFreeNode(fmt_data->cur_profile);
+	fmt_data->cur_profile = 0;
+	fmt_data->cur_waypoint = 0;
+	fmt_data->tanks.clear();
+
+	return rv;
 }
 
 /* Initialize Data Formatter Structure */
@@ -258,6 +358,16 @@ int uddf_init_formatter(output_fmt_data_t s)
 	if (! fmt_data)
 		return ENOMEM;
 
+	/* Create the Profile Data Spool File */
+	fmt_data->spool = tmpfile();
+	if (! fmt_data->spool)
+	{
+		int rv = errno;
+		delete fmt_data;
+		s->magic = 0;
+		return rv;
+	}
+
 	/* Initialize UDDF Document */
 	fmt_data->doc = xmlNewDoc(BAD_CAST("1.0"));
 	fmt_data->root = xmlNewNode(0, BAD_CAST("uddf"));
@@ -266,6 +376,7 @@ int uddf_init_formatter(output_fmt_data_t s)
 
 	/* Initialize Generator Data */
 	generator = xmlNewChild(fmt_data->root, 0, BAD_CAST "generator", 0);
+	fmt_data->generator = generator;
 	xmlNewChild(generator, 0, BAD_CAST("name"), BAD_CAST("benthos-dc"));
 	xmlNewChild(generator, 0, BAD_CAST("version"), BAD_CAST(BENTHOS_DC_VERSION_STRING));
 
@@ -277,9 +388,8 @@ int uddf_init_formatter(output_fmt_data_t s)
 	strftime(buf, 250, "%Y%m%dT%H%m%S", tm);
 	fmt_data->ts = std::string(buf);
 
-	/* Setup Gas and Profile Nodes */
+	/* Setup Gas Definitions Node */
 	fmt_data->gasdef = xmlNewChild(fmt_data->root, 0, BAD_CAST("gasdefinitions"), 0);
-	fmt_data->profiles = xmlNewChild(fmt_data->root, 0, BAD_CAST("profiledata"), 0);
 
 	/* Initialize Standard Mixes */
 	fmt_data->mixes.insert(std::pair<std::string, mix_t>("air", mix_t(210, 0)));
@@ -287,7 +397,9 @@ int uddf_init_formatter(output_fmt_data_t s)
 	fmt_data->mixes.insert(std::pair<std::string, mix_t>("ean36", mix_t(360, 0)));
 
 	/* Initialize Remaining Elements */
-	fmt_data->repgrp = 0;
+	fmt_data->repgrp_open = false;
+	fmt_data->cur_profile = 0;
+	fmt_data->cur_waypoint = 0;
 	fmt_data->rgid = 0;
 	fmt_data->did = 0;
 
@@ -363,8 +475,7 @@ void uddf_header_cb(void * arg, uint8_t token, int32_t value, uint8_t index, con
 		if (value == 1)
 		{
 			snprintf(buf, 255, "benthos_repgroup_%s_%03d", fmt_data->ts.c_str(), fmt_data->rgid++);
-			fmt_data->repgrp = xmlNewChild(fmt_data->profiles, NULL, BAD_CAST "repetitiongroup", NULL);
-			xmlNewProp(fmt_data->repgrp, BAD_CAST "id", BAD_CAST buf);
+			fmt_data->repgrp = buf;
 		}
 		break;
 	}
@@ -0,0 +1,361 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+/**
+ * @file src/transferapp/xfer_dump.cpp
+ * @brief Raw Transfer Dump Container
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "xfer_dump.h"
+
+#define DUMP_HDR_SIZE			16
+#define FRAME_HDR_SIZE			48
+#define INDEX_ENTRY_SIZE		16
+
+static const char dump_magic[8] = { 'B', 'D', 'C', 'X', 'D', 'U', 'M', 'P' };
+static const char frame_magic[4] = { 'X', 'F', 'E', 'R' };
+
+static void put_u16(std::string & s, uint16_t v)
+{
+	s.push_back((char)(v & 0xFF));
+	s.push_back((char)((v >> 8) & 0xFF));
+}
+
+static void put_u32(std::string & s, uint32_t v)
+{
+	put_u16(s, (uint16_t)(v & 0xFFFF));
+	put_u16(s, (uint16_t)(v >> 16));
+}
+
+static void put_pad(std::string & s)
+{
+	while (s.size() % 4)
+		s.push_back(0);
+}
+
+static uint16_t get_u16(const uint8_t * p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t * p)
+{
+	return (uint32_t)get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+static uint32_t padded(uint32_t n)
+{
+	return (n + 3) & ~3u;
+}
+
+/*
+ * Find the end of the last complete frame in an existing dump file, walking
+ * the frame headers the same way xfer_dump_frames() does.  A file too short
+ * to hold the dump header ends at zero so the header is written again.
+ */
+static int dump_end(const std::string & path, uint64_t & end, uint64_t & size)
+{
+	uint8_t p[DUMP_HDR_SIZE];
+	uint64_t pos;
+
+	end = size = 0;
+
+	std::ifstream f(path.c_str(), std::ios::binary);
+	if (! f)
+		return 0;
+
+	f.seekg(0, std::ios::end);
+	size = (uint64_t)f.tellg();
+	if (size < DUMP_HDR_SIZE)
+		return 0;
+
+	f.seekg(0);
+	if (! f.read((char *)p, DUMP_HDR_SIZE) || (memcmp(p, dump_magic, 8) != 0))
+		return EINVAL;
+
+	if (get_u32(p + 8) != XFER_DUMP_VERSION)
+		return ENOTSUP;
+
+	for (pos = DUMP_HDR_SIZE; size - pos >= FRAME_HDR_SIZE; )
+	{
+		f.seekg(pos);
+		if (! f.read((char *)p, 8) || (memcmp(p, frame_magic, 4) != 0))
+			return EINVAL;
+
+		uint32_t frame_len = get_u32(p + 4);
+		if (frame_len < FRAME_HDR_SIZE)
+			return EINVAL;
+
+		if (frame_len > size - pos)
+			break;
+
+		pos += frame_len;
+	}
+
+	end = pos;
+	return 0;
+}
+
+// Cut a Dump File back to the given Length
+static int dump_truncate(const std::string & path, uint64_t length)
+{
+#ifdef _WIN32
+	int fd;
+	int rv;
+
+	if (_sopen_s(& fd, path.c_str(), _O_RDWR | _O_BINARY, _SH_DENYNO, 0) != 0)
+		return errno ? errno : EIO;
+
+	rv = _chsize_s(fd, (__int64)length);
+	_close(fd);
+	return rv;
+#else
+	if (truncate(path.c_str(), (off_t)length) != 0)
+		return errno ? errno : EIO;
+
+	return 0;
+#endif
+}
+
+int xfer_dump_append(const std::string & path, const dump_info_t & info,
+		const uint8_t * buffer, uint32_t length, const std::vector<dump_dive_t> & dives)
+{
+	std::string hdr;
+	std::string index;
+	std::string strings;
+	std::string extra;
+	uint64_t frame_len;
+	uint64_t file_end;
+	uint64_t file_size;
+	int rv;
+
+	if ((info.driver.size() > 0xFFFF) || (info.token.size() > 0xFFFF))
+		return EINVAL;
+
+	// Build the Dive Index, copying Dives from outside the Transfer Buffer
+	for (size_t i = 0; i < dives.size(); ++i)
+	{
+		const dump_dive_t & d = dives[i];
+		uint64_t offset;
+
+		if (buffer && (d.data >= buffer) && (d.data + d.size <= buffer + length))
+			offset = d.data - buffer;
+		else
+		{
+			offset = (uint64_t)length + extra.size();
+			extra.append((const char *)d.data, d.size);
+		}
+
+		if (offset + d.size > 0xFFFFFFFFu)
+			return EFBIG;
+
+		put_u32(index, (uint32_t)offset);
+		put_u32(index, d.size);
+		put_u32(index, (uint32_t)strings.size());
+		put_u32(index, (uint32_t)d.token.size());
+		strings.append(d.token);
+	}
+
+	put_pad(strings);
+
+	// Build the Frame Header
+	uint32_t index_off = padded(FRAME_HDR_SIZE + info.driver.size() + info.token.size());
+	uint32_t data_off = index_off + index.size() + strings.size();
+	uint64_t data_len = (uint64_t)length + extra.size();
+
+	frame_len = data_off + padded(data_len);
+	if (frame_len > 0xFFFFFFFFu)
+		return EFBIG;
+
+	hdr.append(frame_magic, 4);
+	put_u32(hdr, (uint32_t)frame_len);
+	put_u32(hdr, (uint32_t)dives.size());
+	put_u32(hdr, (uint32_t)data_len);
+	put_u32(hdr, index_off);
+	put_u32(hdr, data_off);
+	put_u32(hdr, info.model);
+	put_u32(hdr, info.serial);
+	put_u32(hdr, info.ticks);
+	put_u32(hdr, (uint32_t)((uint64_t)info.xfer_time & 0xFFFFFFFFu));
+	put_u32(hdr, (uint32_t)((uint64_t)info.xfer_time >> 32));
+	put_u16(hdr, (uint16_t)info.driver.size());
+	put_u16(hdr, (uint16_t)info.token.size());
+	hdr.append(info.driver);
+	hdr.append(info.token);
+	put_pad(hdr);
+
+	/*
+	 * Drop a frame left incomplete by an interrupted append.  The reader only
+	 * tolerates a torn frame at the end of the file, so appending after one
+	 * would make every frame in the file unreadable.
+	 */
+	rv = dump_end(path, file_end, file_size);
+	if (rv != 0)
+		return rv;
+
+	if (file_end < file_size)
+	{
+		rv = dump_truncate(path, file_end);
+		if (rv != 0)
+			return rv;
+	}
+
+	// Append the Frame
+	std::ofstream f(path.c_str(), std::ios::binary | std::ios::app);
+	if (! f)
+		return errno ? errno : EIO;
+
+	f.seekp(0, std::ios::end);
+	if (f.tellp() == std::streampos(0))
+	{
+		std::string fhdr(dump_magic, 8);
+		put_u32(fhdr, XFER_DUMP_VERSION);
+		put_u32(fhdr, 0);
+		f.write(fhdr.data(), fhdr.size());
+	}
+
+	f.write(hdr.data(), hdr.size());
+	f.write(index.data(), index.size());
+	f.write(strings.data(), strings.size());
+	if (length > 0)
+		f.write((const char *)buffer, length);
+	f.write(extra.data(), extra.size());
+	f.write("\0\0\0", padded(data_len) - data_len);
+
+	f.close();
+	if (! f)
+		return EIO;
+
+	return 0;
+}
+
+bool xfer_dump_check(const uint8_t * file, uint64_t size)
+{
+	return (file != 0) && (size >= DUMP_HDR_SIZE) && (memcmp(file, dump_magic, 8) == 0);
+}
+
+int xfer_dump_frames(const uint8_t * file, uint64_t size, std::vector<dump_frame_t> & frames)
+{
+	uint64_t pos;
+
+	if (! xfer_dump_check(file, size))
+		return EINVAL;
+
+	if (get_u32(file + 8) != XFER_DUMP_VERSION)
+		return ENOTSUP;
+
+	frames.clear();
+	for (pos = DUMP_HDR_SIZE; size - pos >= FRAME_HDR_SIZE; )
+	{
+		const uint8_t * p = file + pos;
+		dump_frame_t fr;
+
+		if (memcmp(p, frame_magic, 4) != 0)
+			return EINVAL;
+
+		uint32_t frame_len = get_u32(p + 4);
+		uint32_t index_off = get_u32(p + 16);
+		uint32_t data_off = get_u32(p + 20);
+		uint16_t drv_len = get_u16(p + 44);
+		uint16_t tok_len = get_u16(p + 46);
+
+		if (frame_len < FRAME_HDR_SIZE)
+			return EINVAL;
+
+		// Stop at a Frame which was not Completely Written
+		if (frame_len > size - pos)
+			break;
+
+		fr.ndives = get_u32(p + 8);
+		fr.length = get_u32(p + 12);
+
+		if ((FRAME_HDR_SIZE + (uint32_t)drv_len + tok_len > index_off) || (index_off > data_off)
+			|| ((uint64_t)fr.ndives * INDEX_ENTRY_SIZE > data_off - index_off)
+			|| (data_off > frame_len) || (fr.length > frame_len - data_off))
+			return EINVAL;
+
+		fr.info.driver.assign((const char *)p + FRAME_HDR_SIZE, drv_len);
+		fr.info.token.assign((const char *)p + FRAME_HDR_SIZE + drv_len, tok_len);
+		fr.info.model = p[24];
+		fr.info.serial = get_u32(p + 28);
+		fr.info.ticks = get_u32(p + 32);
+		fr.info.xfer_time = (int64_t)((uint64_t)get_u32(p + 36) | ((uint64_t)get_u32(p + 40) << 32));
+
+		fr.index = p + index_off;
+		fr.strings = fr.index + fr.ndives * INDEX_ENTRY_SIZE;
+		fr.nstrings = data_off - index_off - fr.ndives * INDEX_ENTRY_SIZE;
+		fr.data = p + data_off;
+
+		frames.push_back(fr);
+		pos += frame_len;
+	}
+
+	return 0;
+}
+
+int xfer_dump_dive(const dump_frame_t & frame, uint32_t n, dump_dive_t & dive)
+{
+	const uint8_t * e;
+	uint32_t offset;
+	uint32_t size;
+	uint32_t tok_off;
+	uint32_t tok_len;
+
+	if (n >= frame.ndives)
+		return EINVAL;
+
+	e = frame.index + n * INDEX_ENTRY_SIZE;
+	offset = get_u32(e);
+	size = get_u32(e + 4);
+	tok_off = get_u32(e + 8);
+	tok_len = get_u32(e + 12);
+
+	if ((offset > frame.length) || (size > frame.length - offset)
+		|| (tok_off > frame.nstrings) || (tok_len > frame.nstrings - tok_off))
+		return EINVAL;
+
+	dive.data = frame.data + offset;
+	dive.size = size;
+	dive.token.assign((const char *)frame.strings + tok_off, tok_len);
+
+	return 0;
+}
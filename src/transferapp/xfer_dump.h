@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2014 Asymworks, LLC.  All Rights Reserved.
+ *
+ * Developed by: Asymworks, LLC <info@asymworks.com>
+ * 				 http://www.asymworks.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal with the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimers.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimers in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of Asymworks, LLC, nor the names of its contributors
+ *      may be used to endorse or promote products derived from this Software
+ *      without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * WITH THE SOFTWARE.
+ */
+
+#ifndef BENTHOS_DC_XFER_DUMP_H_
+#define BENTHOS_DC_XFER_DUMP_H_
+
+/**
+ * @file src/transferapp/xfer_dump.h
+ * @brief Raw Transfer Dump Container
+ * @author Jonathan Krauss <jkrauss@asymworks.com>
+ *
+ * A dump file holds raw transfer buffers as returned by driver_transfer,
+ * one frame per transfer, appended to the end of the file.  Each frame
+ * records the driver and device information needed to parse the buffer
+ * again and a fixed-size index of the dives found by driver_extract, so
+ * that any dive can be located without scanning the transfer buffer.
+ *
+ * All integers are stored little-endian.  The file starts with a 16-byte
+ * header ("BDCXDUMP", version, reserved).  Each frame is laid out as:
+ *
+ *   0   "XFER"
+ *   4   u32 frame length, including this header and padding
+ *   8   u32 number of dives
+ *   12  u32 data length
+ *   16  u32 index offset (from the start of the frame)
+ *   20  u32 data offset (from the start of the frame)
+ *   24  u8  model, 3 bytes padding
+ *   28  u32 serial number
+ *   32  u32 tick count
+ *   36  s64 host time of the transfer (seconds since 1970)
+ *   44  u16 driver name length, u16 transfer token length
+ *   48  driver name, transfer token
+ *
+ * followed by the index (16 bytes per dive: data offset, dive length,
+ * token offset and token length, offsets relative to the data and to the
+ * token strings respectively), the dive token strings and the data.  The
+ * data is the transfer buffer, followed by copies of any dives the driver
+ * returned from outside of it.  The index, token strings, data and the
+ * frame itself are padded to a multiple of 4 bytes.
+ */
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+//! Dump File Format Version
+#define XFER_DUMP_VERSION		1
+
+/**
+ * @brief Dive Data in a Transfer
+ *
+ * Refers to the dive data in place; the data is not copied.
+ */
+typedef struct {
+	const uint8_t *				data;
+	uint32_t					size;
+	std::string					token;
+
+} dump_dive_t;
+
+/**
+ * @brief Transfer Information
+ */
+typedef struct {
+	std::string					driver;		///< Driver Name
+	uint8_t						model;		///< Device Model Number
+	uint32_t					serial;		///< Device Serial Number
+	uint32_t					ticks;		///< Device Tick Count
+	int64_t						xfer_time;	///< Host Time of the Transfer
+	std::string					token;		///< Transfer Token
+
+} dump_info_t;
+
+/**
+ * @brief Transfer Frame in a Mapped Dump File
+ */
+typedef struct {
+	dump_info_t					info;		///< Transfer Information
+	uint32_t					ndives;		///< Number of Dives
+	const uint8_t *				index;		///< Dive Index
+	const uint8_t *				strings;	///< Dive Token Strings
+	uint32_t					nstrings;	///< Dive Token Strings Length
+	const uint8_t *				data;		///< Transfer Data
+	uint32_t					length;		///< Transfer Data Length
+
+} dump_frame_t;
+
+/**
+ * @brief Append a Transfer to a Dump File
+ * @param[in] Dump File Path
+ * @param[in] Transfer Information
+ * @param[in] Transfer Buffer
+ * @param[in] Transfer Buffer Length
+ * @param[in] Dives Extracted from the Transfer Buffer
+ * @return Zero on Success, or an errno value on Failure
+ *
+ * Creates the file if it does not exist.  Dives which do not lie within the
+ * transfer buffer are copied into the frame after it.  A frame left torn at
+ * the end of the file by an interrupted append is removed first.
+ */
+int xfer_dump_append(const std::string & path, const dump_info_t & info,
+		const uint8_t * buffer, uint32_t length, const std::vector<dump_dive_t> & dives);
+
+/**
+ * @brief Check for a Dump File Header
+ * @param[in] File Data
+ * @param[in] File Size
+ * @return True if the data starts with a dump file header
+ */
+bool xfer_dump_check(const uint8_t * file, uint64_t size);
+
+/**
+ * @brief Read the Frames of a Mapped Dump File
+ * @param[in] File Data
+ * @param[in] File Size
+ * @param[out] Transfer Frames
+ * @return Zero on Success, or an errno value on Failure
+ *
+ * Only the frame headers are read; the frames refer to the file data.  An
+ * incomplete frame at the end of the file, as left by an interrupted write,
+ * is ignored.
+ */
+int xfer_dump_frames(const uint8_t * file, uint64_t size, std::vector<dump_frame_t> & frames);
+
+/**
+ * @brief Get a Dive from a Transfer Frame
+ * @param[in] Transfer Frame
+ * @param[in] Dive Number
+ * @param[out] Dive Data
+ * @return Zero on Success, or an errno value on Failure
+ */
+int xfer_dump_dive(const dump_frame_t & frame, uint32_t n, dump_dive_t & dive);
+
+#endif /* BENTHOS_DC_XFER_DUMP_H_ */